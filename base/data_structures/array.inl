@@ -53,7 +53,7 @@
  * @param a The array
  * @returns The capacity as a size_t
  */
-#define sl_array_capacity(a)        ((a) ? sl_array_get_header(a)->capacity : 0)
+#define sl_array_capacity(a)        ((a) ? sl_array_get_header(a)->capacity & ~SL_ARRAY_INLINE : 0)
 
 /**
  * @brief Get The Size of a Array
@@ -98,7 +98,7 @@
  * @param alloc The allocator to be used
 * @param a The array
  */
-#define sl_array_free(alloc, a)       ((void) ((a) ? sl_free(alloc, sl_array_get_header(a)) : (void*)0), (a)=NULL)
+#define sl_array_free(alloc, a)       ((void) ((a) && !sl_array_is_inline(a) ? sl_free(alloc, sl_array_get_header(a)) : (void*)0), (a)=NULL)
 
 
 #define sl_array_del(a,i)      sl_array_deln(a,i,1)
@@ -111,11 +111,20 @@
 #define sl_array_insn(a,i,n)   (sl_array_addn((a),(n)), memmove(&(a)[(i)+(n)], &(a)[i], sizeof *(a) * (sl_array_get_header(a)->length-(n)-(i))))
 #define sl_array_isn(a,i,v)    (sl_array_insn((a),(i),1), (a)[i]=(v))
 
-#define sl_array_mayb_grow(alloc, a,n)  ((!(a) || sl_array_get_header(a)->length + (n) > sl_array_get_header(a)->capacity) \
+#define sl_array_mayb_grow(alloc, a,n)  ((!(a) || sl_array_get_header(a)->length + (n) > sl_array_capacity(a)) \
                                   ? (sl_array_grow(alloc, a,n,0),0) : 0)
 
 #define sl_array_grow(alloc, a,b,c)   ((a) = sl_array_grow_wrapper(alloc, (a), sizeof *(a), (b), (c), SL_FUNCTION, __FILE__, __LINE__))
 
+//Set in the capacity of an array still using the inline storage of SL_SMALL_ARRAY
+#define SL_ARRAY_INLINE ((size_t)1 << (sizeof(size_t) * 8 - 1))
+
+/**
+ * @brief Check if a Array is Still Using its Inline Storage
+* @param a The array
+ */
+#define sl_array_is_inline(a) ((a) && (sl_array_get_header(a)->capacity & SL_ARRAY_INLINE))
+
 /**
  * @brief Representation of Array Header Data
  */
@@ -151,11 +160,15 @@ typedef struct
 			  else if (min_cap < 4)
 				  min_cap = 4;
 
-			  b = alloc->realloc(alloc, (a) ? sl_array_get_header(a) : 0, elemsize * min_cap + sizeof(sl_array_header), 0, func, file, line);
+			  // inline storage isn't ours to realloc, it gets copied out once instead
+			  const bool spill = sl_array_is_inline(a);
+			  b = alloc->realloc(alloc, (a && !spill) ? sl_array_get_header(a) : 0, elemsize * min_cap + sizeof(sl_array_header), 0, func, file, line);
 
 			  b = (char *) b + sizeof(sl_array_header);
 			  if (a == NULL) {
 				  sl_array_get_header(b)->length = 0;
+			  } else if (spill) {
+				  memcpy(sl_array_get_header(b), sl_array_get_header(a), sizeof(sl_array_header) + elemsize * sl_array_size(a));
 			  }
 
 			  sl_array_get_header(b)->capacity = min_cap;
@@ -174,8 +187,33 @@ typedef struct
 #define sl_array_grow_wrapper            sl_array_grow_internal
 #endif
 
+//sl_array_get_header reads right before the items, so SL_SMALL_ARRAY can't hold types aligned past the header
+#ifdef __cplusplus
+#define SL_ARRAY_STATIC_ASSERT(cond, msg) static_assert(cond, msg)
+#define SL_ARRAY_ALIGNOF(type)            alignof(type)
+#else
+#define SL_ARRAY_STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
+#define SL_ARRAY_ALIGNOF(type)            _Alignof(type)
+#endif
+
+/**
+ * @brief Declares a Array
+ * Any sl_allocator works. Passing one from sl_allocator_api->create_virtual_array makes
+ * growth commit pages in place instead of copying, so element pointers stay stable.
+ */
 #define SL_ARRAY(type, name) type* name
 
+/**
+ * @brief Declares a Array With Inline Storage for n Objects
+ * All the sl_array macros work on it. Nothing is allocated until it grows past n objects,
+ * then it moves to the allocator like any other array. sl_array_free only frees it if it did.
+ * Declare it as a local, the array points into its own storage so it must not outlive the scope.
+ */
+#define SL_SMALL_ARRAY(type, name, n) \
+	SL_ARRAY_STATIC_ASSERT(SL_ARRAY_ALIGNOF(type) <= sizeof(sl_array_header), "SL_SMALL_ARRAY items must directly follow the header"); \
+	struct { sl_array_header header; type items[n]; } name##_storage = { { 0, (size_t)(n) | SL_ARRAY_INLINE } }; \
+	type* name = name##_storage.items
+
 		  /*
 ------------------------------------------------------------------------------
 This software is available under 2 licenses -- choose whichever you prefer.
@@ -0,0 +1,331 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_BITSET_INL
+#define STARLIGHT_BITSET_INL
+
+#include "defines.h"
+#include "memory/allocator.h"
+#include "thread/atomics.inl"
+
+/*
+ * Dynamically sized bitset. Bits are kept in 64 bit words, padded to a multiple of two words so the
+ * bulk operations (and, or, andnot, xor) run 128 bits at a time with SSE2/NEON and have no tail.
+ * Counting uses the hardware popcount and searching uses tzcnt, so walking the set bits of a mostly
+ * empty set skips 64 clear bits per step:
+ *
+ *   for (uint64_t i = sl_bitset_next(&set, 0); i != SL_BITSET_NONE; i = sl_bitset_next(&set, i + 1))
+ *       use(i);
+ *
+ * sl_atomic_bitset has the same layout with atomic words, so job workers can mark bits concurrently.
+ * Its size is fixed while it is shared, and sl_atomic_bitset_set tells the caller whether it was the
+ * one that set the bit.
+ *
+ * A zeroed bitset is empty. Bits past num_bits are always clear.
+ */
+
+#if SL_CPU_X86 && (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64))
+#include <emmintrin.h>
+#define SL_BITSET_SSE2 1
+#elif SL_CPU_ARM && defined(__aarch64__)
+#include <arm_neon.h>
+#define SL_BITSET_NEON 1
+#endif
+
+#define SL_BITSET_NONE UINT64_MAX
+
+//Words needed for num_bits, rounded up to a whole 128 bit lane
+#define SL_BITSET_WORDS(num_bits) ((((num_bits) + 127) / 128) * 2)
+
+typedef struct sl_bitset
+{
+    uint64_t *words;
+    uint64_t num_words;
+    uint64_t num_bits;
+} sl_bitset;
+
+typedef struct sl_atomic_bitset
+{
+    sl_atomic_uint64_t *words;
+    uint64_t num_words;
+    uint64_t num_bits;
+} sl_atomic_bitset;
+
+SL_FORCE_INLINE uint32_t sl_bitset_ctz64(uint64_t word)
+{
+#if SL_COMPILER_MSVC
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctzll(word);
+#endif
+}
+
+SL_FORCE_INLINE uint64_t sl_bitset_popcount64(uint64_t word)
+{
+#if SL_COMPILER_MSVC
+    return __popcnt64(word);
+#else
+    return (uint64_t)__builtin_popcountll(word);
+#endif
+}
+
+//Clears the bits past num_bits so counting and searching never see them
+SL_FORCE_INLINE void sl_bitset_trim(sl_bitset *set)
+{
+    const uint64_t last = set->num_bits / 64;
+    if (last >= set->num_words)
+        return;
+    set->words[last] &= (1ull << (set->num_bits % 64)) - 1;
+    sl_memset(set->words + last + 1, 0, (set->num_words - last - 1) * sizeof(uint64_t));
+}
+
+/**
+ * @brief Resizes a Bitset, Keeping the Bits Below Both Sizes and Clearing New Ones
+ */
+SL_INLINE void sl_bitset_resize(sl_allocator *alloc, sl_bitset *set, uint64_t num_bits)
+{
+    const uint64_t num_words = SL_BITSET_WORDS(num_bits);
+    if (num_words != set->num_words) {
+        set->words = (uint64_t *)alloc->realloc(alloc, set->words, num_words * sizeof(uint64_t), 16, SL_FUNCTION, __FILE__, __LINE__);
+        if (num_words > set->num_words)
+            sl_memset(set->words + set->num_words, 0, (num_words - set->num_words) * sizeof(uint64_t));
+        set->num_words = num_words;
+    }
+    set->num_bits = num_bits;
+    sl_bitset_trim(set);
+}
+
+SL_INLINE void sl_bitset_free(sl_allocator *alloc, sl_bitset *set)
+{
+    if (set->words)
+        sl_free(alloc, set->words);
+    *set = (sl_bitset){ 0 };
+}
+
+SL_FORCE_INLINE void sl_bitset_set(sl_bitset *set, uint64_t bit)
+{
+    set->words[bit / 64] |= 1ull << (bit % 64);
+}
+
+SL_FORCE_INLINE void sl_bitset_clear(sl_bitset *set, uint64_t bit)
+{
+    set->words[bit / 64] &= ~(1ull << (bit % 64));
+}
+
+SL_FORCE_INLINE void sl_bitset_toggle(sl_bitset *set, uint64_t bit)
+{
+    set->words[bit / 64] ^= 1ull << (bit % 64);
+}
+
+SL_FORCE_INLINE bool sl_bitset_test(const sl_bitset *set, uint64_t bit)
+{
+    return (set->words[bit / 64] >> (bit % 64)) & 1;
+}
+
+SL_INLINE void sl_bitset_clear_all(sl_bitset *set)
+{
+    if (set->words)
+        sl_memset(set->words, 0, set->num_words * sizeof(uint64_t));
+}
+
+SL_INLINE void sl_bitset_set_all(sl_bitset *set)
+{
+    if (!set->words)
+        return;
+    sl_memset(set->words, 0xff, set->num_words * sizeof(uint64_t));
+    sl_bitset_trim(set);
+}
+
+SL_FORCE_INLINE void sl_bitset_finish_op(sl_bitset *dst, uint64_t n, bool clears)
+{
+    if (clears && n < dst->num_words)
+        sl_memset(dst->words + n, 0, (dst->num_words - n) * sizeof(uint64_t));
+    sl_bitset_trim(dst);
+}
+
+//dst = dst op src, 128 bits per step. src reads as 0 past its end, and clears that part of dst
+#if SL_BITSET_SSE2
+#define SL__BITSET_OP(name, sse, neon, scalar, clears) \
+SL_INLINE void sl_bitset_##name(sl_bitset *dst, const sl_bitset *src) \
+{ \
+const uint64_t n = dst->num_words < src->num_words ? dst->num_words : src->num_words; \
+for (uint64_t i = 0; i < n; i += 2) { \
+const __m128i d = _mm_loadu_si128((const __m128i *)(dst->words + i)); \
+const __m128i s = _mm_loadu_si128((const __m128i *)(src->words + i)); \
+_mm_storeu_si128((__m128i *)(dst->words + i), sse); \
+} \
+sl_bitset_finish_op(dst, n, clears); \
+}
+#elif SL_BITSET_NEON
+#define SL__BITSET_OP(name, sse, neon, scalar, clears) \
+SL_INLINE void sl_bitset_##name(sl_bitset *dst, const sl_bitset *src) \
+{ \
+const uint64_t n = dst->num_words < src->num_words ? dst->num_words : src->num_words; \
+for (uint64_t i = 0; i < n; i += 2) { \
+const uint64x2_t d = vld1q_u64(dst->words + i); \
+const uint64x2_t s = vld1q_u64(src->words + i); \
+vst1q_u64(dst->words + i, neon); \
+} \
+sl_bitset_finish_op(dst, n, clears); \
+}
+#else
+#define SL__BITSET_OP(name, sse, neon, scalar, clears) \
+SL_INLINE void sl_bitset_##name(sl_bitset *dst, const sl_bitset *src) \
+{ \
+const uint64_t n = dst->num_words < src->num_words ? dst->num_words : src->num_words; \
+for (uint64_t i = 0; i < n; ++i) { \
+const uint64_t d = dst->words[i]; \
+const uint64_t s = src->words[i]; \
+dst->words[i] = scalar; \
+} \
+sl_bitset_finish_op(dst, n, clears); \
+}
+#endif
+
+/**
+ * @brief dst &= src, Bits of dst Past the End of src are Cleared
+ */
+SL__BITSET_OP(and, _mm_and_si128(d, s), vandq_u64(d, s), d & s, true)
+
+/**
+ * @brief dst |= src, Bits of src Past the End of dst are Dropped
+ */
+SL__BITSET_OP(or, _mm_or_si128(d, s), vorrq_u64(d, s), d | s, false)
+
+/**
+ * @brief dst &= ~src
+ */
+SL__BITSET_OP(andnot, _mm_andnot_si128(s, d), vbicq_u64(d, s), d & ~s, false)
+
+/**
+ * @brief dst ^= src, Bits of src Past the End of dst are Dropped
+ */
+SL__BITSET_OP(xor, _mm_xor_si128(d, s), veorq_u64(d, s), d ^ s, false)
+
+/**
+ * @brief Number of Set Bits
+ */
+SL_INLINE uint64_t sl_bitset_count(const sl_bitset *set)
+{
+    uint64_t count = 0;
+#if SL_BITSET_NEON
+    //Byte counts summed per 128 bits
+    for (uint64_t i = 0; i < set->num_words; i += 2)
+        count += vaddlvq_u8(vcntq_u8(vreinterpretq_u8_u64(vld1q_u64(set->words + i))));
+#else
+    for (uint64_t i = 0; i < set->num_words; ++i)
+        count += sl_bitset_popcount64(set->words[i]);
+#endif
+    return count;
+}
+
+/**
+ * @brief Index of the First Set Bit at or After from, SL_BITSET_NONE if There is None
+ */
+SL_INLINE uint64_t sl_bitset_next(const sl_bitset *set, uint64_t from)
+{
+    if (from >= set->num_bits)
+        return SL_BITSET_NONE;
+    uint64_t i = from / 64;
+    uint64_t word = set->words[i] & (~0ull << (from % 64));
+    while (!word) {
+        if (++i == set->num_words)
+            return SL_BITSET_NONE;
+        word = set->words[i];
+    }
+    return i * 64 + sl_bitset_ctz64(word);
+}
+
+/**
+ * @brief Index of the First Clear Bit at or After from, SL_BITSET_NONE if There is None
+ */
+SL_INLINE uint64_t sl_bitset_next_clear(const sl_bitset *set, uint64_t from)
+{
+    if (from >= set->num_bits)
+        return SL_BITSET_NONE;
+    uint64_t i = from / 64;
+    uint64_t word = ~set->words[i] & (~0ull << (from % 64));
+    while (!word) {
+        if (++i == set->num_words)
+            return SL_BITSET_NONE;
+        word = ~set->words[i];
+    }
+    const uint64_t bit = i * 64 + sl_bitset_ctz64(word);
+    return bit < set->num_bits ? bit : SL_BITSET_NONE;
+}
+
+/**
+ * @brief Allocates a Zeroed Atomic Bitset, it Can't be Resized While Other Threads Use it
+ */
+SL_INLINE void sl_atomic_bitset_init(sl_allocator *alloc, sl_atomic_bitset *set, uint64_t num_bits)
+{
+    set->num_words = SL_BITSET_WORDS(num_bits);
+    set->num_bits = num_bits;
+    set->words = (sl_atomic_uint64_t *)alloc->realloc(alloc, NULL, set->num_words * sizeof(uint64_t), 16, SL_FUNCTION, __FILE__, __LINE__);
+    sl_memset((void *)set->words, 0, set->num_words * sizeof(uint64_t));
+}
+
+SL_INLINE void sl_atomic_bitset_free(sl_allocator *alloc, sl_atomic_bitset *set)
+{
+    if (set->words)
+        sl_free(alloc, (void *)set->words);
+    *set = (sl_atomic_bitset){ 0 };
+}
+
+/**
+ * @brief Sets a Bit, Returns True if this Call Changed it From 0 to 1
+ */
+SL_FORCE_INLINE bool sl_atomic_bitset_set(sl_atomic_bitset *set, uint64_t bit)
+{
+    const uint64_t mask = 1ull << (bit % 64);
+    return !(atomic_fetch_or_explicit(&set->words[bit / 64], mask, memory_order_acq_rel) & mask);
+}
+
+/**
+ * @brief Clears a Bit, Returns True if this Call Changed it From 1 to 0
+ */
+SL_FORCE_INLINE bool sl_atomic_bitset_clear(sl_atomic_bitset *set, uint64_t bit)
+{
+    const uint64_t mask = 1ull << (bit % 64);
+    return (atomic_fetch_and_explicit(&set->words[bit / 64], ~mask, memory_order_acq_rel) & mask) != 0;
+}
+
+SL_FORCE_INLINE bool sl_atomic_bitset_test(sl_atomic_bitset *set, uint64_t bit)
+{
+    return (atomic_load_explicit(&set->words[bit / 64], memory_order_acquire) >> (bit % 64)) & 1;
+}
+
+/**
+ * @brief Copies an Atomic Bitset into a Plain one to Run the Bulk Operations on it
+ * Bits set while copying may or may not show up.
+ */
+SL_INLINE void sl_atomic_bitset_load(sl_allocator *alloc, sl_atomic_bitset *src, sl_bitset *dst)
+{
+    sl_bitset_resize(alloc, dst, src->num_bits);
+    for (uint64_t i = 0; i < src->num_words; ++i)
+        dst->words[i] = atomic_load_explicit(&src->words[i], memory_order_acquire);
+}
+
+#endif //STARLIGHT_BITSET_INL
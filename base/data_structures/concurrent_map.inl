@@ -0,0 +1,288 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_CONCURRENT_MAP_INL
+#define STARLIGHT_CONCURRENT_MAP_INL
+
+#include "defines.h"
+#include "memory/allocator.h"
+#include "thread/atomics.inl"
+#include "thread/spinlock.inl"
+
+/*
+ * uint64_t -> uint64_t hash map for tables that are read far more often than written
+ * (api registry, thread tables). Readers never lock or wait. Writers are serialised by a spinlock
+ * and publish with release stores, so a reader sees either the old or the new value of a key.
+ *
+ * Growing is incremental: a write that finds the table 3/4 full links a bigger table behind it,
+ * and every following write moves SL_CONCURRENT_MAP_MIGRATE_STEP slots across, marking them
+ * SL_CONCURRENT_MAP_MOVED. Readers follow a moved or missing key into the next table, so nobody
+ * stops while the move is in progress. Old tables are only freed by sl_concurrent_map_free, since
+ * readers may still be probing them.
+ *
+ * Key 0 is reserved for empty slots. Values must be below SL_CONCURRENT_MAP_MOVED.
+ */
+
+#define SL_CONCURRENT_MAP_MIN_CAPACITY 16
+
+//Old slots moved to the new table by each write while the map grows
+#define SL_CONCURRENT_MAP_MIGRATE_STEP 64
+
+#define SL_CONCURRENT_MAP_DELETED UINT64_MAX
+#define SL_CONCURRENT_MAP_MOVED (UINT64_MAX - 1)
+
+typedef struct sl_concurrent_map_slot
+{
+    sl_atomic_uint64_t key;
+    sl_atomic_uint64_t value;
+} sl_concurrent_map_slot;
+
+typedef struct sl_concurrent_map_table
+{
+    uint64_t capacity;
+    //Keys ever placed in this table, removed ones included
+    uint64_t used;
+    //Table the entries are being moved to (sl_concurrent_map_table*)
+    sl_atomic_uint64_t next;
+    //Table this one replaced
+    struct sl_concurrent_map_table *retired;
+    sl_concurrent_map_slot slots[];
+} sl_concurrent_map_table;
+
+typedef struct sl_concurrent_map
+{
+    sl_allocator *allocator;
+    //Current table (sl_concurrent_map_table*)
+    sl_atomic_uint64_t table;
+    sl_atomic_uint64_t size;
+    sl_spinlock write_lock;
+    //Next slot of the current table to move while growing
+    uint64_t migrate_index;
+} sl_concurrent_map;
+
+SL_FORCE_INLINE uint64_t sl_concurrent_map_mix(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    return key;
+}
+
+SL_FORCE_INLINE sl_concurrent_map_table *sl_concurrent_map_load(sl_atomic_uint64_t *p)
+{
+    return (sl_concurrent_map_table *)(uintptr_t)atomic_load_explicit(p, memory_order_acquire);
+}
+
+SL_FORCE_INLINE uint64_t sl_concurrent_map_capacity_for(uint64_t count)
+{
+    uint64_t capacity = SL_CONCURRENT_MAP_MIN_CAPACITY;
+    while (capacity / 4 * 3 < count)
+        capacity *= 2;
+    return capacity;
+}
+
+//Slot holding key, or NULL once an empty slot proves it isn't in this table
+SL_FORCE_INLINE sl_concurrent_map_slot *sl_concurrent_map_probe(sl_concurrent_map_table *t, uint64_t key)
+{
+    const uint64_t mask = t->capacity - 1;
+    for (uint64_t i = sl_concurrent_map_mix(key) & mask;; i = (i + 1) & mask) {
+        const uint64_t k = atomic_load_explicit(&t->slots[i].key, memory_order_acquire);
+        if (k == key)
+            return t->slots + i;
+        if (!k)
+            return NULL;
+    }
+}
+
+/**
+ * @brief Looks Up a Key Without Locking
+ * @param value Set to the Value if the Key was Found. Can be NULL
+ * @returns True if the Key is in the Map
+ */
+SL_FORCE_INLINE bool sl_concurrent_map_get(sl_concurrent_map *map, uint64_t key, uint64_t *value)
+{
+    for (sl_concurrent_map_table *t = sl_concurrent_map_load(&map->table); t; t = sl_concurrent_map_load(&t->next)) {
+        const sl_concurrent_map_slot *s = sl_concurrent_map_probe(t, key);
+        const uint64_t v = s ? atomic_load_explicit(&s->value, memory_order_acquire) : SL_CONCURRENT_MAP_MOVED;
+        if (v == SL_CONCURRENT_MAP_MOVED)
+            continue;
+        if (v == SL_CONCURRENT_MAP_DELETED)
+            return false;
+        if (value)
+            *value = v;
+        return true;
+    }
+    return false;
+}
+
+SL_INLINE sl_concurrent_map_table *sl_concurrent_map_new_table(sl_allocator *alloc, uint64_t capacity)
+{
+    const uint64_t bytes = sizeof(sl_concurrent_map_table) + capacity * sizeof(sl_concurrent_map_slot);
+    sl_concurrent_map_table *t = (sl_concurrent_map_table *)sl_alloc(alloc, bytes);
+    sl_memset(t, 0, bytes);
+    t->capacity = capacity;
+    return t;
+}
+
+/**
+ * @brief Initializes an Empty Map
+ * @param alloc Allocator the Tables are Allocated With
+ * @param capacity Number of Keys to Make Room For
+ */
+SL_INLINE void sl_concurrent_map_init(sl_concurrent_map *map, sl_allocator *alloc, uint64_t capacity)
+{
+    sl_memset(map, 0, sizeof(*map));
+    map->allocator = alloc;
+    sl_spinlock_init(&map->write_lock);
+    atomic_store_explicit(&map->table, (uint64_t)(uintptr_t)sl_concurrent_map_new_table(alloc, sl_concurrent_map_capacity_for(capacity)),
+                          memory_order_release);
+}
+
+//Writer only. The value is published before the key, so a reader that finds the key sees it
+SL_INLINE void sl_concurrent_map_store(sl_concurrent_map_table *t, uint64_t key, uint64_t value)
+{
+    const uint64_t mask = t->capacity - 1;
+    for (uint64_t i = sl_concurrent_map_mix(key) & mask;; i = (i + 1) & mask) {
+        sl_concurrent_map_slot *s = t->slots + i;
+        const uint64_t k = atomic_load_explicit(&s->key, memory_order_relaxed);
+        if (k == key) {
+            atomic_store_explicit(&s->value, value, memory_order_release);
+            return;
+        }
+        if (!k) {
+            atomic_store_explicit(&s->value, value, memory_order_relaxed);
+            atomic_store_explicit(&s->key, key, memory_order_release);
+            t->used += 1;
+            return;
+        }
+    }
+}
+
+//Writer only. Moves up to count slots into the next table and swaps tables once all are moved
+SL_INLINE void sl_concurrent_map_migrate(sl_concurrent_map *map, uint64_t count)
+{
+    sl_concurrent_map_table *t = sl_concurrent_map_load(&map->table);
+    sl_concurrent_map_table *n = sl_concurrent_map_load(&t->next);
+
+    for (; count && map->migrate_index < t->capacity; --count, ++map->migrate_index) {
+        sl_concurrent_map_slot *s = t->slots + map->migrate_index;
+        const uint64_t k = atomic_load_explicit(&s->key, memory_order_relaxed);
+        const uint64_t v = atomic_load_explicit(&s->value, memory_order_relaxed);
+        if (!k || v == SL_CONCURRENT_MAP_DELETED || v == SL_CONCURRENT_MAP_MOVED)
+            continue;
+        sl_concurrent_map_store(n, k, v);
+        atomic_store_explicit(&s->value, SL_CONCURRENT_MAP_MOVED, memory_order_release);
+    }
+
+    if (map->migrate_index == t->capacity) {
+        n->retired = t;
+        map->migrate_index = 0;
+        atomic_store_explicit(&map->table, (uint64_t)(uintptr_t)n, memory_order_release);
+    }
+}
+
+//Writer only
+SL_INLINE void sl_concurrent_map_write(sl_concurrent_map *map, uint64_t key, uint64_t value)
+{
+    sl_concurrent_map_table *t = sl_concurrent_map_load(&map->table);
+    sl_concurrent_map_table *n = sl_concurrent_map_load(&t->next);
+
+    if (!n && (t->used + 1) * 4 > t->capacity * 3) {
+        //Big enough that the writes made while moving can't fill it up
+        const uint64_t live = atomic_load_explicit(&map->size, memory_order_relaxed);
+        n = sl_concurrent_map_new_table(map->allocator, sl_concurrent_map_capacity_for(2 * (live + t->capacity / SL_CONCURRENT_MAP_MIGRATE_STEP + 1)));
+        map->migrate_index = 0;
+        atomic_store_explicit(&t->next, (uint64_t)(uintptr_t)n, memory_order_release);
+    }
+
+    if (n) {
+        sl_concurrent_map_store(n, key, value);
+        sl_concurrent_map_slot *s = sl_concurrent_map_probe(t, key);
+        if (s)
+            atomic_store_explicit(&s->value, SL_CONCURRENT_MAP_MOVED, memory_order_release);
+        sl_concurrent_map_migrate(map, SL_CONCURRENT_MAP_MIGRATE_STEP);
+    } else if (value == SL_CONCURRENT_MAP_DELETED) {
+        sl_concurrent_map_slot *s = sl_concurrent_map_probe(t, key);
+        if (s)
+            atomic_store_explicit(&s->value, SL_CONCURRENT_MAP_DELETED, memory_order_release);
+    } else {
+        sl_concurrent_map_store(t, key, value);
+    }
+}
+
+/**
+ * @brief Inserts or Overwrites a Key
+ * @returns True if the Key was New
+ */
+SL_INLINE bool sl_concurrent_map_set(sl_concurrent_map *map, uint64_t key, uint64_t value)
+{
+    sl_spinlock_lock(&map->write_lock);
+    const bool added = !sl_concurrent_map_get(map, key, NULL);
+    sl_concurrent_map_write(map, key, value);
+    if (added)
+        atomic_fetch_add(&map->size, 1);
+    sl_spinlock_unlock(&map->write_lock);
+    return added;
+}
+
+/**
+ * @brief Removes a Key
+ * @returns True if the Key was in the Map
+ */
+SL_INLINE bool sl_concurrent_map_remove(sl_concurrent_map *map, uint64_t key)
+{
+    sl_spinlock_lock(&map->write_lock);
+    const bool found = sl_concurrent_map_get(map, key, NULL);
+    if (found) {
+        sl_concurrent_map_write(map, key, SL_CONCURRENT_MAP_DELETED);
+        atomic_fetch_sub(&map->size, 1);
+    }
+    sl_spinlock_unlock(&map->write_lock);
+    return found;
+}
+
+SL_FORCE_INLINE uint64_t sl_concurrent_map_size(sl_concurrent_map *map)
+{
+    return atomic_load_explicit(&map->size, memory_order_relaxed);
+}
+
+/**
+ * @brief Frees Every Table. No Other Thread may Use the Map Anymore
+ */
+SL_INLINE void sl_concurrent_map_free(sl_concurrent_map *map)
+{
+    sl_concurrent_map_table *t = sl_concurrent_map_load(&map->table);
+    sl_concurrent_map_table *n = t ? sl_concurrent_map_load(&t->next) : NULL;
+    if (n)
+        sl_free(map->allocator, n);
+
+    while (t) {
+        sl_concurrent_map_table *retired = t->retired;
+        sl_free(map->allocator, t);
+        t = retired;
+    }
+    atomic_store_explicit(&map->table, 0, memory_order_relaxed);
+    atomic_store_explicit(&map->size, 0, memory_order_relaxed);
+}
+
+#endif //STARLIGHT_CONCURRENT_MAP_INL
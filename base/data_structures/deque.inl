@@ -0,0 +1,155 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_DEQUE_INL
+#define STARLIGHT_DEQUE_INL
+
+#include "defines.h"
+#include "memory/allocator.h"
+
+/*
+ * Growable double ended queue made of fixed size blocks. Elements are addressed by a position that
+ * counts up from the back and down from the front (wrapping is fine, everything is masked), and a
+ * position's block lives in a ring of block pointers. Growing only allocates a block or, once the
+ * ring is full, moves the block pointers into a ring twice the size. Elements never move, so pushing
+ * and popping at either end is O(1) without ever re-linearising the contents, and pointers to
+ * elements stay valid until the element is popped.
+ *
+ * MAKE_DEQUE_TYPE(name, type, block_shift) declares sl_deque_name, with blocks of 1 << block_shift elements:
+ *
+ *   sl_deque_name_push_back(alloc, deque, value)
+ *   sl_deque_name_push_front(alloc, deque, value)
+ *   sl_deque_name_pop_back(deque, value)        false if empty, value can be NULL
+ *   sl_deque_name_pop_front(deque, value)       false if empty, value can be NULL
+ *   sl_deque_name_at(deque, i)                  pointer to element i, 0 is the front
+ *   sl_deque_name_front(deque) / back(deque)    pointer or NULL if empty
+ *   sl_deque_name_clear(deque)                  keeps the blocks for reuse
+ *   sl_deque_name_free(alloc, deque)
+ *
+ * deque.size is the number of elements and a zeroed deque is empty.
+ */
+
+#define SL_DEQUE_MIN_BLOCKS 8
+
+#define MAKE_DEQUE_TYPE(name, type, block_shift) \
+typedef struct sl_deque_##name \
+{ \
+type **blocks; \
+uint64_t num_blocks; \
+uint64_t begin; \
+uint64_t size; \
+} sl_deque_##name; \
+SL_FORCE_INLINE type *sl_deque_##name##_slot(const sl_deque_##name *deque, uint64_t position) \
+{ \
+return deque->blocks[(position >> (block_shift)) & (deque->num_blocks - 1)] + (position & ((1ull << (block_shift)) - 1)); \
+} \
+SL_FORCE_INLINE type *sl_deque_##name##_at(const sl_deque_##name *deque, uint64_t i) \
+{ \
+return sl_deque_##name##_slot(deque, deque->begin + i); \
+} \
+SL_INLINE void sl_deque_##name##_grow(sl_allocator *alloc, sl_deque_##name *deque, uint64_t first, uint64_t last) \
+{ \
+const uint64_t first_block = first >> (block_shift); \
+const uint64_t span = ((last - (first & ~((1ull << (block_shift)) - 1))) >> (block_shift)) + 1; \
+if (span > deque->num_blocks) { \
+uint64_t num_blocks = deque->num_blocks ? deque->num_blocks * 2 : SL_DEQUE_MIN_BLOCKS; \
+while (num_blocks < span) \
+num_blocks *= 2; \
+type **blocks = (type **)sl_alloc(alloc, num_blocks * sizeof(type *)); \
+sl_memset(blocks, 0, num_blocks * sizeof(type *)); \
+const uint64_t old_first = deque->begin >> (block_shift); \
+for (uint64_t i = 0; i < deque->num_blocks; ++i) \
+blocks[(old_first + i) & (num_blocks - 1)] = deque->blocks[(old_first + i) & (deque->num_blocks - 1)]; \
+if (deque->blocks) \
+sl_free(alloc, deque->blocks); \
+deque->blocks = blocks; \
+deque->num_blocks = num_blocks; \
+} \
+for (uint64_t i = 0; i < span; ++i) { \
+type **block = deque->blocks + ((first_block + i) & (deque->num_blocks - 1)); \
+if (!*block) \
+*block = (type *)sl_alloc(alloc, sizeof(type) << (block_shift)); \
+} \
+} \
+SL_INLINE type *sl_deque_##name##_push_back(sl_allocator *alloc, sl_deque_##name *deque, type value) \
+{ \
+const uint64_t position = deque->begin + deque->size; \
+sl_deque_##name##_grow(alloc, deque, deque->begin, position); \
+type *e = sl_deque_##name##_slot(deque, position); \
+*e = value; \
+deque->size += 1; \
+return e; \
+} \
+SL_INLINE type *sl_deque_##name##_push_front(sl_allocator *alloc, sl_deque_##name *deque, type value) \
+{ \
+const uint64_t position = deque->begin - 1; \
+sl_deque_##name##_grow(alloc, deque, position, position + deque->size); \
+type *e = sl_deque_##name##_slot(deque, position); \
+*e = value; \
+deque->begin = position; \
+deque->size += 1; \
+return e; \
+} \
+SL_INLINE bool sl_deque_##name##_pop_back(sl_deque_##name *deque, type *value) \
+{ \
+if (!deque->size) \
+return false; \
+deque->size -= 1; \
+if (value) \
+*value = *sl_deque_##name##_at(deque, deque->size); \
+return true; \
+} \
+SL_INLINE bool sl_deque_##name##_pop_front(sl_deque_##name *deque, type *value) \
+{ \
+if (!deque->size) \
+return false; \
+if (value) \
+*value = *sl_deque_##name##_at(deque, 0); \
+deque->begin += 1; \
+deque->size -= 1; \
+return true; \
+} \
+SL_FORCE_INLINE type *sl_deque_##name##_front(const sl_deque_##name *deque) \
+{ \
+return deque->size ? sl_deque_##name##_at(deque, 0) : NULL; \
+} \
+SL_FORCE_INLINE type *sl_deque_##name##_back(const sl_deque_##name *deque) \
+{ \
+return deque->size ? sl_deque_##name##_at(deque, deque->size - 1) : NULL; \
+} \
+SL_INLINE void sl_deque_##name##_clear(sl_deque_##name *deque) \
+{ \
+deque->begin = 0; \
+deque->size = 0; \
+} \
+SL_INLINE void sl_deque_##name##_free(sl_allocator *alloc, sl_deque_##name *deque) \
+{ \
+for (uint64_t i = 0; i < deque->num_blocks; ++i) \
+if (deque->blocks[i]) \
+sl_free(alloc, deque->blocks[i]); \
+if (deque->blocks) \
+sl_free(alloc, deque->blocks); \
+*deque = (sl_deque_##name){ 0 }; \
+}
+
+#endif //STARLIGHT_DEQUE_INL
@@ -0,0 +1,401 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_FLAT_MAP_INL
+#define STARLIGHT_FLAT_MAP_INL
+
+#include "defines.h"
+#include "memory/allocator.h"
+
+/*
+ * Open addressing map and set for uint32_t/uint64_t keys, for the small integer -> index tables
+ * on hot paths (thread id -> semaphore, hash -> trace). Keys are stored inline in one array, with no
+ * control bytes and no hash header: an empty slot holds key 0, and key 0 itself lives in
+ * has_zero/zero_value. The first 64 bytes of keys are stored inside the map itself, so a map of a
+ * few keys never allocates and a lookup is a compare of the whole inline array.
+ *
+ * Once the keys spill, slots are probed in groups of 32 bytes (8 uint32_t or 4 uint64_t keys)
+ * compared at once with SSE2/NEON. A key lives in the first group from its home group that had a
+ * free slot, so a lookup stops at the first group holding a 0. Removing a key pulls a later key
+ * back into the hole if it probed past it, so there are no tombstones.
+ *
+ * The hash is a xor-shift and a multiply with the top bits picking the group, cheap enough that the
+ * keys (usually already hashes or ids) aren't hashed a second time.
+ *
+ * MAKE_FLAT_MAP_TYPE(name, key_type, value_type) declares sl_flat_map_name:
+ *
+ *   sl_flat_map_name_reserve(alloc, map, count)         room for count keys without growing again
+ *   sl_flat_map_name_insert(alloc, map, key, value)     inserts or overwrites, returns the value
+ *   sl_flat_map_name_insert_bulk(alloc, map, keys, values, count)
+ *   sl_flat_map_name_get(map, key)                      pointer to the value or NULL
+ *   sl_flat_map_name_remove(map, key, value)            true if the key was there, value can be NULL
+ *   sl_flat_map_name_clear(map)
+ *   sl_flat_map_name_free(alloc, map)
+ *
+ * MAKE_FLAT_SET_TYPE(name, key_type) declares sl_flat_set_name with the same functions, except
+ * insert(alloc, set, key) returns true if the key was added, contains replaces get and remove
+ * takes no value.
+ *
+ * A zeroed map is empty. Iterating (key 0 is only in has_zero/zero_value):
+ *
+ *   const uint64_t slots = sl_flat_map_name_slots(&map);
+ *   for (uint64_t i = sl_flat_map_name_next(&map, 0); i < slots; i = sl_flat_map_name_next(&map, i + 1))
+ *       use(sl_flat_map_name_keys(&map)[i], sl_flat_map_name_values(&map)[i]);
+ *
+ * sl_flat_map_u32 (uint32_t -> uint32_t), sl_flat_map_u64 (uint64_t -> uint64_t), sl_flat_set_u32
+ * and sl_flat_set_u64 are declared below.
+ */
+
+#if SL_CPU_X86 && (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64))
+#include <emmintrin.h>
+#define SL_FLAT_SSE2 1
+#elif SL_CPU_ARM && defined(__aarch64__)
+#include <arm_neon.h>
+#define SL_FLAT_NEON 1
+#endif
+
+#define SL_FLAT_GROUP_BYTES 32
+#define SL_FLAT_INLINE_BYTES 64
+#define SL_FLAT_MIN_GROUPS 4
+#define SL_FLAT_NOT_FOUND UINT64_MAX
+
+#define SL_FLAT_LANES(key_type) (SL_FLAT_GROUP_BYTES / sizeof(key_type))
+#define SL_FLAT_INLINE_SLOTS(key_type) (SL_FLAT_INLINE_BYTES / sizeof(key_type))
+
+//Maximum load is 3/4, groups fill up faster than single slots
+#define SL_FLAT_MAX_SIZE(capacity) ((capacity) - (capacity) / 4)
+
+SL_FORCE_INLINE uint64_t sl_flat_hash(uint64_t x)
+{
+    x ^= x >> 32;
+    return x * 0x9e3779b97f4a7c15ull;
+}
+
+SL_FORCE_INLINE uint32_t sl_flat_ctz(uint32_t mask)
+{
+#if SL_COMPILER_MSVC
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(mask);
+#endif
+}
+
+//Bit i is set if keys[i] == key, for a group of 8 keys
+SL_FORCE_INLINE uint32_t sl_flat_match32(const uint32_t *keys, uint32_t key)
+{
+#if SL_FLAT_SSE2
+    const __m128i k = _mm_set1_epi32((int)key);
+    const __m128i lo = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)keys), k);
+    const __m128i hi = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(keys + 4)), k);
+    return (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(lo)) | ((uint32_t)_mm_movemask_ps(_mm_castsi128_ps(hi)) << 4);
+#elif SL_FLAT_NEON
+    static const uint32_t bits[4] = {1, 2, 4, 8};
+    const uint32x4_t k = vdupq_n_u32(key);
+    const uint32x4_t b = vld1q_u32(bits);
+    const uint32x4_t lo = vandq_u32(vceqq_u32(vld1q_u32(keys), k), b);
+    const uint32x4_t hi = vandq_u32(vceqq_u32(vld1q_u32(keys + 4), k), b);
+    return vaddvq_u32(lo) | (vaddvq_u32(hi) << 4);
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < 8; ++i)
+        mask |= (uint32_t)(keys[i] == key) << i;
+    return mask;
+#endif
+}
+
+//Bit i is set if keys[i] == key, for a group of 4 keys
+SL_FORCE_INLINE uint32_t sl_flat_match64(const uint64_t *keys, uint64_t key)
+{
+#if SL_FLAT_SSE2
+    //SSE2 has no 64 bit compare, both 32 bit halves have to match
+    const __m128i k = _mm_set1_epi64x((long long)key);
+    __m128i lo = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)keys), k);
+    __m128i hi = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(keys + 2)), k);
+    lo = _mm_and_si128(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+    hi = _mm_and_si128(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(lo)) | ((uint32_t)_mm_movemask_pd(_mm_castsi128_pd(hi)) << 2);
+#elif SL_FLAT_NEON
+    static const uint64_t bits[2] = {1, 2};
+    const uint64x2_t k = vdupq_n_u64(key);
+    const uint64x2_t b = vld1q_u64(bits);
+    const uint64x2_t lo = vandq_u64(vceqq_u64(vld1q_u64(keys), k), b);
+    const uint64x2_t hi = vandq_u64(vceqq_u64(vld1q_u64(keys + 2), k), b);
+    return (uint32_t)vaddvq_u64(lo) | ((uint32_t)vaddvq_u64(hi) << 2);
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < 4; ++i)
+        mask |= (uint32_t)(keys[i] == key) << i;
+    return mask;
+#endif
+}
+
+#define SL_FLAT_MATCH(key_type, group, key) \
+(sizeof(key_type) == 4 ? sl_flat_match32((const uint32_t *)(group), (uint32_t)(key)) \
+                       : sl_flat_match64((const uint64_t *)(group), (uint64_t)(key)))
+
+//Shared by the map and the set, the set stores no values
+#define SL__MAKE_FLAT_TABLE(type, key_type, value_type, has_values) \
+typedef struct type \
+{ \
+key_type *keys; \
+value_type *values; \
+uint64_t capacity; \
+uint64_t size; \
+uint32_t shift; \
+bool has_zero; \
+value_type zero_value; \
+key_type small_keys[SL_FLAT_INLINE_SLOTS(key_type)]; \
+value_type small_values[has_values ? SL_FLAT_INLINE_SLOTS(key_type) : 1]; \
+} type; \
+SL_INLINE uint64_t type##_slots(const type *map) \
+{ \
+return map->capacity ? map->capacity : SL_FLAT_INLINE_SLOTS(key_type); \
+} \
+SL_INLINE key_type *type##_keys(type *map) \
+{ \
+return map->capacity ? map->keys : map->small_keys; \
+} \
+SL_INLINE value_type *type##_values(type *map) \
+{ \
+return map->capacity ? map->values : map->small_values; \
+} \
+SL_INLINE uint64_t type##_find(const type *map, key_type key, bool empty) \
+{ \
+const uint64_t lanes = SL_FLAT_LANES(key_type); \
+const key_type probe = empty ? 0 : key; \
+if (!map->capacity) { \
+for (uint64_t g = 0; g < SL_FLAT_INLINE_SLOTS(key_type); g += lanes) { \
+const uint32_t m = SL_FLAT_MATCH(key_type, map->small_keys + g, probe); \
+if (m) \
+return g + sl_flat_ctz(m); \
+} \
+return SL_FLAT_NOT_FOUND; \
+} \
+const uint64_t group_mask = map->capacity / lanes - 1; \
+for (uint64_t g = sl_flat_hash((uint64_t)key) >> map->shift;; g = (g + 1) & group_mask) { \
+const key_type *group = map->keys + g * lanes; \
+const uint32_t m = SL_FLAT_MATCH(key_type, group, probe); \
+if (m) \
+return g * lanes + sl_flat_ctz(m); \
+if (!empty && SL_FLAT_MATCH(key_type, group, 0)) \
+return SL_FLAT_NOT_FOUND; \
+} \
+} \
+SL_INLINE void type##_rehash(sl_allocator *alloc, type *map, uint64_t capacity) \
+{ \
+type old = *map; \
+const uint64_t key_bytes = capacity * sizeof(key_type); \
+uint8_t *memory = (uint8_t *)sl_alloc(alloc, key_bytes + (has_values ? capacity * sizeof(value_type) : 0)); \
+sl_memset(memory, 0, key_bytes); \
+map->keys = (key_type *)memory; \
+map->values = has_values ? (value_type *)(memory + key_bytes) : NULL; \
+map->capacity = capacity; \
+uint32_t bits = 0; \
+while ((1ull << bits) < capacity / SL_FLAT_LANES(key_type)) \
+++bits; \
+map->shift = 64 - bits; \
+const uint64_t old_slots = type##_slots(&old); \
+const key_type *old_keys = old.capacity ? old.keys : old.small_keys; \
+const value_type *old_values = old.capacity ? old.values : old.small_values; \
+for (uint64_t i = 0; i < old_slots; ++i) { \
+if (!old_keys[i]) \
+continue; \
+const uint64_t slot = type##_find(map, old_keys[i], true); \
+map->keys[slot] = old_keys[i]; \
+if (has_values) \
+map->values[slot] = old_values[i]; \
+} \
+if (old.capacity) \
+sl_free(alloc, old.keys); \
+} \
+SL_INLINE uint64_t type##_capacity_for(uint64_t count) \
+{ \
+uint64_t capacity = SL_FLAT_MIN_GROUPS * SL_FLAT_LANES(key_type); \
+while (SL_FLAT_MAX_SIZE(capacity) < count) \
+capacity *= 2; \
+return capacity; \
+} \
+SL_INLINE void type##_reserve(sl_allocator *alloc, type *map, uint64_t count) \
+{ \
+if (map->capacity ? count > SL_FLAT_MAX_SIZE(map->capacity) : count > SL_FLAT_INLINE_SLOTS(key_type)) \
+type##_rehash(alloc, map, type##_capacity_for(count)); \
+} \
+SL_INLINE uint64_t type##_add(sl_allocator *alloc, type *map, key_type key, bool *added) \
+{ \
+uint64_t i = type##_find(map, key, false); \
+*added = i == SL_FLAT_NOT_FOUND; \
+if (*added) { \
+const uint64_t stored = map->size - map->has_zero; \
+if (map->capacity ? stored + 1 > SL_FLAT_MAX_SIZE(map->capacity) : stored == SL_FLAT_INLINE_SLOTS(key_type)) \
+type##_rehash(alloc, map, map->capacity ? map->capacity * 2 : type##_capacity_for(stored + 1)); \
+i = type##_find(map, key, true); \
+type##_keys(map)[i] = key; \
+map->size += 1; \
+} \
+return i; \
+} \
+SL_INLINE void type##_erase(type *map, uint64_t i) \
+{ \
+map->size -= 1; \
+if (!map->capacity) { \
+map->small_keys[i] = 0; \
+return; \
+} \
+const uint64_t lanes = SL_FLAT_LANES(key_type); \
+const uint64_t group_mask = map->capacity / lanes - 1; \
+uint64_t hole = i; \
+for (uint64_t g = (i / lanes + 1) & group_mask;; g = (g + 1) & group_mask) { \
+const key_type *group = map->keys + g * lanes; \
+const bool full = !SL_FLAT_MATCH(key_type, group, 0); \
+const uint64_t hole_group = hole / lanes; \
+for (uint64_t j = 0; j < lanes; ++j) { \
+const key_type k = group[j]; \
+if (!k) \
+continue; \
+const uint64_t home = sl_flat_hash((uint64_t)k) >> map->shift; \
+if (((g - home) & group_mask) >= ((g - hole_group) & group_mask)) { \
+map->keys[hole] = k; \
+if (has_values) \
+map->values[hole] = map->values[g * lanes + j]; \
+hole = g * lanes + j; \
+break; \
+} \
+} \
+if (!full) \
+break; \
+} \
+map->keys[hole] = 0; \
+} \
+SL_INLINE void type##_clear(type *map) \
+{ \
+sl_memset(type##_keys(map), 0, type##_slots(map) * sizeof(key_type)); \
+map->size = 0; \
+map->has_zero = false; \
+} \
+SL_INLINE void type##_free(sl_allocator *alloc, type *map) \
+{ \
+if (map->capacity) \
+sl_free(alloc, map->keys); \
+*map = (type){ 0 }; \
+} \
+SL_INLINE uint64_t type##_next(type *map, uint64_t index) \
+{ \
+const uint64_t slots = type##_slots(map); \
+const key_type *keys = type##_keys(map); \
+while (index < slots && !keys[index]) \
+++index; \
+return index; \
+}
+
+#define MAKE_FLAT_MAP_TYPE(name, key_type, value_type) \
+SL__MAKE_FLAT_TABLE(sl_flat_map_##name, key_type, value_type, 1) \
+SL_INLINE value_type *sl_flat_map_##name##_insert(sl_allocator *alloc, sl_flat_map_##name *map, key_type key, value_type value) \
+{ \
+value_type *v; \
+if (!key) { \
+map->size += !map->has_zero; \
+map->has_zero = true; \
+v = &map->zero_value; \
+} else { \
+bool added; \
+const uint64_t i = sl_flat_map_##name##_add(alloc, map, key, &added); \
+v = sl_flat_map_##name##_values(map) + i; \
+} \
+*v = value; \
+return v; \
+} \
+SL_INLINE void sl_flat_map_##name##_insert_bulk(sl_allocator *alloc, sl_flat_map_##name *map, key_type const *keys, value_type const *values, uint64_t count) \
+{ \
+sl_flat_map_##name##_reserve(alloc, map, map->size + count); \
+for (uint64_t i = 0; i < count; ++i) \
+sl_flat_map_##name##_insert(alloc, map, keys[i], values[i]); \
+} \
+SL_INLINE value_type *sl_flat_map_##name##_get(sl_flat_map_##name *map, key_type key) \
+{ \
+if (!key) \
+return map->has_zero ? &map->zero_value : NULL; \
+const uint64_t i = sl_flat_map_##name##_find(map, key, false); \
+return i == SL_FLAT_NOT_FOUND ? NULL : sl_flat_map_##name##_values(map) + i; \
+} \
+SL_INLINE bool sl_flat_map_##name##_remove(sl_flat_map_##name *map, key_type key, value_type *value) \
+{ \
+if (!key) { \
+if (!map->has_zero) \
+return false; \
+if (value) \
+*value = map->zero_value; \
+map->has_zero = false; \
+map->size -= 1; \
+return true; \
+} \
+const uint64_t i = sl_flat_map_##name##_find(map, key, false); \
+if (i == SL_FLAT_NOT_FOUND) \
+return false; \
+if (value) \
+*value = sl_flat_map_##name##_values(map)[i]; \
+sl_flat_map_##name##_erase(map, i); \
+return true; \
+}
+
+#define MAKE_FLAT_SET_TYPE(name, key_type) \
+SL__MAKE_FLAT_TABLE(sl_flat_set_##name, key_type, uint8_t, 0) \
+SL_INLINE bool sl_flat_set_##name##_insert(sl_allocator *alloc, sl_flat_set_##name *set, key_type key) \
+{ \
+if (!key) { \
+const bool added = !set->has_zero; \
+set->size += added; \
+set->has_zero = true; \
+return added; \
+} \
+bool added; \
+sl_flat_set_##name##_add(alloc, set, key, &added); \
+return added; \
+} \
+SL_INLINE bool sl_flat_set_##name##_contains(const sl_flat_set_##name *set, key_type key) \
+{ \
+return key ? sl_flat_set_##name##_find(set, key, false) != SL_FLAT_NOT_FOUND : set->has_zero; \
+} \
+SL_INLINE bool sl_flat_set_##name##_remove(sl_flat_set_##name *set, key_type key) \
+{ \
+if (!key) { \
+if (!set->has_zero) \
+return false; \
+set->has_zero = false; \
+set->size -= 1; \
+return true; \
+} \
+const uint64_t i = sl_flat_set_##name##_find(set, key, false); \
+if (i == SL_FLAT_NOT_FOUND) \
+return false; \
+sl_flat_set_##name##_erase(set, i); \
+return true; \
+}
+
+MAKE_FLAT_MAP_TYPE(u32, uint32_t, uint32_t)
+MAKE_FLAT_MAP_TYPE(u64, uint64_t, uint64_t)
+MAKE_FLAT_SET_TYPE(u32, uint32_t)
+MAKE_FLAT_SET_TYPE(u64, uint64_t)
+
+#endif //STARLIGHT_FLAT_MAP_INL
@@ -0,0 +1,147 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_HANDLE_POOL_INL
+#define STARLIGHT_HANDLE_POOL_INL
+
+#include "defines.h"
+#include "memory/allocator.h"
+#include "data_structures/array.inl"
+#include "util/assertions.inl"
+
+/*
+ * Pool of objects referred to by 32 bit generational handles, laid out as a sparse set.
+ * Objects are packed in a dense array so iterating them is a linear walk. A handle holds an index
+ * into a sparse array, which points at the object's dense slot, and the generation of that sparse
+ * slot when the handle was made. Destroying an object bumps its slot's generation, so a stale handle
+ * is detected instead of reaching whatever reused the slot. Create, destroy and lookup are O(1).
+ *
+ * MAKE_HANDLE_POOL_TYPE(name, type) declares sl_handle_pool_name:
+ *
+ *   sl_handle_pool_name_create(alloc, pool, value)   stores value, returns its handle
+ *   sl_handle_pool_name_get(pool, handle)            pointer to the object or NULL if the handle is stale
+ *   sl_handle_pool_name_valid(pool, handle)
+ *   sl_handle_pool_name_destroy(pool, handle)        false if the handle was stale
+ *   sl_handle_pool_name_handle(pool, i)              handle of the object in dense slot i
+ *   sl_handle_pool_name_size(pool)
+ *   sl_handle_pool_name_free(alloc, pool)
+ *
+ * Objects are pool.dense[0] to pool.dense[size - 1]. Destroying moves the last object into the hole,
+ * so pointers from get are only valid until the next create or destroy, keep the handle instead.
+ * A zeroed pool is empty and handle 0 is never valid.
+ */
+
+typedef uint32_t sl_handle;
+
+#define SL_HANDLE_INDEX_BITS 20
+#define SL_HANDLE_INDEX_MASK ((1u << SL_HANDLE_INDEX_BITS) - 1)
+#define SL_HANDLE_GENERATION_MASK ((1u << (32 - SL_HANDLE_INDEX_BITS)) - 1)
+#define SL_HANDLE_INVALID 0u
+
+#define sl_handle_make(index, generation) (((uint32_t)(generation) << SL_HANDLE_INDEX_BITS) | (uint32_t)(index))
+#define sl_handle_index(h) ((h) & SL_HANDLE_INDEX_MASK)
+#define sl_handle_generation(h) ((h) >> SL_HANDLE_INDEX_BITS)
+
+typedef struct sl_handle_slot
+{
+    //Dense index while alive, next free slot + 1 while free
+    uint32_t dense;
+    //Never 0, so no handle is 0
+    uint32_t generation;
+} sl_handle_slot;
+
+#define MAKE_HANDLE_POOL_TYPE(name, type) \
+typedef struct sl_handle_pool_##name \
+{ \
+SL_ARRAY(type, dense); \
+SL_ARRAY(uint32_t, dense_to_sparse); \
+SL_ARRAY(sl_handle_slot, sparse); \
+uint32_t free_head; \
+} sl_handle_pool_##name; \
+SL_FORCE_INLINE uint32_t sl_handle_pool_##name##_size(const sl_handle_pool_##name *pool) \
+{ \
+return (uint32_t)sl_array_size(pool->dense); \
+} \
+SL_FORCE_INLINE type *sl_handle_pool_##name##_get(const sl_handle_pool_##name *pool, sl_handle handle) \
+{ \
+const uint32_t index = sl_handle_index(handle); \
+if (index >= (uint32_t)sl_array_size(pool->sparse) || pool->sparse[index].generation != sl_handle_generation(handle)) \
+return NULL; \
+return pool->dense + pool->sparse[index].dense; \
+} \
+SL_FORCE_INLINE bool sl_handle_pool_##name##_valid(const sl_handle_pool_##name *pool, sl_handle handle) \
+{ \
+return sl_handle_pool_##name##_get(pool, handle) != NULL; \
+} \
+SL_FORCE_INLINE sl_handle sl_handle_pool_##name##_handle(const sl_handle_pool_##name *pool, uint32_t i) \
+{ \
+const uint32_t index = pool->dense_to_sparse[i]; \
+return sl_handle_make(index, pool->sparse[index].generation); \
+} \
+SL_INLINE sl_handle sl_handle_pool_##name##_create(sl_allocator *alloc, sl_handle_pool_##name *pool, type value) \
+{ \
+uint32_t index; \
+if (pool->free_head) { \
+index = pool->free_head - 1; \
+pool->free_head = pool->sparse[index].dense; \
+} else { \
+index = (uint32_t)sl_array_size(pool->sparse); \
+SL_ASSERT(index <= SL_HANDLE_INDEX_MASK, "Handle pool is full"); \
+sl_array_push(alloc, pool->sparse, ((sl_handle_slot){ .generation = 1 })); \
+} \
+pool->sparse[index].dense = (uint32_t)sl_array_size(pool->dense); \
+sl_array_push(alloc, pool->dense, value); \
+sl_array_push(alloc, pool->dense_to_sparse, index); \
+return sl_handle_make(index, pool->sparse[index].generation); \
+} \
+SL_INLINE bool sl_handle_pool_##name##_destroy(sl_handle_pool_##name *pool, sl_handle handle) \
+{ \
+if (!sl_handle_pool_##name##_valid(pool, handle)) \
+return false; \
+const uint32_t index = sl_handle_index(handle); \
+sl_handle_slot *slot = pool->sparse + index; \
+const uint32_t last = (uint32_t)sl_array_size(pool->dense) - 1; \
+if (slot->dense != last) { \
+const uint32_t moved = pool->dense_to_sparse[last]; \
+pool->dense[slot->dense] = pool->dense[last]; \
+pool->dense_to_sparse[slot->dense] = moved; \
+pool->sparse[moved].dense = slot->dense; \
+} \
+sl_array_get_header(pool->dense)->length -= 1; \
+sl_array_get_header(pool->dense_to_sparse)->length -= 1; \
+slot->generation = (slot->generation + 1) & SL_HANDLE_GENERATION_MASK; \
+if (!slot->generation) \
+slot->generation = 1; \
+slot->dense = pool->free_head; \
+pool->free_head = index + 1; \
+return true; \
+} \
+SL_INLINE void sl_handle_pool_##name##_free(sl_allocator *alloc, sl_handle_pool_##name *pool) \
+{ \
+sl_array_free(alloc, pool->dense); \
+sl_array_free(alloc, pool->dense_to_sparse); \
+sl_array_free(alloc, pool->sparse); \
+pool->free_head = 0; \
+}
+
+#endif //STARLIGHT_HANDLE_POOL_INL
@@ -454,38 +454,96 @@ SL_FORCE_INLINE sl_hash_index *sl_make_hash_index(sl_allocator* alloc, size_t sl
 #define SL_ROTATE_LEFT(val, n)   (((val) << (n)) | ((val) >> (SL_HM_SIZE_T_BITS - (n))))
 #define SL_ROTATE_RIGHT(val, n)  (((val) >> (n)) | ((val) << (SL_HM_SIZE_T_BITS - (n))))
 
-SL_FORCE_INLINE size_t sl_hash_string(char *str, size_t seed)
+/*
+ * wyhash (https://github.com/wangyi-fudan/wyhash, public domain), the default hash for keys that
+ * aren't 4 or 8 bytes. Reads 8 bytes at a time and keeps three independent multiply chains
+ * going on long keys, several times faster than the siphash variant above on anything longer
+ * than a few words. Compile with SL_SIPHASH_2_4 when keys may come from an attacker.
+ */
+SL_FORCE_INLINE void sl_wy_mum(uint64_t *a, uint64_t *b)
 {
-    size_t hash = seed;
-    while (*str)
-        hash = SL_ROTATE_LEFT(hash, 9) + (unsigned char) *str++;
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = *a;
+    r *= *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    const uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    const uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    const uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
 
-    // Thomas Wang 64-to-32 bit mix function, hopefully also works in 32 bits
-    hash ^= seed;
-    hash = (~hash) + (hash << 18);
-    hash ^= hash ^ SL_ROTATE_RIGHT(hash,31);
-    hash = hash * 21;
-    hash ^= hash ^ SL_ROTATE_RIGHT(hash,11);
-    hash += (hash << 6);
-    hash ^= SL_ROTATE_RIGHT(hash,22);
-    return hash+seed;
+SL_FORCE_INLINE uint64_t sl_wy_mix(uint64_t a, uint64_t b)
+{
+    sl_wy_mum(&a, &b);
+    return a ^ b;
+}
+
+SL_FORCE_INLINE uint64_t sl_wy_read8(const uint8_t *p) { uint64_t v; memcpy(&v, p, 8); return v; }
+SL_FORCE_INLINE uint64_t sl_wy_read4(const uint8_t *p) { uint32_t v; memcpy(&v, p, 4); return v; }
+SL_FORCE_INLINE uint64_t sl_wy_read3(const uint8_t *p, size_t k) { return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1]; }
+
+SL_FORCE_INLINE uint64_t sl_wyhash(const void *key, size_t len, uint64_t seed)
+{
+    static const uint64_t secret[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+    const uint8_t *p = (const uint8_t *)key;
+    uint64_t a, b;
+    seed ^= sl_wy_mix(seed ^ secret[0], secret[1]);
+
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (sl_wy_read4(p) << 32) | sl_wy_read4(p + ((len >> 3) << 2));
+            b = (sl_wy_read4(p + len - 4) << 32) | sl_wy_read4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = sl_wy_read3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i >= 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = sl_wy_mix(sl_wy_read8(p) ^ secret[1], sl_wy_read8(p + 8) ^ seed);
+                see1 = sl_wy_mix(sl_wy_read8(p + 16) ^ secret[2], sl_wy_read8(p + 24) ^ see1);
+                see2 = sl_wy_mix(sl_wy_read8(p + 32) ^ secret[3], sl_wy_read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i >= 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = sl_wy_mix(sl_wy_read8(p) ^ secret[1], sl_wy_read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = sl_wy_read8(p + i - 16);
+        b = sl_wy_read8(p + i - 8);
+    }
+
+    a ^= secret[1];
+    b ^= seed;
+    sl_wy_mum(&a, &b);
+    return sl_wy_mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+SL_FORCE_INLINE size_t sl_hash_string(char *str, size_t seed)
+{
+    return (size_t)sl_wyhash(str, strlen(str), seed);
 }
 
 SL_FORCE_INLINE size_t sl_hash_string_const(const char *str, size_t seed)
 {
-	size_t hash = seed;
-	while (*str)
-		hash = SL_ROTATE_LEFT(hash, 9) + (unsigned char) *str++;
-
-	// Thomas Wang 64-to-32 bit mix function, hopefully also works in 32 bits
-	hash ^= seed;
-	hash = (~hash) + (hash << 18);
-	hash ^= hash ^ SL_ROTATE_RIGHT(hash,31);
-	hash = hash * 21;
-	hash ^= hash ^ SL_ROTATE_RIGHT(hash,11);
-	hash += (hash << 6);
-	hash ^= SL_ROTATE_RIGHT(hash,22);
-	return hash+seed;
+    return (size_t)sl_wyhash(str, strlen(str), seed);
 }
 
 #ifdef SL_SIPHASH_2_4
@@ -649,7 +707,7 @@ SL_FORCE_INLINE size_t sl_hash_bytes(void *p, size_t len, size_t seed)
         hash = (~hash) + (hash << 18);
         return hash;
     } else {
-        return sl_siphash_bytes(p,len,seed);
+        return (size_t)sl_wyhash(p,len,seed);
     }
 #endif
 }
@@ -1119,7 +1177,7 @@ template<class T> static T * sl_shmode_func_wrapper(sl_allocator* alloc, T *, si
 #define sl_hashmap_push_default_wrapper       sl_hashmap_push_default
 #define sl_hashmap_push_key_wrapper           sl_hashmap_push_key
 #define sl_hashmap_del_key_wrapper           sl_hashmap_del_key
-#define sl_shmode_func_wrapper(t,e,m,func, file, line)  sl_shmode_func(e,m, func, file, line)
+#define sl_shmode_func_wrapper(alloc,t,e,m,func, file, line)  sl_shmode_func(alloc,e,m, func, file, line)
 #endif
 
 #define hmlen sl_hashmap_sizeu
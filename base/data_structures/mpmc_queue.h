@@ -52,7 +52,7 @@ typedef struct mpmc_queue_##name##_cell    \
 sl_atomic_uint64_t sequence;                   \
 type data; \
 }mpmc_queue_##name##_cell;               \
-static void mpmc_queue_##name##_init(mpmc_queue_##name##_c* queue, mpmc_queue_##name##_cell* cells, uint32_t cell_count) \
+SL_INLINE void mpmc_queue_##name##_init(mpmc_queue_##name##_c* queue, mpmc_queue_##name##_cell* cells, uint32_t cell_count) \
 {\
 queue->buffer = cells;\
 queue->buffer_mask = cell_count - 1;\
@@ -63,7 +63,7 @@ atomic_store_explicit(&queue->buffer[i].sequence, i, memory_order_relaxed);\
 atomic_store_explicit(&queue->enqueue_pos, 0, memory_order_relaxed);\
 atomic_store_explicit(&queue->dequeue_pos, 0, memory_order_relaxed);\
 }                                        \
-static void mpmc_queue_##name##_push(mpmc_queue_##name##_c* queue, type const *data)\
+SL_INLINE void mpmc_queue_##name##_push(mpmc_queue_##name##_c* queue, type const *data)\
 {\
 bool found_cell = false;\
 while (!found_cell) {\
@@ -91,7 +91,30 @@ return;\
 }\
 }\
 }                                        \
-static int mpmc_queue_##name##_pop(mpmc_queue_##name##_c* queue, type* data)\
+SL_INLINE int mpmc_queue_##name##_try_push(mpmc_queue_##name##_c* queue, type const *data)\
+{\
+mpmc_queue_##name##_cell *cell;\
+uint64_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);\
+for (;;) {\
+cell = &queue->buffer[pos & queue->buffer_mask];\
+const uint64_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);\
+const intptr_t dif = (intptr_t)seq - (intptr_t)pos;\
+if (dif == 0) {\
+if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos+1, memory_order_relaxed, memory_order_relaxed)) {\
+break;\
+}\
+} else if (dif < 0) {\
+return 0;\
+} else {\
+pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);\
+}\
+}\
+\
+cell->data = *data;\
+atomic_store_explicit(&cell->sequence, pos+1, memory_order_release);\
+return 1;\
+}                                        \
+SL_INLINE int mpmc_queue_##name##_pop(mpmc_queue_##name##_c* queue, type* data)\
 {\
 mpmc_queue_##name##_cell *cell;\
 uint64_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);\
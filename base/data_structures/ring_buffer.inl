@@ -0,0 +1,165 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_RING_BUFFER_INL
+#define STARLIGHT_RING_BUFFER_INL
+
+#include "defines.h"
+#include "memory/allocator.h"
+#include "thread/atomics.inl"
+#include "util/assertions.inl"
+
+/*
+ * Fixed size FIFOs over a power of two array. head and tail only ever count up and are masked on
+ * access, so full and empty are told apart without wasting a slot and nothing is ever memmoved.
+ *
+ * MAKE_RING_BUFFER_TYPE(name, type) declares sl_ring_buffer_name, for one thread:
+ *
+ *   sl_ring_buffer_name_init(alloc, ring, capacity)   capacity must be a power of two
+ *   sl_ring_buffer_name_push(ring, value)             false if full
+ *   sl_ring_buffer_name_pop(ring, value)              false if empty
+ *   sl_ring_buffer_name_peek(ring)                    pointer to the oldest element or NULL
+ *   sl_ring_buffer_name_at(ring, i)                   pointer to the i-th oldest element
+ *   sl_ring_buffer_name_size(ring)
+ *   sl_ring_buffer_name_clear(ring)
+ *   sl_ring_buffer_name_free(alloc, ring)
+ *
+ * MAKE_SPSC_QUEUE_TYPE(name, type) declares sl_spsc_queue_name, for exactly one producer thread and
+ * one consumer thread, with init/push/pop/size/free as above. Neither side takes a lock or does a
+ * read-modify-write. Each side keeps its own copy of the other side's index and only reloads it when
+ * the queue looks full or empty, so the two cache lines are rarely shared.
+ */
+
+#define SL_RING_CACHELINE_SIZE 64
+
+#define MAKE_RING_BUFFER_TYPE(name, type) \
+typedef struct sl_ring_buffer_##name \
+{ \
+type *items; \
+uint64_t mask; \
+uint64_t head; \
+uint64_t tail; \
+} sl_ring_buffer_##name; \
+SL_INLINE void sl_ring_buffer_##name##_init(sl_allocator *alloc, sl_ring_buffer_##name *ring, uint64_t capacity) \
+{ \
+SL_ASSERT(capacity && !(capacity & (capacity - 1)), "Ring buffer capacity must be a power of two"); \
+ring->items = (type *)sl_alloc(alloc, capacity * sizeof(type)); \
+ring->mask = capacity - 1; \
+ring->head = ring->tail = 0; \
+} \
+SL_FORCE_INLINE uint64_t sl_ring_buffer_##name##_size(const sl_ring_buffer_##name *ring) \
+{ \
+return ring->tail - ring->head; \
+} \
+SL_FORCE_INLINE bool sl_ring_buffer_##name##_push(sl_ring_buffer_##name *ring, type const *value) \
+{ \
+if (ring->tail - ring->head > ring->mask) \
+return false; \
+ring->items[ring->tail++ & ring->mask] = *value; \
+return true; \
+} \
+SL_FORCE_INLINE bool sl_ring_buffer_##name##_pop(sl_ring_buffer_##name *ring, type *value) \
+{ \
+if (ring->head == ring->tail) \
+return false; \
+*value = ring->items[ring->head++ & ring->mask]; \
+return true; \
+} \
+SL_FORCE_INLINE type *sl_ring_buffer_##name##_peek(const sl_ring_buffer_##name *ring) \
+{ \
+return ring->head == ring->tail ? NULL : ring->items + (ring->head & ring->mask); \
+} \
+SL_FORCE_INLINE type *sl_ring_buffer_##name##_at(const sl_ring_buffer_##name *ring, uint64_t i) \
+{ \
+return ring->items + ((ring->head + i) & ring->mask); \
+} \
+SL_INLINE void sl_ring_buffer_##name##_clear(sl_ring_buffer_##name *ring) \
+{ \
+ring->head = ring->tail = 0; \
+} \
+SL_INLINE void sl_ring_buffer_##name##_free(sl_allocator *alloc, sl_ring_buffer_##name *ring) \
+{ \
+if (ring->items) \
+sl_free(alloc, ring->items); \
+*ring = (sl_ring_buffer_##name){ 0 }; \
+}
+
+#define MAKE_SPSC_QUEUE_TYPE(name, type) \
+typedef struct sl_spsc_queue_##name \
+{ \
+type *items; \
+uint64_t mask; \
+char pad0[SL_RING_CACHELINE_SIZE]; \
+sl_atomic_uint64_t tail; \
+uint64_t cached_head; \
+char pad1[SL_RING_CACHELINE_SIZE]; \
+sl_atomic_uint64_t head; \
+uint64_t cached_tail; \
+char pad2[SL_RING_CACHELINE_SIZE]; \
+} sl_spsc_queue_##name; \
+SL_INLINE void sl_spsc_queue_##name##_init(sl_allocator *alloc, sl_spsc_queue_##name *queue, uint64_t capacity) \
+{ \
+SL_ASSERT(capacity && !(capacity & (capacity - 1)), "Queue capacity must be a power of two"); \
+queue->items = (type *)sl_alloc(alloc, capacity * sizeof(type)); \
+queue->mask = capacity - 1; \
+queue->cached_head = queue->cached_tail = 0; \
+atomic_store_explicit(&queue->tail, 0, memory_order_relaxed); \
+atomic_store_explicit(&queue->head, 0, memory_order_relaxed); \
+} \
+SL_FORCE_INLINE bool sl_spsc_queue_##name##_push(sl_spsc_queue_##name *queue, type const *value) \
+{ \
+const uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed); \
+if (tail - queue->cached_head > queue->mask) { \
+queue->cached_head = atomic_load_explicit(&queue->head, memory_order_acquire); \
+if (tail - queue->cached_head > queue->mask) \
+return false; \
+} \
+queue->items[tail & queue->mask] = *value; \
+atomic_store_explicit(&queue->tail, tail + 1, memory_order_release); \
+return true; \
+} \
+SL_FORCE_INLINE bool sl_spsc_queue_##name##_pop(sl_spsc_queue_##name *queue, type *value) \
+{ \
+const uint64_t head = atomic_load_explicit(&queue->head, memory_order_relaxed); \
+if (head == queue->cached_tail) { \
+queue->cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire); \
+if (head == queue->cached_tail) \
+return false; \
+} \
+*value = queue->items[head & queue->mask]; \
+atomic_store_explicit(&queue->head, head + 1, memory_order_release); \
+return true; \
+} \
+SL_INLINE uint64_t sl_spsc_queue_##name##_size(sl_spsc_queue_##name *queue) \
+{ \
+const uint64_t head = atomic_load_explicit(&queue->head, memory_order_acquire); \
+return atomic_load_explicit(&queue->tail, memory_order_acquire) - head; \
+} \
+SL_INLINE void sl_spsc_queue_##name##_free(sl_allocator *alloc, sl_spsc_queue_##name *queue) \
+{ \
+if (queue->items) \
+sl_free(alloc, queue->items); \
+queue->items = NULL; \
+}
+
+#endif //STARLIGHT_RING_BUFFER_INL
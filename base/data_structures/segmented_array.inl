@@ -0,0 +1,111 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_SEGMENTED_ARRAY_INL
+#define STARLIGHT_SEGMENTED_ARRAY_INL
+
+#include "defines.h"
+#include "memory/allocator.h"
+#include "data_structures/array.inl"
+
+/*
+ * Array made of fixed size blocks found through an index table. Elements never move once they are
+ * added, so pointers to them stay valid while the array grows, growing never copies elements and
+ * there is no latency spike when a big array runs out of room. Indexing is a shift and a mask.
+ * Freeing releases every block in one pass.
+ *
+ * MAKE_SEGMENTED_ARRAY_TYPE(name, type, block_shift) declares sl_segmented_array_name, with blocks
+ * of 1 << block_shift elements:
+ *
+ *   sl_segmented_array_name_push(alloc, a, value)        appends, returns a pointer to the new element
+ *   sl_segmented_array_name_addn(alloc, a, n)            appends n uninitialized elements, returns the first index
+ *   sl_segmented_array_name_at(a, i)                     pointer to element i
+ *   sl_segmented_array_name_pop(a)                       removes the last element and returns it
+ *   sl_segmented_array_name_reserve(alloc, a, count)     allocates blocks for count elements up front
+ *   sl_segmented_array_name_copy(a, dst, first, count)   copies count elements starting at first into dst
+ *   sl_segmented_array_name_clear(a)                     keeps the blocks for reuse
+ *   sl_segmented_array_name_free(alloc, a)
+ *
+ * a.size is the number of elements and a zeroed array is empty. The index table is an sl_array that
+ * moves when it grows, so indexing while another thread adds elements needs a lock. Pointers to
+ * elements can be handed to other threads freely.
+ */
+
+#define MAKE_SEGMENTED_ARRAY_TYPE(name, type, block_shift) \
+typedef struct sl_segmented_array_##name \
+{ \
+SL_ARRAY(type *, blocks); \
+uint64_t size; \
+} sl_segmented_array_##name; \
+SL_FORCE_INLINE type *sl_segmented_array_##name##_at(const sl_segmented_array_##name *a, uint64_t i) \
+{ \
+return a->blocks[i >> (block_shift)] + (i & ((1ull << (block_shift)) - 1)); \
+} \
+SL_INLINE void sl_segmented_array_##name##_reserve(sl_allocator *alloc, sl_segmented_array_##name *a, uint64_t count) \
+{ \
+while ((uint64_t)sl_array_size(a->blocks) << (block_shift) < count) \
+sl_array_push(alloc, a->blocks, (type *)sl_alloc(alloc, sizeof(type) << (block_shift))); \
+} \
+SL_INLINE type *sl_segmented_array_##name##_push(sl_allocator *alloc, sl_segmented_array_##name *a, type value) \
+{ \
+sl_segmented_array_##name##_reserve(alloc, a, a->size + 1); \
+type *e = sl_segmented_array_##name##_at(a, a->size++); \
+*e = value; \
+return e; \
+} \
+SL_INLINE uint64_t sl_segmented_array_##name##_addn(sl_allocator *alloc, sl_segmented_array_##name *a, uint64_t n) \
+{ \
+sl_segmented_array_##name##_reserve(alloc, a, a->size + n); \
+a->size += n; \
+return a->size - n; \
+} \
+SL_INLINE type sl_segmented_array_##name##_pop(sl_segmented_array_##name *a) \
+{ \
+return *sl_segmented_array_##name##_at(a, --a->size); \
+} \
+SL_INLINE void sl_segmented_array_##name##_copy(const sl_segmented_array_##name *a, type *dst, uint64_t first, uint64_t count) \
+{ \
+while (count) { \
+const uint64_t offset = first & ((1ull << (block_shift)) - 1); \
+uint64_t n = (1ull << (block_shift)) - offset; \
+if (n > count) \
+n = count; \
+sl_memcpy(dst, a->blocks[first >> (block_shift)] + offset, n * sizeof(type)); \
+dst += n; \
+first += n; \
+count -= n; \
+} \
+} \
+SL_INLINE void sl_segmented_array_##name##_clear(sl_segmented_array_##name *a) \
+{ \
+a->size = 0; \
+} \
+SL_INLINE void sl_segmented_array_##name##_free(sl_allocator *alloc, sl_segmented_array_##name *a) \
+{ \
+for (uint64_t i = 0; i < (uint64_t)sl_array_size(a->blocks); ++i) \
+sl_free(alloc, a->blocks[i]); \
+sl_array_free(alloc, a->blocks); \
+a->size = 0; \
+}
+
+#endif //STARLIGHT_SEGMENTED_ARRAY_INL
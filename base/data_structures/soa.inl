@@ -0,0 +1,152 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_SOA_INL
+#define STARLIGHT_SOA_INL
+
+#include "defines.h"
+#include "memory/allocator.h"
+
+/*
+ * Structure of arrays container generated from a field list. Every field gets its own column so a
+ * loop over one field only touches that field's cache lines and can be vectorized. All columns
+ * live in one allocation, each starting on a SL_SOA_ALIGN boundary, and grow together. Allocators
+ * don't have to honour the alignment (the system allocator puts a header in front of the block),
+ * so the allocation is padded and the columns are placed from the first aligned byte in it.
+ *
+ * The field list is a macro that applies its argument to every (type, name) pair:
+ *
+ *   #define PARTICLE_FIELDS(X) \
+ *       X(float, x) \
+ *       X(float, y) \
+ *       X(uint32_t, color)
+ *
+ *   MAKE_SOA_TYPE(particles, PARTICLE_FIELDS)
+ *
+ * declares sl_soa_particles, with one pointer per field (soa.x[i], soa.color[i]) plus size and
+ * capacity, and sl_soa_particles_item, a plain struct of the same fields:
+ *
+ *   sl_soa_name_reserve(alloc, soa, count)     room for count elements, moves every column at once
+ *   sl_soa_name_push(alloc, soa, item)         appends an item, returns its index
+ *   sl_soa_name_addn(alloc, soa, n)            appends n uninitialized elements, returns the first index
+ *   sl_soa_name_get(soa, i)                    gathers element i into an item
+ *   sl_soa_name_set(soa, i, item)              scatters an item into element i
+ *   sl_soa_name_swap_remove(soa, i)            moves the last element into i, order isn't kept
+ *   sl_soa_name_clear(soa)
+ *   sl_soa_name_free(alloc, soa)
+ *
+ * A zeroed container is empty. Column pointers change when the container grows.
+ */
+
+#define SL_SOA_ALIGN 64
+#define SL_SOA_MIN_CAPACITY 16
+
+#define SL_SOA_ALIGN_UP(x) (((x) + (SL_SOA_ALIGN - 1)) & ~(uint64_t)(SL_SOA_ALIGN - 1))
+
+#define SL__SOA_COLUMN(type, field) type *field;
+#define SL__SOA_ITEM(type, field) type field;
+#define SL__SOA_BYTES(type, field) bytes = SL_SOA_ALIGN_UP(bytes) + capacity * sizeof(type);
+#define SL__SOA_PLACE(type, field) \
+offset = SL_SOA_ALIGN_UP(offset); \
+soa->field = (type *)(base + offset); \
+if (old.size) \
+sl_memcpy(soa->field, old.field, old.size * sizeof(type)); \
+offset += capacity * sizeof(type);
+#define SL__SOA_STORE(type, field) soa->field[i] = item.field;
+#define SL__SOA_LOAD(type, field) item.field = soa->field[i];
+#define SL__SOA_MOVE(type, field) soa->field[i] = soa->field[last];
+
+#define MAKE_SOA_TYPE(name, fields) \
+typedef struct sl_soa_##name##_item \
+{ \
+fields(SL__SOA_ITEM) \
+} sl_soa_##name##_item; \
+typedef struct sl_soa_##name \
+{ \
+fields(SL__SOA_COLUMN) \
+uint64_t size; \
+uint64_t capacity; \
+/* Start of the allocation, the columns start at the first SL_SOA_ALIGN boundary in it */ \
+void *memory; \
+} sl_soa_##name; \
+SL_INLINE void sl_soa_##name##_reserve(sl_allocator *alloc, sl_soa_##name *soa, uint64_t count) \
+{ \
+if (count <= soa->capacity) \
+return; \
+uint64_t capacity = soa->capacity ? soa->capacity * 2 : SL_SOA_MIN_CAPACITY; \
+while (capacity < count) \
+capacity *= 2; \
+uint64_t bytes = 0; \
+fields(SL__SOA_BYTES) \
+uint8_t *memory = (uint8_t *)alloc->realloc(alloc, 0, bytes + SL_SOA_ALIGN, SL_SOA_ALIGN, SL_FUNCTION, __FILE__, __LINE__); \
+uint8_t *base = (uint8_t *)SL_SOA_ALIGN_UP((uintptr_t)memory); \
+const sl_soa_##name old = *soa; \
+uint64_t offset = 0; \
+fields(SL__SOA_PLACE) \
+if (old.memory) \
+sl_free(alloc, old.memory); \
+soa->memory = memory; \
+soa->capacity = capacity; \
+} \
+SL_INLINE uint64_t sl_soa_##name##_push(sl_allocator *alloc, sl_soa_##name *soa, sl_soa_##name##_item item) \
+{ \
+sl_soa_##name##_reserve(alloc, soa, soa->size + 1); \
+const uint64_t i = soa->size++; \
+fields(SL__SOA_STORE) \
+return i; \
+} \
+SL_INLINE uint64_t sl_soa_##name##_addn(sl_allocator *alloc, sl_soa_##name *soa, uint64_t n) \
+{ \
+sl_soa_##name##_reserve(alloc, soa, soa->size + n); \
+soa->size += n; \
+return soa->size - n; \
+} \
+SL_INLINE sl_soa_##name##_item sl_soa_##name##_get(const sl_soa_##name *soa, uint64_t i) \
+{ \
+sl_soa_##name##_item item; \
+fields(SL__SOA_LOAD) \
+return item; \
+} \
+SL_INLINE void sl_soa_##name##_set(sl_soa_##name *soa, uint64_t i, sl_soa_##name##_item item) \
+{ \
+fields(SL__SOA_STORE) \
+} \
+SL_INLINE void sl_soa_##name##_swap_remove(sl_soa_##name *soa, uint64_t i) \
+{ \
+const uint64_t last = --soa->size; \
+if (i != last) { \
+fields(SL__SOA_MOVE) \
+} \
+} \
+SL_INLINE void sl_soa_##name##_clear(sl_soa_##name *soa) \
+{ \
+soa->size = 0; \
+} \
+SL_INLINE void sl_soa_##name##_free(sl_allocator *alloc, sl_soa_##name *soa) \
+{ \
+if (soa->memory) \
+sl_free(alloc, soa->memory); \
+*soa = (sl_soa_##name){ 0 }; \
+}
+
+#endif //STARLIGHT_SOA_INL
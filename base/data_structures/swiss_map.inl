@@ -0,0 +1,282 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_SWISS_MAP_INL
+#define STARLIGHT_SWISS_MAP_INL
+
+#include "defines.h"
+#include "memory/allocator.h"
+
+/*
+ * Typed open addressing map in the SwissTable layout (https://abseil.io/about/design/swisstables).
+ * Every slot has a control byte holding either SL_SWISS_EMPTY or the low 7 bits of its key's hash,
+ * so a probe checks 16 slots at once with SSE2/NEON and only compares keys whose 7 bits match.
+ *
+ * Keys are probed linearly from their home slot and removing one shifts the keys after it back,
+ * so there are no tombstones: lookups never walk over deleted slots and the table never needs a
+ * cleanup rehash. The first 16 control bytes are mirrored past the end so a group that wraps
+ * around is still a single unaligned load.
+ *
+ * MAKE_SWISS_MAP_TYPE(name, key_type, value_type, hash_func, equal_func) declares sl_swiss_map_name:
+ *
+ *   sl_swiss_map_name_reserve(alloc, map, count)            room for count keys without growing again
+ *   sl_swiss_map_name_insert(alloc, map, key, value)        inserts or overwrites, returns the value
+ *   sl_swiss_map_name_insert_bulk(alloc, map, keys, values, count)
+ *   sl_swiss_map_name_get(map, key)                         pointer to the value or NULL
+ *   sl_swiss_map_name_remove(map, key, value)               true if the key was there, value can be NULL
+ *   sl_swiss_map_name_clear(map)
+ *   sl_swiss_map_name_free(alloc, map)
+ *   sl_swiss_map_name_next(map, index)                      first full slot at or after index, capacity at the end
+ *
+ * hash_func(key) returns a uint64_t and equal_func(a, b) is true for equal keys. A zeroed map is empty.
+ *
+ *   for (uint64_t i = sl_swiss_map_name_next(&map, 0); i < map.capacity; i = sl_swiss_map_name_next(&map, i + 1))
+ *       use(map.slots[i].key, map.slots[i].value);
+ */
+
+#if SL_CPU_X86 && (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64))
+#include <emmintrin.h>
+#define SL_SWISS_SSE2 1
+#elif SL_CPU_ARM && defined(__aarch64__)
+#include <arm_neon.h>
+#define SL_SWISS_NEON 1
+#endif
+
+#define SL_SWISS_GROUP_SIZE 16
+#define SL_SWISS_EMPTY ((uint8_t)0x80)
+#define SL_SWISS_MIN_CAPACITY 16
+#define SL_SWISS_NOT_FOUND UINT64_MAX
+
+//Maximum load is 7/8
+#define SL_SWISS_MAX_SIZE(capacity) ((capacity) - (capacity) / 8)
+
+#define sl_swiss_equal(a, b) ((a) == (b))
+
+SL_FORCE_INLINE uint64_t sl_swiss_hash_uint64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+#define sl_swiss_hash_ptr(p) sl_swiss_hash_uint64((uint64_t)(uintptr_t)(p))
+
+SL_FORCE_INLINE uint32_t sl_swiss_ctz(uint32_t mask)
+{
+#if SL_COMPILER_MSVC
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(mask);
+#endif
+}
+
+#if SL_SWISS_NEON
+//NEON has no movemask, so give every lane its own bit and add them up per half
+SL_FORCE_INLINE uint32_t sl_swiss_neon_mask(uint8x16_t lanes)
+{
+    static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t m = vandq_u8(lanes, vld1q_u8(bits));
+    return (uint32_t)vaddv_u8(vget_low_u8(m)) | ((uint32_t)vaddv_u8(vget_high_u8(m)) << 8);
+}
+#endif
+
+//Bit i is set if control byte i of the group is h2
+SL_FORCE_INLINE uint32_t sl_swiss_match(const uint8_t *ctrl, uint8_t h2)
+{
+#if SL_SWISS_SSE2
+    const __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+#elif SL_SWISS_NEON
+    return sl_swiss_neon_mask(vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(h2)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < SL_SWISS_GROUP_SIZE; ++i)
+        mask |= (uint32_t)(ctrl[i] == h2) << i;
+    return mask;
+#endif
+}
+
+//Bit i is set if slot i of the group is empty, the only control byte with the high bit set
+SL_FORCE_INLINE uint32_t sl_swiss_match_empty(const uint8_t *ctrl)
+{
+#if SL_SWISS_SSE2
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#elif SL_SWISS_NEON
+    return sl_swiss_neon_mask(vtstq_u8(vld1q_u8(ctrl), vdupq_n_u8(SL_SWISS_EMPTY)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < SL_SWISS_GROUP_SIZE; ++i)
+        mask |= (uint32_t)(ctrl[i] >> 7) << i;
+    return mask;
+#endif
+}
+
+SL_FORCE_INLINE uint64_t sl_swiss_capacity_for(uint64_t count)
+{
+    uint64_t capacity = SL_SWISS_MIN_CAPACITY;
+    while (SL_SWISS_MAX_SIZE(capacity) < count)
+        capacity *= 2;
+    return capacity;
+}
+
+#define MAKE_SWISS_MAP_TYPE(name, key_type, value_type, hash_func, equal_func) \
+typedef struct sl_swiss_map_##name##_slot \
+{ \
+key_type key; \
+value_type value; \
+} sl_swiss_map_##name##_slot; \
+typedef struct sl_swiss_map_##name \
+{ \
+uint8_t *ctrl; \
+sl_swiss_map_##name##_slot *slots; \
+uint64_t capacity; \
+uint64_t size; \
+} sl_swiss_map_##name; \
+SL_INLINE void sl_swiss_map_##name##_set_ctrl(sl_swiss_map_##name *map, uint64_t i, uint8_t c) \
+{ \
+map->ctrl[i] = c; \
+if (i < SL_SWISS_GROUP_SIZE) \
+map->ctrl[map->capacity + i] = c; \
+} \
+SL_INLINE uint64_t sl_swiss_map_##name##_find(const sl_swiss_map_##name *map, key_type key, uint64_t hash) \
+{ \
+if (!map->size) \
+return SL_SWISS_NOT_FOUND; \
+const uint64_t mask = map->capacity - 1; \
+const uint8_t h2 = (uint8_t)(hash & 0x7f); \
+for (uint64_t pos = (hash >> 7) & mask;; pos = (pos + SL_SWISS_GROUP_SIZE) & mask) { \
+const uint8_t *group = map->ctrl + pos; \
+for (uint32_t m = sl_swiss_match(group, h2); m; m &= m - 1) { \
+const uint64_t i = (pos + sl_swiss_ctz(m)) & mask; \
+if (equal_func(map->slots[i].key, key)) \
+return i; \
+} \
+if (sl_swiss_match_empty(group)) \
+return SL_SWISS_NOT_FOUND; \
+} \
+} \
+SL_INLINE uint64_t sl_swiss_map_##name##_find_empty(const sl_swiss_map_##name *map, uint64_t hash) \
+{ \
+const uint64_t mask = map->capacity - 1; \
+for (uint64_t pos = (hash >> 7) & mask;; pos = (pos + SL_SWISS_GROUP_SIZE) & mask) { \
+const uint32_t m = sl_swiss_match_empty(map->ctrl + pos); \
+if (m) \
+return (pos + sl_swiss_ctz(m)) & mask; \
+} \
+} \
+SL_INLINE void sl_swiss_map_##name##_rehash(sl_allocator *alloc, sl_swiss_map_##name *map, uint64_t capacity) \
+{ \
+const sl_swiss_map_##name old = *map; \
+const uint64_t ctrl_bytes = capacity + SL_SWISS_GROUP_SIZE; \
+uint8_t *memory = (uint8_t *)sl_alloc(alloc, ctrl_bytes + capacity * sizeof(sl_swiss_map_##name##_slot)); \
+sl_memset(memory, SL_SWISS_EMPTY, ctrl_bytes); \
+map->ctrl = memory; \
+map->slots = (sl_swiss_map_##name##_slot *)(memory + ctrl_bytes); \
+map->capacity = capacity; \
+for (uint64_t i = 0; i < old.capacity; ++i) { \
+if (old.ctrl[i] & SL_SWISS_EMPTY) \
+continue; \
+const uint64_t hash = hash_func(old.slots[i].key); \
+const uint64_t slot = sl_swiss_map_##name##_find_empty(map, hash); \
+sl_swiss_map_##name##_set_ctrl(map, slot, (uint8_t)(hash & 0x7f)); \
+map->slots[slot] = old.slots[i]; \
+} \
+if (old.ctrl) \
+sl_free(alloc, old.ctrl); \
+} \
+SL_INLINE void sl_swiss_map_##name##_reserve(sl_allocator *alloc, sl_swiss_map_##name *map, uint64_t count) \
+{ \
+if (count > SL_SWISS_MAX_SIZE(map->capacity)) \
+sl_swiss_map_##name##_rehash(alloc, map, sl_swiss_capacity_for(count)); \
+} \
+SL_INLINE value_type *sl_swiss_map_##name##_insert(sl_allocator *alloc, sl_swiss_map_##name *map, key_type key, value_type value) \
+{ \
+const uint64_t hash = hash_func(key); \
+uint64_t i = sl_swiss_map_##name##_find(map, key, hash); \
+if (i == SL_SWISS_NOT_FOUND) { \
+if (map->size + 1 > SL_SWISS_MAX_SIZE(map->capacity)) \
+sl_swiss_map_##name##_rehash(alloc, map, map->capacity ? map->capacity * 2 : SL_SWISS_MIN_CAPACITY); \
+i = sl_swiss_map_##name##_find_empty(map, hash); \
+sl_swiss_map_##name##_set_ctrl(map, i, (uint8_t)(hash & 0x7f)); \
+map->slots[i].key = key; \
+map->size += 1; \
+} \
+map->slots[i].value = value; \
+return &map->slots[i].value; \
+} \
+SL_INLINE void sl_swiss_map_##name##_insert_bulk(sl_allocator *alloc, sl_swiss_map_##name *map, key_type const *keys, value_type const *values, uint64_t count) \
+{ \
+sl_swiss_map_##name##_reserve(alloc, map, map->size + count); \
+for (uint64_t i = 0; i < count; ++i) \
+sl_swiss_map_##name##_insert(alloc, map, keys[i], values[i]); \
+} \
+SL_INLINE value_type *sl_swiss_map_##name##_get(const sl_swiss_map_##name *map, key_type key) \
+{ \
+const uint64_t i = sl_swiss_map_##name##_find(map, key, hash_func(key)); \
+return i == SL_SWISS_NOT_FOUND ? NULL : &map->slots[i].value; \
+} \
+SL_INLINE bool sl_swiss_map_##name##_remove(sl_swiss_map_##name *map, key_type key, value_type *value) \
+{ \
+uint64_t i = sl_swiss_map_##name##_find(map, key, hash_func(key)); \
+if (i == SL_SWISS_NOT_FOUND) \
+return false; \
+if (value) \
+*value = map->slots[i].value; \
+const uint64_t mask = map->capacity - 1; \
+for (uint64_t j = (i + 1) & mask; map->ctrl[j] != SL_SWISS_EMPTY; j = (j + 1) & mask) { \
+const uint64_t home = (hash_func(map->slots[j].key) >> 7) & mask; \
+if (((j - home) & mask) >= ((j - i) & mask)) { \
+map->slots[i] = map->slots[j]; \
+sl_swiss_map_##name##_set_ctrl(map, i, map->ctrl[j]); \
+i = j; \
+} \
+} \
+sl_swiss_map_##name##_set_ctrl(map, i, SL_SWISS_EMPTY); \
+map->size -= 1; \
+return true; \
+} \
+SL_INLINE void sl_swiss_map_##name##_clear(sl_swiss_map_##name *map) \
+{ \
+if (map->ctrl) \
+sl_memset(map->ctrl, SL_SWISS_EMPTY, map->capacity + SL_SWISS_GROUP_SIZE); \
+map->size = 0; \
+} \
+SL_INLINE void sl_swiss_map_##name##_free(sl_allocator *alloc, sl_swiss_map_##name *map) \
+{ \
+if (map->ctrl) \
+sl_free(alloc, map->ctrl); \
+*map = (sl_swiss_map_##name){ 0 }; \
+} \
+SL_INLINE uint64_t sl_swiss_map_##name##_next(const sl_swiss_map_##name *map, uint64_t index) \
+{ \
+while (index < map->capacity && (map->ctrl[index] & SL_SWISS_EMPTY)) \
+++index; \
+return index; \
+}
+
+#endif //STARLIGHT_SWISS_MAP_INL
@@ -0,0 +1,565 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "file_sink.h"
+
+#include "util/sprintf.h"
+#include "thread/atomics.inl"
+#include "thread/mutex.inl"
+#include "thread/job_system.h"
+#include "os/os.h"
+#include "memory/allocator.h"
+#include "memory/mem_tracker.h"
+#include <string.h>
+
+//Used for the zeroed fields of sl_log_file_sink_desc
+#define DEFAULT_BUFFER_SIZE SL_KILOBYTES(256)
+#define DEFAULT_FLUSH_INTERVAL 1.0
+#define DEFAULT_MAX_FILES 4
+
+//Longest the flush thread sleeps between two looks at the buffer
+#define FLUSH_THREAD_SLEEP 0.05
+
+//Longest suffix added to the path of a rotated file, ".4294967295.gz.tmp"
+#define ROTATED_SUFFIX 20
+
+//Deflate settings of the gzip writer
+#define GZIP_WINDOW 32768
+#define GZIP_HASH_SIZE (1u << 15)
+#define GZIP_MAX_CHAIN 32
+#define GZIP_MIN_MATCH 3
+#define GZIP_MAX_MATCH 258
+#define GZIP_OUT_SIZE SL_KILOBYTES(64)
+
+extern struct sl_sprintf_api* sl_sprintf_api; //sprintf.c
+extern struct sl_os_api* sl_os_api; //os_macos.c
+extern struct sl_allocator_api* sl_allocator_api; //allocator.c
+extern struct sl_logger_api* sl_logger_api; //logger.c
+
+typedef struct file_sink {
+	sl_logger logger;
+
+	sl_allocator allocator;
+
+	//Taken by log and the flush thread, held while writing
+	sl_os_mutex lock;
+
+	sl_os_file file;
+
+	char *path;
+
+	uint8_t *buffer;
+	uint32_t buffer_size;
+	uint32_t used;
+
+	//Bytes of the current file, buffered ones included
+	uint64_t file_size;
+
+	//When the oldest buffered message came in
+	uint64_t buffered_since;
+
+	uint64_t flush_interval;
+	uint32_t flush_levels;
+	bool sync_to_device;
+	uint64_t max_file_size;
+	uint32_t max_files;
+	bool compress;
+	struct sl_job_system_api *job_system;
+
+	sl_atomic_bool running;
+	sl_os_thread flusher;
+
+	//Thread of the last compression without a job system, joined before the next one starts
+	sl_os_thread compressor;
+	bool compressor_started;
+
+	//Compressions started that haven't finished
+	sl_atomic_uint32_t compressing;
+} file_sink;
+
+typedef struct compress_job {
+	sl_allocator allocator;
+
+	sl_atomic_uint32_t *compressing;
+
+	//Rotated file, file being written and the finished .gz
+	char *src;
+	char *tmp;
+	char *dst;
+} compress_job;
+
+#pragma region Gzip
+
+typedef struct gzip_writer {
+	sl_os_file file;
+	uint8_t *out;
+	uint32_t used;
+	uint64_t bits;
+	uint32_t num_bits;
+	bool ok;
+} gzip_writer;
+
+static const uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static void gzip_write_out(gzip_writer *w)
+{
+	if (w->ok && w->used)
+		w->ok = sl_os_api->file_system->file_write(w->file, w->out, w->used);
+	w->used = 0;
+}
+
+static void gzip_byte(gzip_writer *w, uint8_t byte)
+{
+	w->out[w->used++] = byte;
+	if (w->used == GZIP_OUT_SIZE)
+		gzip_write_out(w);
+}
+
+static void gzip_u32(gzip_writer *w, uint32_t value)
+{
+	for (uint32_t i = 0; i < 4; ++i)
+		gzip_byte(w, (uint8_t)(value >> (i * 8)));
+}
+
+//Deflate packs values starting at the lowest bit
+static void gzip_bits(gzip_writer *w, uint32_t value, uint32_t count)
+{
+	w->bits |= (uint64_t)value << w->num_bits;
+	w->num_bits += count;
+	while (w->num_bits >= 8) {
+		gzip_byte(w, (uint8_t)w->bits);
+		w->bits >>= 8;
+		w->num_bits -= 8;
+	}
+}
+
+//Huffman codes go out starting at their highest bit
+static void gzip_code(gzip_writer *w, uint32_t code, uint32_t length)
+{
+	uint32_t reversed = 0;
+	for (uint32_t i = 0; i < length; ++i)
+		reversed |= ((code >> i) & 1) << (length - 1 - i);
+	gzip_bits(w, reversed, length);
+}
+
+//Fixed literal/length code of RFC 1951 3.2.6
+static void gzip_symbol(gzip_writer *w, uint32_t symbol)
+{
+	if (symbol <= 143)
+		gzip_code(w, 0x30 + symbol, 8);
+	else if (symbol <= 255)
+		gzip_code(w, 0x190 + symbol - 144, 9);
+	else if (symbol <= 279)
+		gzip_code(w, symbol - 256, 7);
+	else
+		gzip_code(w, 0xc0 + symbol - 280, 8);
+}
+
+static void gzip_match(gzip_writer *w, uint32_t length, uint32_t distance)
+{
+	uint32_t l = 0;
+	while (l < 28 && length_base[l + 1] <= length)
+		l++;
+	gzip_symbol(w, 257 + l);
+	gzip_bits(w, length - length_base[l], length_extra[l]);
+
+	uint32_t d = 0;
+	while (d < 29 && distance_base[d + 1] <= distance)
+		d++;
+	gzip_code(w, d, 5);
+	gzip_bits(w, distance - distance_base[d], distance_extra[d]);
+}
+
+static uint32_t gzip_hash(const uint8_t *p)
+{
+	return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> 17;
+}
+
+//A single fixed Huffman block with greedy LZ77 matching. Log text repeats a lot, so this gets most of
+//what dynamic blocks would without building any trees
+static void gzip_deflate(gzip_writer *w, const uint8_t *data, uint32_t size, uint32_t *head, uint32_t *prev)
+{
+	//Positions are stored plus one, 0 ends a chain
+	sl_memset(head, 0, GZIP_HASH_SIZE * sizeof(uint32_t));
+
+	gzip_bits(w, 1, 1);
+	gzip_bits(w, 1, 2);
+
+	uint32_t pos = 0;
+	while (pos + GZIP_MIN_MATCH <= size) {
+		const uint32_t max_length = size - pos < GZIP_MAX_MATCH ? size - pos : GZIP_MAX_MATCH;
+		const uint32_t hash = gzip_hash(data + pos);
+		uint32_t best_length = 0;
+		uint32_t best_distance = 0;
+
+		uint32_t candidate = head[hash];
+		for (uint32_t chain = 0; candidate && chain < GZIP_MAX_CHAIN; ++chain) {
+			const uint32_t c = candidate - 1;
+			if (pos - c > GZIP_WINDOW)
+				break;
+
+			uint32_t length = 0;
+			while (length < max_length && data[c + length] == data[pos + length])
+				length++;
+			if (length > best_length) {
+				best_length = length;
+				best_distance = pos - c;
+				if (length == max_length)
+					break;
+			}
+
+			//The slot may have been reused by a newer position, which would walk back up the chain
+			const uint32_t next = prev[c & (GZIP_WINDOW - 1)];
+			if (next >= candidate)
+				break;
+			candidate = next;
+		}
+
+		const uint32_t advance = best_length >= GZIP_MIN_MATCH ? best_length : 1;
+		if (advance > 1)
+			gzip_match(w, best_length, best_distance);
+		else
+			gzip_symbol(w, data[pos]);
+
+		for (uint32_t end = pos + advance; pos < end; ++pos) {
+			if (pos + GZIP_MIN_MATCH <= size) {
+				const uint32_t h = gzip_hash(data + pos);
+				prev[pos & (GZIP_WINDOW - 1)] = head[h];
+				head[h] = pos + 1;
+			}
+		}
+	}
+
+	for (; pos < size; ++pos)
+		gzip_symbol(w, data[pos]);
+
+	gzip_symbol(w, 256);
+	if (w->num_bits)
+		gzip_bits(w, 0, 8 - w->num_bits);
+}
+
+static uint32_t gzip_crc32(const uint8_t *data, uint64_t size)
+{
+	uint32_t table[256];
+	for (uint32_t i = 0; i < 256; ++i) {
+		uint32_t c = i;
+		for (uint32_t k = 0; k < 8; ++k)
+			c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+		table[i] = c;
+	}
+
+	uint32_t crc = 0xffffffffu;
+	for (uint64_t i = 0; i < size; ++i)
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return crc ^ 0xffffffffu;
+}
+
+static bool gzip_file(const char *src, const char *dst, sl_allocator *allocator)
+{
+	struct sl_os_filesystem_api *fs = sl_os_api->file_system;
+
+	sl_os_file in = fs->open_file_read(src);
+	if (!in.valid)
+		return false;
+
+	const uint64_t size = fs->file_size(in);
+	const uint8_t *data = size ? fs->map_file(in, 0, size, false) : NULL;
+	//Rotated files are bounded by max_file_size, positions have to fit the hash chains
+	if ((size && !data) || size >= UINT32_MAX) {
+		if (data)
+			fs->unmap_file((void *)data, size);
+		fs->file_close(in);
+		return false;
+	}
+
+	gzip_writer w = {
+		.file = fs->open_file_write(dst),
+		.ok = true,
+	};
+	if (!w.file.valid) {
+		if (data)
+			fs->unmap_file((void *)data, size);
+		fs->file_close(in);
+		return false;
+	}
+
+	w.out = sl_alloc(allocator, GZIP_OUT_SIZE);
+	uint32_t *head = sl_alloc(allocator, GZIP_HASH_SIZE * sizeof(uint32_t));
+	uint32_t *prev = sl_alloc(allocator, GZIP_WINDOW * sizeof(uint32_t));
+
+	//Magic, deflate, no flags or time, unknown OS
+	static const uint8_t header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+	for (uint32_t i = 0; i < sizeof(header); ++i)
+		gzip_byte(&w, header[i]);
+
+	gzip_deflate(&w, data, (uint32_t)size, head, prev);
+	gzip_u32(&w, gzip_crc32(data, size));
+	gzip_u32(&w, (uint32_t)size);
+	gzip_write_out(&w);
+
+	sl_free(allocator, prev);
+	sl_free(allocator, head);
+	sl_free(allocator, w.out);
+	if (data)
+		fs->unmap_file((void *)data, size);
+	fs->file_close(in);
+	fs->file_close(w.file);
+	return w.ok;
+}
+
+#pragma endregion
+
+static void compress_task(void *data)
+{
+	compress_job *job = data;
+	struct sl_os_filesystem_api *fs = sl_os_api->file_system;
+
+	//Written under a temporary name, so a .gz is never left half done
+	if (gzip_file(job->src, job->tmp, &job->allocator) && fs->file_rename(job->tmp, job->dst))
+		fs->file_delete(job->src);
+	else
+		fs->file_delete(job->tmp);
+
+	sl_atomic_uint32_t *compressing = job->compressing;
+	sl_allocator allocator = job->allocator;
+	sl_free(&allocator, job);
+	atomic_fetch_sub(compressing, 1);
+}
+
+static void rotated_name(char *out, const char *path, uint32_t index, const char *extension)
+{
+	sl_snprintf(out, (int)(strlen(path) + ROTATED_SUFFIX), "%s.%u%s", path, index, extension);
+}
+
+static void start_compress(file_sink *s, const char *src)
+{
+	const size_t length = strlen(s->path) + ROTATED_SUFFIX;
+	compress_job *job = sl_alloc(&s->allocator, sizeof(compress_job) + 3 * length);
+	job->allocator = s->allocator;
+	job->compressing = &s->compressing;
+	job->src = (char *)(job + 1);
+	job->tmp = job->src + length;
+	job->dst = job->tmp + length;
+	sl_memcpy(job->src, src, strlen(src) + 1);
+	rotated_name(job->tmp, s->path, 1, ".gz.tmp");
+	rotated_name(job->dst, s->path, 1, ".gz");
+
+	atomic_fetch_add(&s->compressing, 1);
+	if (s->job_system) {
+		sl_job_decl decl = {
+			.task = compress_task,
+			.data = job,
+			.priority = sl_normal_priority,
+		};
+		s->job_system->run_jobs_and_free(&decl, 1, sl_ss_normal);
+	} else {
+		//Rotation is put off while a compression runs, so the last thread is already returning
+		if (s->compressor_started)
+			sl_os_api->thread->join_os_thread(s->compressor);
+		s->compressor = sl_os_api->thread->create_os_thread(compress_task, job, SL_KILOBYTES(64), "Log Compression");
+		s->compressor_started = true;
+	}
+}
+
+static void wait_for_compression(file_sink *s)
+{
+	while (atomic_load(&s->compressing))
+		sl_os_api->thread->sleep(0.001);
+}
+
+static void write_buffer(file_sink *s)
+{
+	if (s->used && s->file.valid)
+		sl_os_api->file_system->file_write(s->file, s->buffer, s->used);
+	s->used = 0;
+}
+
+//path.N is replaced, every other file moves up one and the current file becomes path.1
+static void rotate(file_sink *s)
+{
+	struct sl_os_filesystem_api *fs = sl_os_api->file_system;
+
+	write_buffer(s);
+	if (s->file.valid)
+		fs->file_close(s->file);
+
+	const char *extension = s->compress ? ".gz" : "";
+	const size_t length = strlen(s->path) + ROTATED_SUFFIX;
+	char *from = sl_alloc(&s->allocator, 2 * length);
+	char *to = from + length;
+	for (uint32_t i = s->max_files; i > 1; --i) {
+		rotated_name(from, s->path, i - 1, extension);
+		rotated_name(to, s->path, i, extension);
+		fs->file_rename(from, to);
+	}
+
+	rotated_name(to, s->path, 1, "");
+	if (fs->file_rename(s->path, to) && s->compress)
+		start_compress(s, to);
+	sl_free(&s->allocator, from);
+
+	s->file = fs->open_file_append(s->path);
+	s->file_size = 0;
+}
+
+static void sink_log(sl_logger *logger, enum sl_log_level level, const char *message)
+{
+	file_sink *s = logger->inst;
+	const uint32_t length = (uint32_t)strlen(message);
+	const uint64_t now = sl_os_api->info->nanoseconds();
+
+	sl_lock_mutex(&s->lock);
+
+	//Waiting here would stall every thread that logs, and with a job system maybe the job it waits for,
+	//so the rotation is put off while the previous compression still owns path.1
+	if (s->max_file_size && s->file_size && s->file_size + length > s->max_file_size &&
+		!(s->compress && atomic_load(&s->compressing)))
+		rotate(s);
+
+	if (s->used + length > s->buffer_size)
+		write_buffer(s);
+
+	if (length >= s->buffer_size) {
+		if (s->file.valid)
+			sl_os_api->file_system->file_write(s->file, message, length);
+	} else {
+		if (!s->used)
+			s->buffered_since = now;
+		sl_memcpy(s->buffer + s->used, message, length);
+		s->used += length;
+	}
+	s->file_size += length;
+
+	if (s->flush_levels & (1u << level)) {
+		write_buffer(s);
+		if (s->sync_to_device && s->file.valid)
+			sl_os_api->file_system->file_flush(s->file);
+	} else if (s->used && now - s->buffered_since >= s->flush_interval) {
+		write_buffer(s);
+	}
+
+	sl_unlock_mutex(&s->lock);
+}
+
+//Writes messages that waited flush_interval while nothing else was logged
+static void flusher_entry(void *data)
+{
+	file_sink *s = data;
+	const double interval = (double)s->flush_interval / 1e9;
+	const double sleep = interval < FLUSH_THREAD_SLEEP ? interval : FLUSH_THREAD_SLEEP;
+
+	while (atomic_load_explicit(&s->running, memory_order_acquire)) {
+		sl_lock_mutex(&s->lock);
+		if (s->used && sl_os_api->info->nanoseconds() - s->buffered_since >= s->flush_interval)
+			write_buffer(s);
+		sl_unlock_mutex(&s->lock);
+		sl_os_api->thread->sleep(sleep);
+	}
+}
+
+static sl_logger *open_sink(const sl_log_file_sink_desc *desc)
+{
+	sl_os_file file = sl_os_api->file_system->open_file_append(desc->path);
+	if (!file.valid)
+		return NULL;
+
+	//Untracked like the async logger, the sink logs leaks after the tracker reported them
+	sl_allocator allocator = *sl_allocator_api->system;
+	allocator.context = SL_MEMORY_CONTEXT_NONE;
+
+	file_sink *s = sl_alloc(&allocator, sizeof(file_sink));
+	sl_memset(s, 0, sizeof(file_sink));
+	s->allocator = allocator;
+	s->file = file;
+	s->file_size = sl_os_api->file_system->file_size(file);
+
+	const size_t path_length = strlen(desc->path) + 1;
+	s->path = sl_alloc(&allocator, path_length);
+	sl_memcpy(s->path, desc->path, path_length);
+
+	s->buffer_size = desc->buffer_size ? desc->buffer_size : DEFAULT_BUFFER_SIZE;
+	s->buffer = sl_alloc(&allocator, s->buffer_size);
+	s->flush_interval = (uint64_t)((desc->flush_interval > 0.0 ? desc->flush_interval : DEFAULT_FLUSH_INTERVAL) * 1e9);
+	s->flush_levels = desc->flush_levels ? desc->flush_levels : 1u << sl_log_level_error;
+	s->sync_to_device = desc->sync_to_device;
+	s->max_file_size = desc->max_file_size;
+	s->max_files = desc->max_files ? desc->max_files : DEFAULT_MAX_FILES;
+	s->compress = desc->compress;
+	s->job_system = desc->job_system;
+	sl_create_mutex(&s->lock);
+
+	s->logger = (sl_logger){
+		.inst = s,
+		.log = sink_log,
+	};
+
+	atomic_store(&s->running, true);
+	s->flusher = sl_os_api->thread->create_os_thread(flusher_entry, s, SL_KILOBYTES(64), "Log File Flush");
+
+	sl_logger_api->register_logger(&s->logger);
+	return &s->logger;
+}
+
+static void flush_sink(sl_logger *logger)
+{
+	file_sink *s = logger->inst;
+	sl_lock_mutex(&s->lock);
+	write_buffer(s);
+	sl_unlock_mutex(&s->lock);
+}
+
+static void close_sink(sl_logger *logger)
+{
+	file_sink *s = logger->inst;
+	sl_logger_api->unregister_logger(logger);
+
+	atomic_store_explicit(&s->running, false, memory_order_release);
+	sl_os_api->thread->join_os_thread(s->flusher);
+
+	write_buffer(s);
+	if (s->file.valid) {
+		if (s->sync_to_device)
+			sl_os_api->file_system->file_flush(s->file);
+		sl_os_api->file_system->file_close(s->file);
+	}
+	wait_for_compression(s);
+	if (s->compressor_started)
+		sl_os_api->thread->join_os_thread(s->compressor);
+
+	sl_destroy_mutex(&s->lock);
+	sl_allocator allocator = s->allocator;
+	sl_free(&allocator, s->buffer);
+	sl_free(&allocator, s->path);
+	sl_free(&allocator, s);
+}
+
+static struct sl_log_file_sink_api file_sink_api = {
+	.open = open_sink,
+	.flush = flush_sink,
+	.close = close_sink,
+};
+
+struct sl_log_file_sink_api *sl_log_file_sink_api = &file_sink_api;
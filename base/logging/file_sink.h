@@ -0,0 +1,105 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_LOG_FILE_SINK_H
+#define STARLIGHT_LOG_FILE_SINK_H
+
+#include "defines.h"
+#include "logger.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct sl_job_system_api;
+
+typedef struct sl_log_file_sink_desc {
+	//File messages are appended to, created if it doesn't exist
+	const char *path;
+
+	//Bytes collected before they are written to the file (0 for 256KB)
+	uint32_t buffer_size;
+
+	//Seconds a message may wait in the buffer before it is written (0 for 1 second)
+	double flush_interval;
+
+	//Levels, as bits (1 << level), whose messages are written right away, so they survive
+	//the process crashing right after (0 for sl_log_level_error only)
+	uint32_t flush_levels;
+
+	//Also sync flush_levels messages to the storage device so they survive a power loss.
+	//Every sync waits for the drive, so this makes each of those messages slow
+	bool sync_to_device;
+
+	//Size the file may grow to before it is renamed to path.1, 0 never rotates.
+	//With compress the file keeps growing while the previous rotated file is still being compressed
+	uint64_t max_file_size;
+
+	//Rotated files kept, path.1 is the newest and the oldest is deleted (0 for 4)
+	uint32_t max_files;
+
+	//Gzip rotated files into path.N.gz in the background
+	bool compress;
+
+	//Compression runs as a job here, NULL uses a short lived OS thread instead.
+	//Must outlive the sink
+	struct sl_job_system_api *job_system;
+} sl_log_file_sink_desc;
+
+/*
+ * Logger that writes messages to a file in large blocks, so logging volume doesn't depend on how
+ * fast stdout or a terminal is. A background thread flushes messages older than flush_interval.
+ */
+struct sl_log_file_sink_api {
+	/**
+	 * @brief Opens the File and Registers the Sink with sl_logger_api
+	 * @returns The Registered Logger, NULL if the File Couldn't be Opened
+	 */
+	sl_logger *(*open)(const sl_log_file_sink_desc *desc);
+
+	/**
+	 * @brief Writes Buffered Messages to the File Without Waiting for a Threshold
+	 */
+	void (*flush)(sl_logger *sink);
+
+	/**
+	 * @brief Unregisters the Sink, Writes What is Buffered and Waits for Compression to Finish
+	 * Messages still on their way through an async logger should be flushed with sl_logger_api->flush first,
+	 * and no thread may be inside the sink's log function anymore.
+	 */
+	void (*close)(sl_logger *sink);
+};
+
+#define SL_LOG_FILE_SINK_API "sl_log_file_sink_api"
+
+#ifdef LINKS_SL_BASE
+
+extern struct sl_log_file_sink_api *sl_log_file_sink_api; //file_sink.c
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //STARLIGHT_LOG_FILE_SINK_H
@@ -0,0 +1,102 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_LOG_BINARY_H
+#define STARLIGHT_LOG_BINARY_H
+
+#include "defines.h"
+
+/*
+ * File written by binary logging (sl_logger_async_desc.binary with a binary_path):
+ *
+ *   sl_log_binary_header
+ *   records...
+ *
+ * Every record starts with an sl_log_binary_record and is padded to a multiple of 8 bytes,
+ * so readers can skip records they don't know. Sites and threads are written once, before
+ * the first message that refers to them. Messages are written per thread, so messages of
+ * different threads are only ordered by their time.
+ *
+ * The arguments of a message are stored in the order the format uses them, each in 8 bytes:
+ *   '*' width and precision, %d %i %c    int64_t, widened from int (or long long with a 64 bit length modifier)
+ *   %u %x %X %o %b %B                    uint64_t, widened the same way
+ *   %p %n                                uint64_t address
+ *   %f %F %e %E %g %G %a %A              double
+ *   %s                                   uint64_t length (UINT64_MAX for NULL), then the characters,
+ *                                        NUL terminated and padded to 8 bytes
+ * sl_logger_api->format_binary turns the format and the arguments back into the message.
+ */
+
+#define SL_LOG_BINARY_MAGIC 0x474c4c53u //"SLLG"
+#define SL_LOG_BINARY_VERSION 2
+
+typedef struct sl_log_binary_header {
+    uint32_t magic;
+    uint32_t version;
+    //sl_os_info_api->nanoseconds when the log began, message times are on the same clock
+    uint64_t start_time;
+    //Seconds since the epoch when the log began
+    int64_t start_wall_time;
+} sl_log_binary_header;
+
+typedef enum sl_log_binary_record_type {
+    sl_log_binary_message = 1,
+    sl_log_binary_site = 2,
+    sl_log_binary_thread = 3,
+} sl_log_binary_record_type;
+
+typedef struct sl_log_binary_record {
+    uint32_t type;
+    //Size of the whole record including this header and padding
+    uint32_t size;
+} sl_log_binary_record;
+
+//A log call, followed by args_size bytes of arguments
+typedef struct sl_log_binary_message_record {
+    sl_log_binary_record record;
+    uint64_t time;
+    uint32_t site;
+    uint32_t thread;
+    uint32_t args_size;
+    uint32_t padding;
+} sl_log_binary_message_record;
+
+//A call site (enum sl_log_level, format and file), followed by format_length + file_length characters (not NUL terminated)
+typedef struct sl_log_binary_site_record {
+    sl_log_binary_record record;
+    uint32_t id;
+    uint32_t line;
+    uint32_t level;
+    uint32_t format_length;
+    uint32_t file_length;
+    uint32_t padding;
+} sl_log_binary_site_record;
+
+//Followed by name_length characters (not NUL terminated)
+typedef struct sl_log_binary_thread_record {
+    sl_log_binary_record record;
+    uint32_t id;
+    uint32_t name_length;
+} sl_log_binary_thread_record;
+
+#endif //STARLIGHT_LOG_BINARY_H
@@ -21,17 +21,48 @@
 // SOFTWARE.
 
 #include "logger.h"
+#include "log_binary.h"
 
 #include "util/sprintf.h"
 #include "util/path_util.inl"
+#include "util/assertions.inl"
+#include "thread/atomics.inl"
+#include "thread/spinlock.inl"
+#include "data_structures/mpmc_queue.h"
+#include "data_structures/array.inl"
+#include "data_structures/hash.inl"
+#include "data_structures/flat_map.inl"
 #include "os/os.h"
+#include "memory/allocator.h"
+#include "memory/mem_tracker.h"
+#include "memory/scratch_allocator.h"
 #include <stdio.h>
+#include <string.h>
 #include <sys/time.h>
+#include <time.h>
 
 #define MAX_LOGGERS 24
 
+//Characters of a message kept inside the record, longer messages are allocated
+#define LOG_RECORD_TEXT 256
+
+//How long the writer thread sleeps once the ring is empty
+#define LOG_WRITER_SLEEP 0.001
+
+//Default size of a thread's binary buffer, must be a power of two
+#define BINARY_BUFFER_SIZE SL_KILOBYTES(64)
+
+//Set in binary_entry.size when the rest of the buffer was skipped to keep an entry in one piece
+#define BINARY_WRAP 0x80000000u
+
 static uint32_t num_loggers;
 static sl_logger loggers[MAX_LOGGERS];
+static sl_spinlock loggers_lock;
+
+//Every level bit set
+#define ALL_LEVELS ((1u << (sl_log_level_error + 1)) - 1)
+
+static uint32_t channel_masks[sl_log_channel_count];
 
 #if SL_PLATFORM_WINDOWS
 void OutputDebugStringA(const char *s);
@@ -39,11 +70,169 @@ void OutputDebugStringA(const char *s);
 
 extern struct sl_sprintf_api* sl_sprintf_api; //sprintf.c
 extern struct sl_os_api* sl_os_api;
+extern struct sl_allocator_api* sl_allocator_api; //allocator.c
+extern struct sl_scratch_allocator_api* sl_scratch_allocator_api; //scratch_allocator.c
+
+//A log_printf call, everything the prologue needs is captured on the calling thread
+typedef struct log_record {
+	const char *file;
+
+	//Set when the message didn't fit in text
+	char *long_message;
+
+	time_t time;
+
+	uint32_t line;
+
+	enum sl_log_level level;
+
+	char thread_name[32];
+
+	char text[LOG_RECORD_TEXT];
+} log_record;
+
+MAKE_MPMC_QUEUE_TYPE(log, log_record)
+
+//A binary log call, followed by args_size bytes of arguments in the log_binary.h layout
+typedef struct binary_entry {
+	//Whole entry with padding, a multiple of 8
+	uint32_t size;
+
+	uint32_t line;
+
+	const char *format;
+
+	const char *file;
+
+	uint64_t time;
+
+	uint32_t level;
+
+	uint32_t args_size;
+} binary_entry;
+
+/*
+ * With binary logging each thread owns a single producer/single consumer byte ring of entries.
+ * An entry never wraps around the end, the producer skips what's left of the ring instead.
+ * The writer moves head only after an entry was written out, so flush waits for head to
+ * reach the tail every buffer had when it was called.
+ */
+typedef struct binary_buffer {
+	sl_atomic_uint64_t head;
+	uint8_t pad0[64 - sizeof(sl_atomic_uint64_t)];
+	sl_atomic_uint64_t tail;
+	uint8_t pad1[64 - sizeof(sl_atomic_uint64_t)];
+
+	uint8_t *data;
+	struct binary_buffer *next;
+
+	//Cleared when the owning thread exits, the ring is handed to a new thread once it's drained
+	sl_atomic_bool owned;
+
+	uint32_t thread;
+	//Set by the writer once the thread record is in the file
+	bool announced;
+	char thread_name[32];
+} binary_buffer;
+
+//What a binary site is looked up by
+typedef struct binary_site_key {
+	const char *format;
+	const char *file;
+	uint32_t line;
+	uint32_t level;
+} binary_site_key;
+
+/*
+ * Any thread pushes records into the ring, only the writer thread pops them. pushed is
+ * raised before a record goes in and written after it went through the loggers, so
+ * flush only has to wait for written to catch up. With sl_log_backpressure_grow, a full
+ * ring sends records to the overflow list until the writer has emptied the ring and
+ * swapped the list out, so a thread's records stay in order.
+ */
+typedef struct async_logger {
+	mpmc_queue_log_c queue;
+
+	mpmc_queue_log_cell *cells;
+
+	sl_allocator allocator;
+
+	enum sl_log_backpressure backpressure;
+
+	sl_atomic_bool running;
+
+	sl_os_thread writer;
+
+	sl_atomic_uint64_t pushed;
+
+	sl_atomic_uint64_t written;
+
+	sl_atomic_uint64_t dropped;
+
+	uint64_t dropped_reported;
+
+	sl_spinlock overflow_lock;
+
+	sl_atomic_bool overflowing;
+
+	log_record *overflow;
+
+	//The writer's side of the overflow double buffer
+	log_record *spill;
+
+	bool binary;
+
+	uint32_t binary_buffer_size;
+
+	//async_generation at enable_async, tells threads their binary buffer is from an older logger
+	uint32_t generation;
+
+	//Every binary_buffer registered, pushed lock free (binary_buffer*)
+	sl_atomic_uint64_t buffers;
+
+	//Binary log file, everything below is only used by the writer
+	sl_os_file file;
+
+	uint64_t start_time;
+
+	int64_t start_wall_time;
+
+	//wyhash of a binary_site_key -> site id
+	sl_flat_map_u64 sites;
+
+	uint32_t num_sites;
+
+	//Records waiting for the next file_write
+	SL_ARRAY(uint8_t, out);
+} async_logger;
+
+static async_logger *async;
+static sl_atomic_bool async_enabled;
+
+//Threads between checking async_enabled and being done with async, disable_async waits for them to leave
+static sl_atomic_uint32_t async_users;
+
+static uint32_t async_generation;
+
+static SL_THREAD_LOCAL bool log_writer_thread;
+static SL_THREAD_LOCAL char thread_name[32];
+static SL_THREAD_LOCAL bool thread_name_read;
+static SL_THREAD_LOCAL uint32_t thread_name_version;
+static SL_THREAD_LOCAL binary_buffer *thread_binary;
+static SL_THREAD_LOCAL uint32_t thread_binary_generation;
+//Set when the thread was renamed after its binary buffer was registered
+static SL_THREAD_LOCAL bool thread_binary_renamed;
+static SL_THREAD_LOCAL sl_os_thread_exit thread_binary_exit;
+
+static int log_printf(enum sl_log_level level, const char* file, uint32_t line, const char *format, ...);
 
 void default_print(struct sl_logger* logger, enum sl_log_level level, const char* message)
 {
 	fputs(message, stdout);
 
+	if (level == sl_log_level_error)
+		fflush(stdout);
+
 #if SL_PLATFORM_WINDOWS
 	OutputDebugStringA(message);
 #endif
@@ -56,69 +245,916 @@ static sl_logger default_logger = {
 
 void init_logger_system(void)
 {
+		sl_spinlock_init(&loggers_lock);
 		num_loggers = 1;
 		loggers[0] = default_logger;
+		for (uint32_t i = 0; i < sl_log_channel_count; ++i)
+			channel_masks[i] = ALL_LEVELS;
 }
 
 void register_logger(const sl_logger* logger)
 {
+	sl_spinlock_lock(&loggers_lock);
 	for (uint32_t i = 0; i < num_loggers; ++i) {
-		if (sl_memcmp(loggers + i, logger, sizeof(sl_logger)) == 0)
+		if (sl_memcmp(loggers + i, logger, sizeof(sl_logger)) == 0) {
+			sl_spinlock_unlock(&loggers_lock);
 			return;
+		}
 	}
 
 	if (num_loggers >= MAX_LOGGERS) {
 		//TODO ERROR MESSAGE!
+		sl_spinlock_unlock(&loggers_lock);
 		return;
 	}
 
 	loggers[num_loggers] = *logger;
 	num_loggers += 1;
+	sl_spinlock_unlock(&loggers_lock);
 }
 
 void unregister_logger(const sl_logger* logger)
 {
+	sl_spinlock_lock(&loggers_lock);
 	for (uint32_t i = 0; i < num_loggers; ++i) {
 		if (sl_memcmp(loggers + i, logger, sizeof(sl_logger)) == 0) {
 			num_loggers -= 1;
 			loggers[i] = loggers[num_loggers];
-			return;
+			break;
 		}
 	}
+	sl_spinlock_unlock(&loggers_lock);
 }
 
 static void log_print(enum sl_log_level level, const char *message)
 {
-	for (uint32_t i = 0; i < num_loggers; i++) {
-		loggers[i].log(loggers[i].inst, level, message);
+	//Copied so a logger can log or (un)register loggers itself
+	sl_logger current[MAX_LOGGERS];
+	sl_spinlock_lock(&loggers_lock);
+	const uint32_t count = num_loggers;
+	sl_memcpy(current, loggers, count * sizeof(sl_logger));
+	sl_spinlock_unlock(&loggers_lock);
+
+	for (uint32_t i = 0; i < count; i++) {
+		current[i].log(&current[i], level, message);
+	}
+}
+
+//Adds the prologue and passes the record to every logger
+static void write_record(const log_record *record)
+{
+	sl_scratch_mark mark = sl_scratch_allocator_api->push();
+	sl_allocator* scratch = &mark.allocator;
+
+	const char* level_strings[3] = {"[DEBUG]: ", "[INFO]: ", "[ERROR]: "};
+	const struct tm* timeinfo = localtime(&record->time);
+
+	const char* message = record->long_message ? record->long_message : record->text;
+	const char* prologue_format = "[%d-%d-%d] %s:%d [%s] %s%s";
+	const char* file_name = sl_get_file_name(record->file);
+	int size = sl_snprintf(NULL, 0, prologue_format, timeinfo->tm_mon + 1, timeinfo->tm_mday, timeinfo->tm_year + 1900, file_name, record->line, record->thread_name, level_strings[record->level], message);
+	char* prologue = sl_alloc(scratch, size + 1);
+	sl_snprintf(prologue, size + 1, prologue_format, timeinfo->tm_mon + 1, timeinfo->tm_mday, timeinfo->tm_year + 1900, file_name, record->line, record->thread_name, level_strings[record->level], message);
+
+	log_print(record->level, prologue);
+
+	sl_scratch_allocator_api->pop(&mark);
+}
+
+//One conversion of a format, from the '%' to the conversion character
+typedef struct log_spec {
+	const char *start;
+
+	//Start of the length modifier, or the conversion character if there is none
+	const char *modifier;
+
+	char conversion;
+
+	//Size of the integer argument the length modifier asks for
+	uint8_t int_size;
+
+	bool star_width;
+
+	bool star_precision;
+} log_spec;
+
+typedef enum log_arg_kind {
+	log_arg_none,
+	log_arg_signed,
+	log_arg_char,
+	log_arg_unsigned,
+	log_arg_pointer,
+	log_arg_double,
+	log_arg_string,
+} log_arg_kind;
+
+//Parses the conversion starting at the '%' f points at, returns the character after it
+static const char *parse_spec(const char *f, log_spec *spec)
+{
+	*spec = (log_spec){ .start = f, .int_size = sizeof(int) };
+	++f;
+	//stb_sprintf flags, ' $ and _ included
+	while (*f == '-' || *f == '+' || *f == ' ' || *f == '#' || *f == '0' || *f == '\'' || *f == '$' || *f == '_')
+		++f;
+	if (*f == '*') {
+		spec->star_width = true;
+		++f;
+	} else {
+		while (*f >= '0' && *f <= '9')
+			++f;
+	}
+	if (*f == '.') {
+		++f;
+		if (*f == '*') {
+			spec->star_precision = true;
+			++f;
+		} else {
+			while (*f >= '0' && *f <= '9')
+				++f;
+		}
+	}
+
+	spec->modifier = f;
+	switch (*f) {
+		case 'h':
+			spec->int_size = (f[1] == 'h') ? 1 : 2;
+			f += (f[1] == 'h') ? 2 : 1;
+			break;
+		case 'l':
+			spec->int_size = (f[1] == 'l') ? 8 : sizeof(long);
+			f += (f[1] == 'l') ? 2 : 1;
+			break;
+		case 'j':
+		case 'z':
+		case 't':
+			spec->int_size = 8;
+			++f;
+			break;
+		case 'I':
+			if (f[1] == '6' && f[2] == '4') {
+				spec->int_size = 8;
+				f += 3;
+			} else if (f[1] == '3' && f[2] == '2') {
+				spec->int_size = 4;
+				f += 3;
+			} else {
+				spec->int_size = sizeof(void *);
+				++f;
+			}
+			break;
+		default:
+			break;
+	}
+
+	spec->conversion = *f;
+	return *f ? f + 1 : f;
+}
+
+static log_arg_kind spec_kind(const log_spec *spec)
+{
+	switch (spec->conversion) {
+		case 'd':
+		case 'i':
+			return log_arg_signed;
+		case 'c':
+			return log_arg_char;
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'o':
+		case 'b':
+		case 'B':
+			return log_arg_unsigned;
+		case 'p':
+		case 'n':
+			return log_arg_pointer;
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			return log_arg_double;
+		case 's':
+			return log_arg_string;
+		default:
+			return log_arg_none;
+	}
+}
+
+static void capture_u64(uint8_t *out, uint32_t *size, uint64_t value)
+{
+	if (out)
+		sl_memcpy(out + *size, &value, sizeof(value));
+	*size += sizeof(value);
+}
+
+//Copies the arguments format uses into out in the log_binary.h layout, or only measures them if out is NULL
+static uint32_t capture_args(uint8_t *out, const char *format, __builtin_va_list *args)
+{
+	uint32_t size = 0;
+	for (const char *f = format; *f;) {
+		if (*f != '%') {
+			++f;
+			continue;
+		}
+		if (f[1] == '%') {
+			f += 2;
+			continue;
+		}
+
+		log_spec spec;
+		f = parse_spec(f, &spec);
+		if (spec.star_width)
+			capture_u64(out, &size, (uint64_t)(int64_t)va_arg(*args, int));
+		if (spec.star_precision)
+			capture_u64(out, &size, (uint64_t)(int64_t)va_arg(*args, int));
+
+		switch (spec_kind(&spec)) {
+			case log_arg_signed: {
+				int64_t value;
+				//stb_sprintf doesn't cut h and hh arguments down either
+				if (spec.int_size == 8)
+					value = va_arg(*args, long long);
+				else
+					value = va_arg(*args, int);
+				capture_u64(out, &size, (uint64_t)value);
+				break;
+			}
+			case log_arg_char:
+				capture_u64(out, &size, (uint64_t)(int64_t)va_arg(*args, int));
+				break;
+			case log_arg_unsigned: {
+				uint64_t value;
+				if (spec.int_size == 8)
+					value = va_arg(*args, unsigned long long);
+				else
+					value = va_arg(*args, unsigned int);
+				capture_u64(out, &size, value);
+				break;
+			}
+			case log_arg_pointer:
+				capture_u64(out, &size, (uint64_t)(uintptr_t)va_arg(*args, void *));
+				break;
+			case log_arg_double: {
+				const double value = va_arg(*args, double);
+				if (out)
+					sl_memcpy(out + size, &value, sizeof(value));
+				size += sizeof(value);
+				break;
+			}
+			case log_arg_string: {
+				const char *string = va_arg(*args, const char *);
+				const uint64_t length = string ? strlen(string) : UINT64_MAX;
+				capture_u64(out, &size, length);
+				if (string) {
+					const uint32_t padded = (uint32_t)((length + 1 + 7) & ~7ull);
+					if (out) {
+						sl_memset(out + size + padded - 8, 0, 8);
+						sl_memcpy(out + size, string, length + 1);
+					}
+					size += padded;
+				}
+				break;
+			}
+			case log_arg_none:
+				break;
+		}
+	}
+	return size;
+}
+
+static bool read_u64(const uint8_t **in, const uint8_t *end, uint64_t *value)
+{
+	if ((uint64_t)(end - *in) < sizeof(uint64_t))
+		return false;
+	sl_memcpy(value, *in, sizeof(uint64_t));
+	*in += sizeof(uint64_t);
+	return true;
+}
+
+static int format_binary(char *buffer, int size, const char *format, const void *args, uint32_t args_size)
+{
+	const uint8_t *in = (const uint8_t *)args;
+	const uint8_t *end = in + args_size;
+	int length = 0;
+
+	for (const char *f = format; *f;) {
+		if (*f != '%' || f[1] == '%') {
+			if (length < size - 1)
+				buffer[length] = *f;
+			length += 1;
+			f += (*f == '%') ? 2 : 1;
+			continue;
+		}
+
+		log_spec spec;
+		const char *next = parse_spec(f, &spec);
+		const log_arg_kind kind = spec_kind(&spec);
+
+		//The same conversion with a 64 bit length modifier, '*' values are passed like log_printf got them
+		char conversion[48];
+		uint32_t c = 0;
+		int stars[2];
+		uint32_t num_stars = 0;
+		uint64_t value = 0;
+		bool valid = kind != log_arg_none && (spec.modifier - spec.start) < 40;
+		for (const char *p = spec.start; valid && p < spec.modifier; ++p) {
+			conversion[c++] = *p;
+			if (*p == '*') {
+				valid = read_u64(&in, end, &value);
+				stars[num_stars++] = (int)(int64_t)value;
+			}
+		}
+		if (kind == log_arg_signed || kind == log_arg_unsigned) {
+			conversion[c++] = 'l';
+			conversion[c++] = 'l';
+		}
+		conversion[c++] = spec.conversion;
+		conversion[c] = 0;
+
+		const char *string = NULL;
+		if (valid && kind == log_arg_string) {
+			valid = read_u64(&in, end, &value);
+			if (valid && value != UINT64_MAX) {
+				const uint64_t padded = (value + 1 + 7) & ~7ull;
+				valid = padded <= (uint64_t)(end - in);
+				string = (const char *)in;
+				in += valid ? padded : 0;
+			}
+		} else if (valid) {
+			valid = read_u64(&in, end, &value);
+		}
+
+		if (!valid) {
+			//Not something log_printf captures (stb_sprintf drops a lone '%'), or the arguments ran out
+			for (const char *p = spec.start; spec.conversion && p < next; ++p, ++length)
+				if (length < size - 1)
+					buffer[length] = *p;
+			f = next;
+			continue;
+		}
+
+		char *at = length < size ? buffer + length : NULL;
+		const int left = length < size ? size - length : 0;
+#define LOG_PRINT_VALUE(v) (num_stars == 2 ? sl_snprintf(at, left, conversion, stars[0], stars[1], v) \
+		: num_stars == 1 ? sl_snprintf(at, left, conversion, stars[0], v) : sl_snprintf(at, left, conversion, v))
+		switch (kind) {
+			case log_arg_signed:
+				length += LOG_PRINT_VALUE((long long)value);
+				break;
+			case log_arg_unsigned:
+				length += LOG_PRINT_VALUE((unsigned long long)value);
+				break;
+			case log_arg_char:
+				length += LOG_PRINT_VALUE((int)value);
+				break;
+			case log_arg_pointer:
+				if (spec.conversion == 'p')
+					length += LOG_PRINT_VALUE((void *)(uintptr_t)value);
+				break;
+			case log_arg_double: {
+				double d;
+				sl_memcpy(&d, &value, sizeof(d));
+				length += LOG_PRINT_VALUE(d);
+				break;
+			}
+			case log_arg_string:
+				length += LOG_PRINT_VALUE(string);
+				break;
+			case log_arg_none:
+				break;
+		}
+#undef LOG_PRINT_VALUE
+		f = next;
+	}
+
+	if (size > 0)
+		buffer[length < size ? length : size - 1] = 0;
+	return length;
+}
+
+static void write_async_record(async_logger *l, log_record *record)
+{
+	write_record(record);
+	if (record->long_message)
+		sl_free(&l->allocator, record->long_message);
+	atomic_fetch_add_explicit(&l->written, 1, memory_order_release);
+}
+
+//Caller must be inside async_users
+static void push_record(async_logger *l, log_record *record)
+{
+	atomic_fetch_add_explicit(&l->pushed, 1, memory_order_relaxed);
+
+	if (l->backpressure == sl_log_backpressure_grow) {
+		if (!atomic_load_explicit(&l->overflowing, memory_order_acquire) && mpmc_queue_log_try_push(&l->queue, record))
+			return;
+		sl_spinlock_lock(&l->overflow_lock);
+		atomic_store_explicit(&l->overflowing, true, memory_order_relaxed);
+		sl_array_push(&l->allocator, l->overflow, *record);
+		sl_spinlock_unlock(&l->overflow_lock);
+		return;
+	}
+
+	while (!mpmc_queue_log_try_push(&l->queue, record)) {
+		if (l->backpressure == sl_log_backpressure_drop) {
+			if (record->long_message)
+				sl_free(&l->allocator, record->long_message);
+			atomic_fetch_sub_explicit(&l->pushed, 1, memory_order_relaxed);
+			atomic_fetch_add_explicit(&l->dropped, 1, memory_order_relaxed);
+			return;
+		}
+		sl_os_api->thread->thread_yield();
+	}
+}
+
+//Runs on a thread that exits, its ring goes to the next thread that needs one
+static void release_binary_buffer(void *data)
+{
+	atomic_fetch_add(&async_users, 1);
+	async_logger *l = atomic_load(&async_enabled) ? async : NULL;
+	if (l && thread_binary && thread_binary_generation == l->generation)
+		atomic_store_explicit(&thread_binary->owned, false, memory_order_release);
+	atomic_fetch_sub(&async_users, 1);
+	//Anything the thread logs after this registers a ring again
+	thread_binary = NULL;
+	thread_binary_generation = 0;
+}
+
+//The ring must be drained, the writer only reads the owner while it has entries to write
+static void set_binary_buffer_owner(binary_buffer *b)
+{
+	b->thread = sl_os_api->thread->get_thread_id();
+	sl_memcpy(b->thread_name, thread_name, sizeof(thread_name));
+	b->announced = false;
+	thread_binary_renamed = false;
+}
+
+static binary_buffer *register_binary_buffer(async_logger *l)
+{
+	//Rings of exited threads are reused, so threads that come and go don't add rings forever.
+	//The writer may still be writing the last owner's entries, those are waited for like a rename
+	binary_buffer *b = (binary_buffer *)(uintptr_t)atomic_load_explicit(&l->buffers, memory_order_acquire);
+	for (; b; b = b->next) {
+		bool owned = false;
+		if (atomic_compare_exchange_strong_explicit(&b->owned, &owned, true, memory_order_acquire, memory_order_relaxed))
+			break;
+	}
+
+	if (b) {
+		while (atomic_load_explicit(&b->head, memory_order_acquire) != atomic_load_explicit(&b->tail, memory_order_relaxed))
+			sl_os_api->thread->thread_yield();
+		set_binary_buffer_owner(b);
+	} else {
+		b = sl_alloc(&l->allocator, sizeof(binary_buffer));
+		sl_memset(b, 0, sizeof(binary_buffer));
+		b->data = sl_alloc(&l->allocator, l->binary_buffer_size);
+		atomic_store_explicit(&b->owned, true, memory_order_relaxed);
+		set_binary_buffer_owner(b);
+
+		uint64_t first = atomic_load_explicit(&l->buffers, memory_order_relaxed);
+		do {
+			b->next = (binary_buffer *)(uintptr_t)first;
+		} while (!atomic_compare_exchange_weak_explicit(&l->buffers, &first, (uint64_t)(uintptr_t)b,
+														memory_order_release, memory_order_relaxed));
+	}
+
+	//Registered once per thread, it releases whichever ring the thread has when it exits
+	if (!thread_binary_exit.callback) {
+		thread_binary_exit = (sl_os_thread_exit){
+			.callback = release_binary_buffer,
+		};
+		sl_os_api->thread->at_thread_exit(&thread_binary_exit);
 	}
+
+	thread_binary = b;
+	thread_binary_generation = l->generation;
+	return b;
+}
+
+//Caller must be inside async_users. Returns false if the entry is too big for the thread's buffer
+static bool push_binary(async_logger *l, enum sl_log_level level, const char *file, uint32_t line, const char *format, __builtin_va_list *args)
+{
+	binary_buffer *b = thread_binary_generation == l->generation ? thread_binary : register_binary_buffer(l);
+	//The writer announces a ring's name once, so a renamed thread waits for its ring to drain and announces it again
+	if (thread_binary_renamed) {
+		while (atomic_load_explicit(&b->head, memory_order_acquire) != atomic_load_explicit(&b->tail, memory_order_relaxed))
+			sl_os_api->thread->thread_yield();
+		set_binary_buffer_owner(b);
+	}
+
+	__builtin_va_list arg_copy;
+	va_copy(arg_copy, *args);
+	const uint32_t args_size = capture_args(NULL, format, &arg_copy);
+	va_end(arg_copy);
+
+	const uint64_t capacity = l->binary_buffer_size;
+	const uint64_t size = (sizeof(binary_entry) + args_size + 7) & ~7ull;
+	if (size > capacity / 4)
+		return false;
+
+	uint64_t tail = atomic_load_explicit(&b->tail, memory_order_relaxed);
+	const uint64_t at = tail & (capacity - 1);
+	const uint64_t skip = (capacity - at < size) ? capacity - at : 0;
+	while (tail + skip + size - atomic_load_explicit(&b->head, memory_order_acquire) > capacity) {
+		if (l->backpressure == sl_log_backpressure_drop) {
+			atomic_fetch_add_explicit(&l->dropped, 1, memory_order_relaxed);
+			return true;
+		}
+		sl_os_api->thread->thread_yield();
+	}
+
+	if (skip) {
+		((binary_entry *)(b->data + at))->size = BINARY_WRAP | (uint32_t)skip;
+		tail += skip;
+	}
+
+	binary_entry *e = (binary_entry *)(b->data + (tail & (capacity - 1)));
+	*e = (binary_entry){
+		.size = (uint32_t)size,
+		.line = line,
+		.format = format,
+		.file = file,
+		.time = sl_os_api->info->nanoseconds(),
+		.level = level,
+		.args_size = args_size,
+	};
+	va_copy(arg_copy, *args);
+	capture_args((uint8_t *)(e + 1), format, &arg_copy);
+	va_end(arg_copy);
+
+	atomic_store_explicit(&b->tail, tail + size, memory_order_release);
+	return true;
+}
+
+//Appends a record followed by up to two strings, padded to 8 bytes
+static void binary_append(async_logger *l, sl_log_binary_record *record, uint32_t record_size, const char *a, uint32_t a_length,
+						  const char *b, uint32_t b_length)
+{
+	const uint32_t size = (record_size + a_length + b_length + 7) & ~7u;
+	record->size = size;
+	uint8_t *out = sl_array_addnptr(&l->allocator, l->out, size);
+	sl_memset(out + size - 8, 0, 8);
+	sl_memcpy(out, record, record_size);
+	if (a_length)
+		sl_memcpy(out + record_size, a, a_length);
+	if (b_length)
+		sl_memcpy(out + record_size + a_length, b, b_length);
+}
+
+static void write_binary_entry(async_logger *l, binary_buffer *b, const binary_entry *e)
+{
+	const uint8_t *args = (const uint8_t *)(e + 1);
+
+	if (l->file.valid) {
+		if (!b->announced) {
+			sl_log_binary_thread_record r = {
+				.record.type = sl_log_binary_thread,
+				.id = b->thread,
+				.name_length = (uint32_t)strlen(b->thread_name),
+			};
+			binary_append(l, &r.record, sizeof(r), b->thread_name, r.name_length, NULL, 0);
+			b->announced = true;
+		}
+
+		const binary_site_key key = {
+			.format = e->format,
+			.file = e->file,
+			.line = e->line,
+			.level = e->level,
+		};
+		const uint64_t hash = sl_wyhash(&key, sizeof(key), 0);
+		const uint64_t *found = sl_flat_map_u64_get(&l->sites, hash);
+		uint32_t site = found ? (uint32_t)*found : 0;
+		if (!found) {
+			site = ++l->num_sites;
+			sl_flat_map_u64_insert(&l->allocator, &l->sites, hash, site);
+			sl_log_binary_site_record r = {
+				.record.type = sl_log_binary_site,
+				.id = site,
+				.line = e->line,
+				.level = e->level,
+				.format_length = (uint32_t)strlen(e->format),
+				.file_length = (uint32_t)strlen(e->file),
+			};
+			binary_append(l, &r.record, sizeof(r), e->format, r.format_length, e->file, r.file_length);
+		}
+
+		sl_log_binary_message_record r = {
+			.record.type = sl_log_binary_message,
+			.time = e->time,
+			.site = site,
+			.thread = b->thread,
+			.args_size = e->args_size,
+		};
+		binary_append(l, &r.record, sizeof(r), (const char *)args, e->args_size, NULL, 0);
+
+		//Errors are printed too
+		if (e->level != sl_log_level_error)
+			return;
+	}
+
+	sl_scratch_mark mark = sl_scratch_allocator_api->push();
+	log_record record = {
+		.file = e->file,
+		.line = e->line,
+		.level = (enum sl_log_level)e->level,
+		.time = (time_t)(l->start_wall_time + (int64_t)((e->time - l->start_time) / 1000000000ull)),
+	};
+	sl_memcpy(record.thread_name, b->thread_name, sizeof(b->thread_name));
+	const int length = format_binary(record.text, LOG_RECORD_TEXT, e->format, args, e->args_size);
+	if (length >= LOG_RECORD_TEXT) {
+		record.long_message = sl_alloc(&mark.allocator, length + 1);
+		format_binary(record.long_message, length + 1, e->format, args, e->args_size);
+	}
+	write_record(&record);
+	sl_scratch_allocator_api->pop(&mark);
+}
+
+//Returns true if anything was written
+static bool drain_binary(async_logger *l)
+{
+	bool wrote = false;
+	const uint64_t mask = l->binary_buffer_size - 1;
+	binary_buffer *b = (binary_buffer *)(uintptr_t)atomic_load_explicit(&l->buffers, memory_order_acquire);
+	for (; b; b = b->next) {
+		uint64_t head = atomic_load_explicit(&b->head, memory_order_relaxed);
+		const uint64_t tail = atomic_load_explicit(&b->tail, memory_order_acquire);
+		if (head == tail)
+			continue;
+
+		while (head != tail) {
+			const binary_entry *e = (const binary_entry *)(b->data + (head & mask));
+			if (!(e->size & BINARY_WRAP))
+				write_binary_entry(l, b, e);
+			head += e->size & ~BINARY_WRAP;
+		}
+
+		if (sl_array_size(l->out)) {
+			sl_os_api->file_system->file_write(l->file, l->out, sl_array_size(l->out));
+			sl_array_resize(&l->allocator, l->out, 0);
+		}
+		atomic_store_explicit(&b->head, head, memory_order_release);
+		wrote = true;
+	}
+	return wrote;
+}
+
+//Returns true if anything was written
+static bool drain_records(async_logger *l)
+{
+	bool wrote = false;
+	log_record record;
+	while (mpmc_queue_log_pop(&l->queue, &record)) {
+		write_async_record(l, &record);
+		wrote = true;
+	}
+
+	//Only records pushed before the ring filled up can be behind the overflow, and they were just written
+	if (atomic_load_explicit(&l->overflowing, memory_order_acquire)) {
+		sl_spinlock_lock(&l->overflow_lock);
+		log_record *spill = l->overflow;
+		l->overflow = l->spill;
+		l->spill = spill;
+		atomic_store_explicit(&l->overflowing, false, memory_order_release);
+		sl_spinlock_unlock(&l->overflow_lock);
+
+		for (uint32_t i = 0; i < (uint32_t)sl_array_size(l->spill); ++i)
+			write_async_record(l, l->spill + i);
+		sl_array_resize(&l->allocator, l->spill, 0);
+		wrote = true;
+	}
+
+	if (l->binary && drain_binary(l))
+		wrote = true;
+
+	const uint64_t dropped = atomic_load_explicit(&l->dropped, memory_order_relaxed);
+	if (dropped != l->dropped_reported) {
+		log_record notice = {
+			.file = __FILE__,
+			.line = __LINE__,
+			.level = sl_log_level_error,
+			.time = time(NULL),
+		};
+		sl_memcpy(notice.thread_name, thread_name, sizeof(thread_name));
+		sl_snprintf(notice.text, LOG_RECORD_TEXT, "%llu log messages were dropped, the ring was full\n", (unsigned long long)(dropped - l->dropped_reported));
+		write_record(&notice);
+		l->dropped_reported = dropped;
+	}
+
+	return wrote;
+}
+
+static void writer_entry(void *data)
+{
+	async_logger *l = (async_logger *)data;
+	log_writer_thread = true;
+	sl_os_api->thread->get_thread_name(thread_name, sizeof(thread_name));
+
+	while (atomic_load_explicit(&l->running, memory_order_acquire)) {
+		if (!drain_records(l))
+			sl_os_api->thread->sleep(LOG_WRITER_SLEEP);
+	}
+
+	//Nothing can be pushed anymore, see disable_async
+	drain_records(l);
+}
+
+static void flush(void)
+{
+	atomic_fetch_add(&async_users, 1);
+	if (atomic_load(&async_enabled) && !log_writer_thread) {
+		async_logger *l = async;
+		const uint64_t target = atomic_load_explicit(&l->pushed, memory_order_relaxed);
+		//pushed can go back down when a record is dropped
+		for (;;) {
+			const uint64_t pushed = atomic_load_explicit(&l->pushed, memory_order_relaxed);
+			if (atomic_load_explicit(&l->written, memory_order_acquire) >= (pushed < target ? pushed : target))
+				break;
+			sl_os_api->thread->thread_yield();
+		}
+
+		binary_buffer *b = (binary_buffer *)(uintptr_t)atomic_load_explicit(&l->buffers, memory_order_acquire);
+		for (; b; b = b->next) {
+			const uint64_t tail = atomic_load_explicit(&b->tail, memory_order_acquire);
+			while (atomic_load_explicit(&b->head, memory_order_acquire) < tail)
+				sl_os_api->thread->thread_yield();
+		}
+	}
+	atomic_fetch_sub(&async_users, 1);
+}
+
+static void disable_async(void)
+{
+	async_logger *l = async;
+	if (!l)
+		return;
+
+	atomic_store(&async_enabled, false);
+	while (atomic_load(&async_users))
+		sl_os_api->thread->thread_yield();
+
+	atomic_store_explicit(&l->running, false, memory_order_release);
+	sl_os_api->thread->join_os_thread(l->writer);
+
+	async = NULL;
+	binary_buffer *b = (binary_buffer *)(uintptr_t)atomic_load_explicit(&l->buffers, memory_order_acquire);
+	while (b) {
+		binary_buffer *next = b->next;
+		sl_free(&l->allocator, b->data);
+		sl_free(&l->allocator, b);
+		b = next;
+	}
+	if (l->file.valid)
+		sl_os_api->file_system->file_close(l->file);
+	sl_flat_map_u64_free(&l->allocator, &l->sites);
+	sl_array_free(&l->allocator, l->out);
+	sl_array_free(&l->allocator, l->overflow);
+	sl_array_free(&l->allocator, l->spill);
+	sl_free(&l->allocator, l->cells);
+	sl_allocator allocator = l->allocator;
+	sl_free(&allocator, l);
+}
+
+static void enable_async(const sl_logger_async_desc *desc)
+{
+	SL_ASSERT(desc->capacity >= 2 && !(desc->capacity & (desc->capacity - 1)), "Log ring capacity must be a power of two");
+
+	disable_async();
+
+	//Untracked, so logging from inside the memory tracker can't recurse into it
+	sl_allocator allocator = *sl_allocator_api->system;
+	allocator.context = SL_MEMORY_CONTEXT_NONE;
+
+	async_logger *l = sl_alloc(&allocator, sizeof(async_logger));
+	sl_memset(l, 0, sizeof(async_logger));
+	l->allocator = allocator;
+	l->backpressure = desc->backpressure;
+	l->cells = sl_alloc(&allocator, desc->capacity * sizeof(mpmc_queue_log_cell));
+	mpmc_queue_log_init(&l->queue, l->cells, desc->capacity);
+	sl_spinlock_init(&l->overflow_lock);
+	atomic_store_explicit(&l->running, true, memory_order_relaxed);
+	l->generation = ++async_generation;
+
+	if (desc->binary) {
+		l->binary = true;
+		l->binary_buffer_size = desc->thread_buffer_size ? desc->thread_buffer_size : BINARY_BUFFER_SIZE;
+		SL_ASSERT(l->binary_buffer_size >= SL_KILOBYTES(1) && !(l->binary_buffer_size & (l->binary_buffer_size - 1)),
+				  "Binary log thread buffers must be a power of two of at least 1KB");
+		l->start_time = sl_os_api->info->nanoseconds();
+		l->start_wall_time = (int64_t)time(NULL);
+
+		if (desc->binary_path) {
+			l->file = sl_os_api->file_system->open_file_write(desc->binary_path);
+			const sl_log_binary_header header = {
+				.magic = SL_LOG_BINARY_MAGIC,
+				.version = SL_LOG_BINARY_VERSION,
+				.start_time = l->start_time,
+				.start_wall_time = l->start_wall_time,
+			};
+			if (!l->file.valid || !sl_os_api->file_system->file_write(l->file, &header, sizeof(header))) {
+				log_printf(sl_log_level_error, __FILE__, __LINE__, "Failed to write the binary log %s, messages are formatted instead\n", desc->binary_path);
+				if (l->file.valid)
+					sl_os_api->file_system->file_close(l->file);
+				l->file = (sl_os_file){ 0 };
+			}
+		}
+	}
+
+	async = l;
+	l->writer = sl_os_api->thread->create_os_thread(writer_entry, l, SL_KILOBYTES(64), "Logger");
+	atomic_store(&async_enabled, true);
+}
+
+static uint64_t dropped_count(void)
+{
+	atomic_fetch_add(&async_users, 1);
+	const uint64_t dropped = atomic_load(&async_enabled) ? atomic_load_explicit(&async->dropped, memory_order_relaxed) : 0;
+	atomic_fetch_sub(&async_users, 1);
+	return dropped;
+}
+
+static void set_channel_level(enum sl_log_channel channel, enum sl_log_level level)
+{
+	channel_masks[channel] = ALL_LEVELS & ~((1u << level) - 1);
+}
+
+//The name is cached per thread and only looked up again after some thread was renamed
+static void refresh_thread_name(void)
+{
+	const uint32_t version = sl_os_api->thread->get_thread_name_version();
+	if (thread_name_read && version == thread_name_version)
+		return;
+
+	char name[sizeof(thread_name)];
+	sl_os_api->thread->get_thread_name(name, sizeof(name));
+	if (thread_name_read && strcmp(name, thread_name) != 0)
+		thread_binary_renamed = true;
+	sl_memcpy(thread_name, name, sizeof(name));
+	thread_name_version = version;
+	thread_name_read = true;
 }
 
 static int log_printf(enum sl_log_level level, const char* file, uint32_t line, const char *format, ...)
 {
+	refresh_thread_name();
 
-	char buffer[2400];
-	sl_memset(buffer, 0, sizeof(char)*2400);
 	__builtin_va_list arg_ptr;
 	va_start(arg_ptr, format);
-	int res = sl_vsprintf(buffer, format, arg_ptr);
-	va_end(arg_ptr);
 
-	const char* level_strings[3] = {"[INFO]: ", "[DEBUG]: ", "[ERROR]: "};
-	char prologue[8000];
-	sl_memset(prologue, 0, sizeof(char)*8000);
-	time_t rawtime;
-	struct tm * timeinfo;
+	atomic_fetch_add(&async_users, 1);
+	async_logger *l = (atomic_load(&async_enabled) && !log_writer_thread) ? async : NULL;
+
+	//Nothing is formatted, so there is no length to return
+	if (l && l->binary && push_binary(l, level, file, line, format, &arg_ptr)) {
+		va_end(arg_ptr);
+		atomic_fetch_sub(&async_users, 1);
+		if (level == sl_log_level_error)
+			flush();
+		return 0;
+	}
 
-	time(&rawtime);
-	timeinfo = localtime(&rawtime);
+	log_record record = {
+		.file = file,
+		.line = line,
+		.level = level,
+		.time = time(NULL),
+	};
+	sl_memcpy(record.thread_name, thread_name, sizeof(thread_name));
 
-	char thread_name[64];
-	sl_os_api->thread->get_thread_name(thread_name, 64);
+	__builtin_va_list arg_copy;
+	va_copy(arg_copy, arg_ptr);
+	const int res = sl_vsnprintf(record.text, LOG_RECORD_TEXT, format, arg_copy);
+	va_end(arg_copy);
+
+	if (l) {
+		if (res >= LOG_RECORD_TEXT) {
+			record.long_message = sl_alloc(&l->allocator, res + 1);
+			sl_vsnprintf(record.long_message, res + 1, format, arg_ptr);
+		}
+		va_end(arg_ptr);
+		push_record(l, &record);
+		atomic_fetch_sub(&async_users, 1);
+
+		if (level == sl_log_level_error)
+			flush();
+		return res;
+	}
+	atomic_fetch_sub(&async_users, 1);
+
+	sl_scratch_mark mark = sl_scratch_allocator_api->push();
+	if (res >= LOG_RECORD_TEXT) {
+		record.long_message = sl_alloc(&mark.allocator, res + 1);
+		sl_vsnprintf(record.long_message, res + 1, format, arg_ptr);
+	}
+	va_end(arg_ptr);
 
-	sl_sprintf(prologue, "[%d-%d-%d] %s:%d [%s] %s%s",  timeinfo->tm_mon + 1, timeinfo->tm_mday, timeinfo->tm_year + 1900, sl_get_file_name(file), line, thread_name, level_strings[level], buffer);
+	write_record(&record);
 
-	log_print(level, prologue);
+	sl_scratch_allocator_api->pop(&mark);
 	return res;
 }
 
@@ -126,6 +1162,13 @@ static struct sl_logger_api logger_api = {
 	.log_printf = log_printf,
 	.register_logger = register_logger,
 	 .unregister_logger = unregister_logger,
+	.enable_async = enable_async,
+	.disable_async = disable_async,
+	.flush = flush,
+	.dropped_count = dropped_count,
+	.format_binary = format_binary,
+	.set_channel_level = set_channel_level,
+	.channel_masks = channel_masks,
 };
 
-struct sl_logger_api* sl_logger_api = &logger_api;
\ No newline at end of file
+struct sl_logger_api* sl_logger_api = &logger_api;
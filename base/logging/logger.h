@@ -30,13 +30,47 @@
 extern "C" {
 #endif
 
+//Plain numbers so SL_LOG_MIN_LEVEL can be compared by the preprocessor
+#define SL_LOG_LEVEL_DEBUG 0
+#define SL_LOG_LEVEL_INFO 1
+#define SL_LOG_LEVEL_ERROR 2
+
+/**
+ * @brief Lowest Level That is Compiled In
+ * Log calls below it are removed along with their arguments. Set it for a whole build,
+ * e.g. -DSL_LOG_MIN_LEVEL=1 (or the SL_LOG_MIN_LEVEL CMake option) strips SL_LOG_DEBUG.
+ */
+#ifndef SL_LOG_MIN_LEVEL
+#define SL_LOG_MIN_LEVEL SL_LOG_LEVEL_DEBUG
+#endif
+
+//Ordered from least to most severe
 enum sl_log_level
 {
-	sl_log_level_info,
+	sl_log_level_debug = SL_LOG_LEVEL_DEBUG,
 
-	sl_log_level_debug,
+	sl_log_level_info = SL_LOG_LEVEL_INFO,
 
-	sl_log_level_error
+	sl_log_level_error = SL_LOG_LEVEL_ERROR
+};
+
+/**
+ * @brief Subsystems Whose Messages Can be Turned Off at Runtime, see set_channel_level
+ */
+enum sl_log_channel
+{
+	//SL_LOG_INFO, SL_LOG_DEBUG and SL_LOG_ERROR
+	sl_log_channel_general,
+
+	sl_log_channel_job,
+
+	sl_log_channel_memory,
+
+	sl_log_channel_plugin,
+
+	sl_log_channel_render,
+
+	sl_log_channel_count
 };
 
 typedef struct sl_logger {
@@ -46,6 +80,41 @@ typedef struct sl_logger {
 
 } sl_logger;
 
+/**
+ * @brief What an Async log_printf Does When the Record Ring is Full
+ */
+enum sl_log_backpressure
+{
+	//The record is thrown away and counted, the writer reports how many were lost
+	sl_log_backpressure_drop,
+
+	//The caller yields until the writer thread made room
+	sl_log_backpressure_block,
+
+	//The record goes to an overflow list that grows as needed, nothing waits and nothing is lost
+	sl_log_backpressure_grow
+};
+
+typedef struct sl_logger_async_desc {
+	//Number of records the ring holds, must be a power of two
+	uint32_t capacity;
+
+	enum sl_log_backpressure backpressure;
+
+	//Capture the format pointer, time, thread and raw arguments into a per thread buffer instead of
+	//formatting on the calling thread. Messages that don't fit the buffer still go through the ring.
+	//sl_log_backpressure_grow waits like sl_log_backpressure_block for the thread buffers
+	bool binary;
+
+	//With binary, file the messages are written to unformatted (see log_binary.h and sl_log_decode).
+	//Errors still go through the loggers. NULL formats every message on the writer thread instead
+	const char *binary_path;
+
+	//With binary, bytes of each thread's buffer, must be a power of two (0 for 64KB)
+	uint32_t thread_buffer_size;
+
+} sl_logger_async_desc;
+
 struct sl_logger_api {
 
 	void (*register_logger)(const sl_logger *logger);
@@ -53,18 +122,87 @@ struct sl_logger_api {
 	void (*unregister_logger)(const sl_logger *logger);
 
 	int (*log_printf)(enum sl_log_level level, const char *file, uint32_t line, const char *format, ...);
+
+	/**
+	 * @brief Moves Logging Off the Calling Threads
+	 * log_printf only formats the message into a record and pushes it into a lock free ring. A background
+	 * thread adds the prologue and calls the registered loggers. Errors are flushed before log_printf returns,
+	 * so they are never lost to a crash right after. Messages logged by a logger itself are printed directly.
+	 * @param desc Ring Size and What to do When it is Full
+	 */
+	void (*enable_async)(const sl_logger_async_desc *desc);
+
+	/**
+	 * @brief Writes Every Pending Record, Stops the Writer Thread and Goes Back to Logging on the Caller
+	 */
+	void (*disable_async)(void);
+
+	/**
+	 * @brief Waits Until Every Record Logged Before the Call Went Through the Loggers, Does Nothing When Not Async
+	 */
+	void (*flush)(void);
+
+	/**
+	 * @brief Number of Records Thrown Away by sl_log_backpressure_drop Since enable_async
+	 */
+	uint64_t (*dropped_count)(void);
+
+	/**
+	 * @brief Turns a Format and the Arguments Captured by Binary Logging Back Into the Message
+	 * @param buffer Buffer for the Message, Can be NULL When size is 0
+	 * @param args Arguments in the Layout Described in log_binary.h
+	 * @returns Length of the Whole Message Even if it Didn't Fit, Like snprintf
+	 */
+	int (*format_binary)(char *buffer, int size, const char *format, const void *args, uint32_t args_size);
+
+	/**
+	 * @brief Lets Through a Level and Everything More Severe on a Channel, Everything is Let Through by Default
+	 * @param level Least Severe Level Logged, Above sl_log_level_error Silences the Channel
+	 */
+	void (*set_channel_level)(enum sl_log_channel channel, enum sl_log_level level);
+
+	/**
+	 * @brief Bit (1 << level) Set for Every Level a Channel Lets Through, Indexed by enum sl_log_channel
+	 * The logging macros test it before the arguments are evaluated. Written by set_channel_level.
+	 */
+	uint32_t *channel_masks;
 };
 
 #define SL_LOGGER_API "sl_logger_api"
 
-#define SL_LOG_INFO(format, ...) sl_logger_api->log_printf(sl_log_level_info, __FILE__, __LINE__, "" format "", ##__VA_ARGS__)
+#define SL_LOG_ENABLED(channel, level) (sl_logger_api->channel_masks[channel] & (1u << (level)))
 
-#define SL_LOG_DEBUG(format, ...) sl_logger_api->log_printf(sl_log_level_debug, __FILE__, __LINE__, "" format "", ##__VA_ARGS__)
+//Arguments are only evaluated when the channel lets the level through
+#define SL_LOG_CALL(channel, prefix, level, format, ...) \
+	((void)(SL_LOG_ENABLED(channel, level) && sl_logger_api->log_printf(level, __FILE__, __LINE__, "" prefix format "", ##__VA_ARGS__)))
 
-#define SL_LOG_ERROR(format, ...) sl_logger_api->log_printf(sl_log_level_error, __FILE__, __LINE__, "" format "", ##__VA_ARGS__)
+//SL_LOG_*_CHANNEL(job, "...") logs on sl_log_channel_job, prefixed with [job]
+#if SL_LOG_MIN_LEVEL <= SL_LOG_LEVEL_DEBUG
+#define SL_LOG_DEBUG(format, ...) SL_LOG_CALL(sl_log_channel_general, "", sl_log_level_debug, format, ##__VA_ARGS__)
+#define SL_LOG_DEBUG_CHANNEL(channel, format, ...) SL_LOG_CALL(sl_log_channel_##channel, "[" #channel "] ", sl_log_level_debug, format, ##__VA_ARGS__)
+#else
+#define SL_LOG_DEBUG(format, ...) ((void)0)
+#define SL_LOG_DEBUG_CHANNEL(channel, format, ...) ((void)0)
+#endif
+
+#if SL_LOG_MIN_LEVEL <= SL_LOG_LEVEL_INFO
+#define SL_LOG_INFO(format, ...) SL_LOG_CALL(sl_log_channel_general, "", sl_log_level_info, format, ##__VA_ARGS__)
+#define SL_LOG_INFO_CHANNEL(channel, format, ...) SL_LOG_CALL(sl_log_channel_##channel, "[" #channel "] ", sl_log_level_info, format, ##__VA_ARGS__)
+#else
+#define SL_LOG_INFO(format, ...) ((void)0)
+#define SL_LOG_INFO_CHANNEL(channel, format, ...) ((void)0)
+#endif
+
+#if SL_LOG_MIN_LEVEL <= SL_LOG_LEVEL_ERROR
+#define SL_LOG_ERROR(format, ...) SL_LOG_CALL(sl_log_channel_general, "", sl_log_level_error, format, ##__VA_ARGS__)
+#define SL_LOG_ERROR_CHANNEL(channel, format, ...) SL_LOG_CALL(sl_log_channel_##channel, "[" #channel "] ", sl_log_level_error, format, ##__VA_ARGS__)
+#else
+#define SL_LOG_ERROR(format, ...) ((void)0)
+#define SL_LOG_ERROR_CHANNEL(channel, format, ...) ((void)0)
+#endif
 
 #ifdef NOT_IMPLEMENTED_LOG
-#define SL_NOT_IMPLEMENTED() sl_logger_api->log_printf(sl_log_level_debug, __FILE__, __LINE__, "%s IS NOT IMPLEMENTED!\n", SL_FUNCTION)
+#define SL_NOT_IMPLEMENTED() SL_LOG_DEBUG("%s IS NOT IMPLEMENTED!\n", SL_FUNCTION)
 #else
 #define SL_NOT_IMPLEMENTED()
 #endif
@@ -0,0 +1,94 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_ALLOC_STREAM_H
+#define STARLIGHT_ALLOC_STREAM_H
+
+#include "defines.h"
+
+/*
+ * Wire format of sl_memory_tracker_api->begin_stream, the same for files and sockets:
+ *
+ *   sl_alloc_stream_header
+ *   records...
+ *
+ * Every record starts with an sl_alloc_stream_record and is padded to a multiple of 8 bytes,
+ * so readers can skip records they don't know. Sites and contexts are sent once, before the
+ * first event that refers to them. A context is sent again if its id gets reused.
+ */
+
+#define SL_ALLOC_STREAM_MAGIC 0x53414c53u //"SLAS"
+#define SL_ALLOC_STREAM_VERSION 1
+
+typedef struct sl_alloc_stream_header {
+    uint32_t magic;
+    uint32_t version;
+    //sl_os_info_api->nanoseconds when the stream began, event times are relative to it
+    uint64_t start_time;
+} sl_alloc_stream_header;
+
+typedef enum sl_alloc_stream_record_type {
+    sl_alloc_stream_event = 1,
+    sl_alloc_stream_site = 2,
+    sl_alloc_stream_context = 3,
+} sl_alloc_stream_record_type;
+
+typedef struct sl_alloc_stream_record {
+    uint32_t type;
+    //Size of the whole record including this header and padding
+    uint32_t size;
+} sl_alloc_stream_record;
+
+//An alloc (old_size 0), free (new_size 0) or realloc
+typedef struct sl_alloc_stream_event_record {
+    sl_alloc_stream_record record;
+    uint64_t time;
+    uint64_t old_ptr;
+    uint64_t new_ptr;
+    uint64_t old_size;
+    uint64_t new_size;
+    uint32_t site;
+    uint32_t context;
+    uint32_t thread;
+    uint32_t padding;
+} sl_alloc_stream_event_record;
+
+//Followed by func_length + file_length characters (not NUL terminated)
+typedef struct sl_alloc_stream_site_record {
+    sl_alloc_stream_record record;
+    uint32_t id;
+    uint32_t line;
+    uint32_t func_length;
+    uint32_t file_length;
+} sl_alloc_stream_site_record;
+
+//Followed by name_length characters (not NUL terminated)
+typedef struct sl_alloc_stream_context_record {
+    sl_alloc_stream_record record;
+    uint32_t id;
+    uint32_t parent;
+    uint32_t name_length;
+    uint32_t padding;
+} sl_alloc_stream_context_record;
+
+#endif //STARLIGHT_ALLOC_STREAM_H
@@ -25,7 +25,11 @@
 #include "base/thread/atomics.inl"
 #include "mem_tracker.h"
 
+#include "os/os.h"
+#include "util/assertions.inl"
+
 extern struct sl_memory_tracker_api* sl_memory_tracker_api; //mem_tracker.c
+extern struct sl_os_api* sl_os_api; //os_macos.c
 
 #include <stdlib.h>
 
@@ -94,6 +98,229 @@ void* system_realloc(struct sl_allocator *a, void *ptr, size_t new_size, uint32_
 
 }
 
+#pragma region Virtual Array
+
+typedef struct virtual_array {
+    sl_allocator parent;
+    uint8_t* base;
+    uint64_t reserved;
+    uint64_t committed;
+    uint64_t size;
+} virtual_array;
+
+static void* virtual_array_realloc(struct sl_allocator *a, void *ptr, size_t new_size, uint32_t align, const char* func,
+                                   const char *file, uint32_t line)
+{
+    virtual_array* va = a->inst;
+    sl_os_virtual_memory_api* vm = sl_os_api->virtual_memory;
+    const uint64_t page = vm->page_size();
+
+    //The region only ever hands out a single block that starts at the (page aligned) base,
+    //so growing never has to move or copy anything and pointers into it stay valid.
+    SL_ASSERT(ptr == NULL || ptr == va->base, "Pointer was not allocated from this virtual array!");
+    SL_ASSERT(ptr != NULL || va->size == 0 || new_size == 0, "Virtual array only supports a single live allocation!");
+    SL_ASSERT(align <= page, "Virtual array cannot satisfy an alignment larger than a page!");
+
+    if (new_size > va->reserved)
+        return NULL;
+
+    const uint64_t needed = (new_size + page - 1) & ~(page - 1);
+    if (needed > va->committed) {
+        if (!vm->commit(va->base + va->committed, needed - va->committed))
+            return NULL;
+    } else if (needed < va->committed) {
+        vm->decommit(va->base + needed, va->committed - needed);
+    }
+    va->committed = needed;
+
+    if (va->size) {
+        atomic_fetch_add(&stats.total_allocation_count, -1);
+        atomic_fetch_add(&stats.total_amount_allocated, -va->size);
+    }
+    if (new_size) {
+        atomic_fetch_add(&stats.total_allocation_count, 1);
+        atomic_fetch_add(&stats.total_amount_allocated, new_size);
+    }
+    sl_memory_tracker_api->record(va->size ? va->base : 0, va->size, new_size ? va->base : 0, new_size, func, file, line,
+                                  a->context);
+    va->size = new_size;
+
+    return new_size ? va->base : NULL;
+}
+
+static sl_allocator create_virtual_array(const sl_allocator *parent, const char *name, uint64_t reserve_size)
+{
+    sl_allocator a = {0};
+    void* base = sl_os_api->virtual_memory->reserve(reserve_size);
+    if (base == NULL)
+        return a;
+
+    virtual_array* va = sl_alloc((sl_allocator*)parent, sizeof(virtual_array));
+    *va = (virtual_array) {
+        .parent = *parent,
+        .base = base,
+        .reserved = reserve_size,
+    };
+
+    a.inst = va;
+    a.context = sl_memory_tracker_api->create_context(name, parent->context);
+    a.realloc = virtual_array_realloc;
+    return a;
+}
+
+static void destroy_virtual_array(const sl_allocator *child)
+{
+    virtual_array* va = child->inst;
+    if (va->size) {
+        atomic_fetch_add(&stats.total_allocation_count, -1);
+        atomic_fetch_add(&stats.total_amount_allocated, -va->size);
+        sl_memory_tracker_api->record(va->base, va->size, 0, 0, SL_FUNCTION, __FILE__, __LINE__, child->context);
+    }
+    sl_os_api->virtual_memory->release(va->base, va->reserved);
+    sl_allocator parent = va->parent;
+    sl_free(&parent, va);
+}
+
+#pragma endregion
+
+#pragma region Huge Pages
+
+typedef struct huge_page_child {
+    //Parent allocator with the child's tracker context, used below the threshold
+    sl_allocator small;
+    uint64_t threshold;
+    uint32_t parent_context;
+} huge_page_child;
+
+//Sits right before every pointer handed out by a huge page child
+typedef struct huge_page_header {
+    uint64_t size;
+    uint32_t offset;
+    uint32_t huge;
+} huge_page_header;
+
+static uint64_t huge_page_mapped_size(const huge_page_header* h)
+{
+    const uint64_t huge_size = sl_os_api->virtual_memory->huge_page_size();
+    return (h->size + h->offset + huge_size - 1) & ~(huge_size - 1);
+}
+
+static void* huge_page_malloc(struct sl_allocator *a, size_t new_size, uint32_t align, const char* func,
+                              const char *file, uint32_t line)
+{
+    huge_page_child* hp = a->inst;
+    const uint32_t offset = align > sizeof(huge_page_header) ? align : sizeof(huge_page_header);
+    uint8_t* block;
+    bool huge = new_size >= hp->threshold;
+
+    if (huge) {
+        bool explicit_huge;
+        block = sl_os_api->virtual_memory->map_huge_pages(new_size + offset, &explicit_huge);
+        if (block == NULL) {
+            huge = false;
+            atomic_fetch_add(&stats.huge_page_unavailable_count, 1);
+        } else {
+            huge_page_header h = {.size = new_size, .offset = offset};
+            atomic_fetch_add(&stats.huge_page_allocation_count, 1);
+            atomic_fetch_add(&stats.huge_page_bytes_mapped, huge_page_mapped_size(&h));
+            if (!explicit_huge)
+                atomic_fetch_add(&stats.huge_page_fallback_count, 1);
+            atomic_fetch_add(&stats.total_allocation_count, 1);
+            atomic_fetch_add(&stats.total_amount_allocated, new_size);
+            sl_memory_tracker_api->record(0, 0, block, new_size, func, file, line, a->context);
+        }
+    }
+
+    if (!huge) {
+        block = hp->small.realloc(&hp->small, 0, new_size + offset, align, func, file, line);
+        if (block == NULL)
+            return NULL;
+    }
+
+    uint8_t* p = block + offset;
+    huge_page_header* h = (huge_page_header*)p - 1;
+    h->size = new_size;
+    h->offset = offset;
+    h->huge = huge;
+    return p;
+}
+
+static void huge_page_free(struct sl_allocator *a, void *ptr, const char* func, const char *file, uint32_t line)
+{
+    huge_page_child* hp = a->inst;
+    huge_page_header* h = (huge_page_header*)ptr - 1;
+    uint8_t* block = (uint8_t*)ptr - h->offset;
+
+    if (h->huge) {
+        const uint64_t mapped = huge_page_mapped_size(h);
+        atomic_fetch_add(&stats.huge_page_allocation_count, -1);
+        atomic_fetch_add(&stats.huge_page_bytes_mapped, -mapped);
+        atomic_fetch_add(&stats.total_allocation_count, -1);
+        atomic_fetch_add(&stats.total_amount_allocated, -h->size);
+        sl_memory_tracker_api->record(block, h->size, 0, 0, func, file, line, a->context);
+        sl_os_api->virtual_memory->release(block, mapped);
+    } else {
+        hp->small.realloc(&hp->small, block, 0, 0, func, file, line);
+    }
+}
+
+static void* huge_page_realloc(struct sl_allocator *a, void *ptr, size_t new_size, uint32_t align, const char* func,
+                               const char *file, uint32_t line)
+{
+    if (ptr == NULL)
+        return huge_page_malloc(a, new_size, align, func, file, line);
+
+    if (new_size == 0) {
+        huge_page_free(a, ptr, func, file, line);
+        return NULL;
+    }
+
+    huge_page_header* h = (huge_page_header*)ptr - 1;
+    if (new_size <= h->size)
+        return ptr;
+
+    //A huge mapping is rounded up to whole pages, so small growth may still fit
+    if (h->huge && new_size + h->offset <= huge_page_mapped_size(h)) {
+        atomic_fetch_add(&stats.total_amount_allocated, new_size - h->size);
+        sl_memory_tracker_api->record((uint8_t*)ptr - h->offset, h->size, (uint8_t*)ptr - h->offset, new_size, func, file,
+                                      line, a->context);
+        h->size = new_size;
+        return ptr;
+    }
+
+    void* q = huge_page_malloc(a, new_size, align, func, file, line);
+    if (q) {
+        sl_memcpy(q, ptr, h->size);
+        huge_page_free(a, ptr, func, file, line);
+    }
+    return q;
+}
+
+static sl_allocator create_huge_page_child(const sl_allocator *parent, const char *name, uint64_t threshold)
+{
+    sl_allocator a = {0};
+    a.context = sl_memory_tracker_api->create_context(name, parent->context);
+    a.realloc = huge_page_realloc;
+
+    huge_page_child* hp = sl_alloc((sl_allocator*)parent, sizeof(huge_page_child));
+    hp->small = *parent;
+    hp->small.context = a.context;
+    hp->threshold = threshold;
+    hp->parent_context = parent->context;
+    a.inst = hp;
+    return a;
+}
+
+static void destroy_huge_page_child(const sl_allocator *child)
+{
+    huge_page_child* hp = child->inst;
+    sl_allocator parent = hp->small;
+    parent.context = hp->parent_context;
+    sl_free(&parent, hp);
+}
+
+#pragma endregion
+
 static sl_allocator create_child(const sl_allocator *parent, const char *name)
 {
 	sl_allocator a = *parent;
@@ -103,6 +330,10 @@ static sl_allocator create_child(const sl_allocator *parent, const char *name)
 
 static void destroy_child(const sl_allocator *child)
 {
+	if (child->realloc == virtual_array_realloc)
+		destroy_virtual_array(child);
+	else if (child->realloc == huge_page_realloc)
+		destroy_huge_page_child(child);
 	sl_memory_tracker_api->destroy_context(child->context);
 }
 
@@ -115,6 +346,8 @@ struct sl_allocator_api alloc_api = {
     .stats = &stats,
 	.create_child = create_child,
 	.destroy_child = destroy_child,
+	.create_virtual_array = create_virtual_array,
+	.create_huge_page_child = create_huge_page_child,
 };
 
 struct sl_allocator_api* sl_allocator_api = &alloc_api;
\ No newline at end of file
@@ -46,6 +46,18 @@ typedef struct sl_allocator
 
         SL_ATOMIC uint64_t total_amount_allocated;
 
+        //Live allocations served from huge page mappings
+        SL_ATOMIC uint32_t huge_page_allocation_count;
+
+        //Bytes currently mapped for huge page allocations (multiple of the huge page size)
+        SL_ATOMIC uint64_t huge_page_bytes_mapped;
+
+        //Huge page allocations that fell back to transparent huge page advice
+        SL_ATOMIC uint32_t huge_page_fallback_count;
+
+        //Allocations above a huge page threshold the OS had no huge pages for, served from normal pages
+        SL_ATOMIC uint32_t huge_page_unavailable_count;
+
     }sl_allocator_statistics;
 
 struct sl_allocator_api
@@ -58,6 +70,30 @@ struct sl_allocator_api
 
 	void (*destroy_child)(const sl_allocator *child);
 
+/**
+ * @brief Creates a Child Allocator Backed by a Reserved Range of Virtual Memory
+ * Pages are committed as the single block it hands out grows and decommitted when it shrinks,
+ * so a sl_array using it never copies on grow and pointers into it stay stable.
+ * Must be destroyed with destroy_child.
+ * @param parent Allocator used for the bookkeeping and as the parent tracker context
+ * @param name Name of the tracker context
+ * @param reserve_size Maximum Size in Bytes the block can ever grow to
+ * @returns The Virtual Array Allocator (realloc is NULL if the range could not be reserved)
+ */
+	sl_allocator (*create_virtual_array)(const sl_allocator *parent, const char *name, uint64_t reserve_size);
+
+/**
+ * @brief Creates a Child Allocator that Serves Large Allocations From Huge Pages
+ * Allocations of at least threshold bytes get their own 2MB page mapping, everything smaller
+ * goes to the parent. Meant for large long-lived buffers. Must be destroyed with destroy_child.
+ * When the OS has no huge pages large allocations go to the parent too, see huge_page_unavailable_count.
+ * @param parent Allocator used for small allocations and as the parent tracker context
+ * @param name Name of the tracker context
+ * @param threshold Minimum Size in Bytes Served From Huge Pages
+ * @returns The Huge Page Allocator
+ */
+	sl_allocator (*create_huge_page_child)(const sl_allocator *parent, const char *name, uint64_t threshold);
+
 };
 
 #define sl_alloc(a, size) (a)->realloc(a, 0, size, 0, SL_FUNCTION, __FILE__, __LINE__)
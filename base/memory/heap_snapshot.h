@@ -0,0 +1,93 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_HEAP_SNAPSHOT_H
+#define STARLIGHT_HEAP_SNAPSHOT_H
+
+#include "defines.h"
+
+/*
+ * On disk layout of sl_memory_tracker_api->write_snapshot:
+ *
+ *   sl_heap_snapshot_header
+ *   sl_heap_snapshot_context[num_contexts]   (index is the context id)
+ *   sl_heap_snapshot_trace[num_traces]       (index 0 is unused)
+ *   sl_heap_snapshot_stack[num_stacks]       (index is the stack id, 0 is unused)
+ *   sl_heap_snapshot_frame[num_frames]       (referenced by the stacks, innermost first)
+ *   sl_heap_snapshot_live[num_live]
+ *   char strings[strings_size]               (NUL terminated, referenced by offset)
+ *
+ * Frames are symbolised when the snapshot is written, so it can be read on any machine.
+ */
+
+#define SL_HEAP_SNAPSHOT_MAGIC 0x53484c53u //"SLHS"
+#define SL_HEAP_SNAPSHOT_VERSION 1
+
+typedef struct sl_heap_snapshot_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t timestamp;
+    uint32_t num_contexts;
+    uint32_t num_traces;
+    uint32_t num_stacks;
+    uint32_t num_frames;
+    uint32_t num_live;
+    uint32_t strings_size;
+} sl_heap_snapshot_header;
+
+typedef struct sl_heap_snapshot_context {
+    uint32_t name;
+    uint32_t parent;
+    uint64_t amount_allocated;
+    uint32_t allocation_count;
+    uint32_t num_children;
+} sl_heap_snapshot_context;
+
+typedef struct sl_heap_snapshot_trace {
+    uint32_t func;
+    uint32_t file;
+    uint32_t line;
+    uint32_t context;
+    uint32_t stack_id;
+    uint32_t padding;
+    uint64_t amount_allocated;
+} sl_heap_snapshot_trace;
+
+typedef struct sl_heap_snapshot_stack {
+    uint32_t offset;
+    uint32_t depth;
+} sl_heap_snapshot_stack;
+
+typedef struct sl_heap_snapshot_frame {
+    uint64_t address;
+    uint32_t symbol;
+    uint32_t padding;
+} sl_heap_snapshot_frame;
+
+typedef struct sl_heap_snapshot_live {
+    uint64_t ptr;
+    uint32_t trace;
+    uint32_t padding;
+} sl_heap_snapshot_live;
+
+#endif //STARLIGHT_HEAP_SNAPSHOT_H
@@ -22,15 +22,26 @@
 //
 
 #include "mem_tracker.h"
+#include "heap_snapshot.h"
+#include "alloc_stream.h"
 #include "allocator.h"
 #include "data_structures/array.inl"
 #include "data_structures/hash.inl"
+#include "data_structures/mpmc_queue.h"
+#include "data_structures/swiss_map.inl"
+#include "data_structures/flat_map.inl"
+#include "data_structures/segmented_array.inl"
 #include "logging/logger.h"
 #include "thread/atomics.inl"
 #include "thread/mutex.inl"
+#include "thread/spinlock.inl"
+#include "os/os.h"
 #include "util/assertions.inl"
 #include "util/path_util.inl"
 #include "util/sprintf.h"
+#include "util/string_intern.h"
+
+#include <math.h>
 
 /*DISCLAIMER: MEMORY TRACKER BASED OFF OF
 https://github.com/nothings/stb/blob/master/stb_leakcheck.h
@@ -41,19 +52,167 @@ http://bitsquid.blogspot.com/2010/09/custom-memory-allocation-in-c.html ProxyAll
 https://github.com/memtt/malt
 */
 
-#define MAX_CONTEXTS 512
+//Contexts the table can grow to. Only address space is reserved up front, so the table never
+//moves and record() can keep reading it without a lock
+#define CONTEXT_RESERVE (1u << 20)
+
+//Events per thread buffer, must be a power of two
+#define EVENT_BUFFER_SIZE 2048
+
+//How long the aggregator sleeps when it found nothing to do
+#define AGGREGATOR_SLEEP 0.001
+
+//Deepest call stack kept per trace
+#define MAX_STACK_DEPTH 32
+
+//Per thread cache of recently interned stacks, must be a power of two
+#define STACK_CACHE_SIZE 256
+
+//Slots in the set of live sampled pointers, must be a power of two
+#define SAMPLED_SET_SIZE (1 << 16)
+
+//Events the stream ring holds before record() has to wait for the aggregator, must be a power of two
+#define STREAM_RING_SIZE (1 << 16)
+
+//Encoded bytes gathered before they're written out
+#define STREAM_FLUSH_SIZE SL_KILOBYTES(64)
+
+//Part of a stream file that is mapped at a time
+#define STREAM_WINDOW_SIZE SL_MEGABYTES(4)
+
+typedef struct trace_key
+{
+    const char* file;
+    uint32_t line;
+    uint32_t context;
+    uint32_t stack_id;
+    //Hashed as bytes, so the padding is spelled out and zeroed
+    uint32_t pad;
+}trace_key;
+
+typedef struct stack_entry
+{
+    uint32_t offset;
+    uint32_t depth;
+}stack_entry;
+
+typedef struct stack_cache_entry
+{
+    uint64_t hash;
+    uint32_t id;
+}stack_cache_entry;
 
-typedef struct trace_map
+//Hash or address -> index, for traces, stacks, stream sites and snapshot strings
+MAKE_FLAT_MAP_TYPE(index, uint64_t, uint32_t)
+
+//Traces never move, so growing the table doesn't copy it or stall record
+MAKE_SEGMENTED_ARRAY_TYPE(trace, struct sl_memory_tracker_trace, 10)
+
+//Live pointer -> trace index, looked up by every traced free
+MAKE_SWISS_MAP_TYPE(ptr, void*, uint32_t, sl_swiss_hash_ptr, sl_swiss_equal)
+
+/*
+ * record() never takes a lock when tracing. Each thread appends its events to its own
+ * single producer/single consumer ring, and the aggregator (a background thread, or any
+ * thread that needs an up to date view) drains all rings into the trace tables while
+ * holding tracker_mutex.
+ */
+typedef struct record_event
 {
-    uint64_t key;
-    uint32_t value;
-}trace_map;
+    void* old_ptr;
+    void* new_ptr;
+    uint64_t old_size;
+    uint64_t new_size;
+    const char* func;
+    const char* file;
+    uint32_t line;
+    uint32_t context;
+    uint32_t stack_id;
+}record_event;
 
-typedef struct ptr_map
+typedef struct event_buffer
 {
-    void* key;
-    uint32_t value;
-}ptr_map;
+    sl_atomic_uint64_t head;
+    uint8_t pad0[64 - sizeof(sl_atomic_uint64_t)];
+    sl_atomic_uint64_t tail;
+    uint8_t pad1[64 - sizeof(sl_atomic_uint64_t)];
+
+    //Head seen at the start of the current drain
+    uint64_t drain_head;
+    struct event_buffer* next;
+
+    //Cleared when the owning thread exits, so a new thread can take the buffer over
+    sl_atomic_bool owned;
+
+    record_event events[EVENT_BUFFER_SIZE];
+}event_buffer;
+
+//A free that showed up before the allocation it belongs to was aggregated
+typedef struct deferred_free
+{
+    void* ptr;
+    uint64_t size;
+    uint32_t context;
+    //Drain the free was seen in
+    uint64_t drain;
+}deferred_free;
+
+/*
+ * Live sampled pointers and the weight they were recorded with. Only sampled allocations
+ * and their frees write (under the spinlock), every other free just probes it. Deletion
+ * shifts entries back instead of leaving tombstones, so readers retry if a write was
+ * in flight while they probed.
+ */
+typedef struct sampled_set
+{
+    sl_spinlock lock;
+    sl_atomic_uint64_t sequence;
+    sl_atomic_uint32_t count;
+    sl_atomic_uint64_t keys[SAMPLED_SET_SIZE];
+    uint64_t weights[SAMPLED_SET_SIZE];
+}sampled_set;
+
+//A record() call waiting in the stream ring
+typedef struct stream_event
+{
+    uint64_t time;
+    void* old_ptr;
+    void* new_ptr;
+    uint64_t old_size;
+    uint64_t new_size;
+    const char* func;
+    const char* file;
+    uint32_t line;
+    uint32_t context;
+    uint32_t thread;
+}stream_event;
+
+MAKE_MPMC_QUEUE_TYPE(stream, stream_event)
+
+/*
+ * Any thread pushes into the ring, only the aggregator pops. It turns the events into
+ * alloc_stream.h records and writes them either through a mapped window of the file or
+ * to the socket.
+ */
+typedef struct stream_state
+{
+    mpmc_queue_stream_c queue;
+    mpmc_queue_stream_cell cells[STREAM_RING_SIZE];
+
+    sl_os_file file;
+    uint64_t start_time;
+    bool failed;
+
+    uint8_t* window;
+    uint64_t window_offset;
+    uint64_t window_used;
+
+    SL_ARRAY(uint8_t, buffer);
+    sl_flat_map_index site_map;
+    uint32_t num_sites;
+    //Name each context was last sent with
+    SL_ARRAY(const char*, context_names);
+}stream_state;
 
 typedef struct internal_memory_tracker
 {
@@ -62,14 +221,48 @@ typedef struct internal_memory_tracker
 
     sl_os_mutex tracker_mutex;
 
-    //TODO: should this be bigger?
-    sl_memory_tracker_context contexts[MAX_CONTEXTS];
+    sl_memory_tracker_context* contexts;
+    uint64_t committed_context_bytes;
 
     SL_ARRAY(uint32_t, context_list);
-    SL_ARRAY(struct sl_memory_tracker_trace, traces);
+    sl_segmented_array_trace traces;
+
+    sl_swiss_map_ptr ptr_map;
+    sl_flat_map_index trace_map;
+
+    //Traces of pointers that got reused before their free was aggregated
+    sl_swiss_map_ptr displaced_map;
+    SL_ARRAY(deferred_free, deferred_frees);
+    uint64_t drain_count;
+
+    //Every thread buffer ever registered, pushed lock free (event_buffer*)
+    sl_atomic_uint64_t buffers;
+    sl_atomic_bool aggregator_running;
+    sl_os_thread aggregator;
+
+    //Set by sl_shutdown_memory_tracker, record() only counts bytes after it
+    sl_atomic_bool shut_down;
+
+    //Interned call stacks. Identical stacks share an id, 0 means no stack
+    sl_atomic_bool capture_stacks;
+    sl_os_mutex stack_mutex;
+    SL_ARRAY(stack_entry, stacks);
+    SL_ARRAY(uint64_t, stack_frames);
+    sl_flat_map_index stack_map;
+
+    //Mean bytes between samples, 0 traces every allocation
+    sl_atomic_uint64_t sample_interval;
+    sampled_set* sampled;
 
-    ptr_map* ptr_map;
-    trace_map* trace_map;
+    sl_atomic_bool capturing;
+    sl_os_mutex capture_mutex;
+    SL_ARRAY(sl_memory_tracker_event, capture);
+
+    //Threads inside stream_record, end_stream waits for them to leave
+    sl_atomic_bool streaming;
+    sl_atomic_uint32_t stream_users;
+    sl_os_mutex stream_mutex;
+    stream_state* stream;
 
 }internal_memory_tracker;
 
@@ -78,18 +271,56 @@ static internal_memory_tracker* internal_tracker;
 extern struct sl_allocator_api* sl_allocator_api; //allocator.c
 extern struct sl_sprintf_api* sl_sprintf_api; //sprintf.c
 extern struct sl_logger_api* sl_logger_api; //logger.c
+extern struct sl_os_api* sl_os_api; //os_macos.c
+extern struct sl_string_intern_api* sl_string_intern_api; //string_intern.c
+
+static SL_THREAD_LOCAL event_buffer* thread_buffer;
+static SL_THREAD_LOCAL sl_os_thread_exit thread_exit;
+static SL_THREAD_LOCAL stack_cache_entry stack_cache[STACK_CACHE_SIZE];
+
+//Bytes left until this thread takes its next sample
+static SL_THREAD_LOCAL int64_t bytes_until_sample;
+static SL_THREAD_LOCAL uint64_t sample_rng;
 
+static void flush(void);
+static void drain_stream(void);
 
+static uint32_t stack_frames(uint32_t stack_id, uint64_t *frames, uint32_t max_frames)
+{
+    uint32_t n = 0;
+    SL_MUTEX_LOCK(internal_tracker->stack_mutex) {
+        if (stack_id && stack_id < (uint32_t)sl_array_size(internal_tracker->stacks)) {
+            const stack_entry *s = internal_tracker->stacks + stack_id;
+            n = s->depth < max_frames ? s->depth : max_frames;
+            sl_memcpy(frames, internal_tracker->stack_frames + s->offset, n * sizeof(uint64_t));
+        }
+    }
+    return n;
+}
+
+//Symbols are only looked up here, capturing a stack just stores return addresses
+static void print_stack(uint32_t stack_id)
+{
+    uint64_t frames[MAX_STACK_DEPTH];
+    const uint32_t n = stack_frames(stack_id, frames, MAX_STACK_DEPTH);
+    for (uint32_t i = 0; i < n; ++i) {
+        char symbol[256];
+        sl_os_api->debug->symbolize(frames[i], symbol, sizeof(symbol));
+        SL_LOG_INFO_CHANNEL(memory, "    #%u %s\n", i, symbol);
+    }
+}
 
 static void print_traces(uint32_t context)
 {
+	flush();
 	SL_MUTEX_LOCK(internal_tracker->tracker_mutex) {
-		for (uint32_t i = 1; i < (uint32_t)sl_array_size(internal_tracker->traces); i++) {
-			const struct sl_memory_tracker_trace *t = internal_tracker->traces + i;
+		for (uint32_t i = 1; i < (uint32_t)internal_tracker->traces.size; i++) {
+			const struct sl_memory_tracker_trace *t = sl_segmented_array_trace_at(&internal_tracker->traces, i);
 			if (t->context == context && t->amount_allocated) {
-				const struct sl_memory_tracker_trace cur_trace = internal_tracker->traces[i];
+				const struct sl_memory_tracker_trace cur_trace = *t;
 				sl_unlock_mutex(&internal_tracker->tracker_mutex);
-				SL_LOG_INFO("Leaked %llu bytes. File %s:%i in function |%s|\n", cur_trace.amount_allocated,  sl_get_file_name(cur_trace.file),  cur_trace.line, cur_trace.func);
+				SL_LOG_INFO_CHANNEL(memory, "Leaked %llu bytes. File %s:%i in function |%s|\n", cur_trace.amount_allocated,  sl_get_file_name(cur_trace.file),  cur_trace.line, cur_trace.func);
+				print_stack(cur_trace.stack_id);
 				sl_lock_mutex(&internal_tracker->tracker_mutex);
 			}
 		}
@@ -97,6 +328,7 @@ static void print_traces(uint32_t context)
 }
 
 static uint32_t create_context(const char *name, uint32_t parent);
+static void aggregator_entry(void* data);
 static void record(void *old_ptr, size_t old_size, void *new_ptr, size_t new_size,
 				   const char* func, const char *file, uint32_t line, uint32_t context);
 static void set_context_tracking(uint32_t context, bool enabled);
@@ -111,6 +343,11 @@ void sl_init_memory_tracker(void)
             .allocator = allocator
     };
     sl_create_mutex(&internal_tracker->tracker_mutex);
+    sl_create_mutex(&internal_tracker->capture_mutex);
+    sl_create_mutex(&internal_tracker->stack_mutex);
+    sl_create_mutex(&internal_tracker->stream_mutex);
+
+    internal_tracker->contexts = sl_os_api->virtual_memory->reserve(CONTEXT_RESERVE * sizeof(sl_memory_tracker_context));
 
     create_context("root", 0);
     const uint32_t mem_tracker_context = create_context("memory_tracker", SL_MEMORY_CONTEXT_NONE);
@@ -119,17 +356,41 @@ void sl_init_memory_tracker(void)
     set_context_tracking(mem_tracker_context, false);
     internal_tracker->allocator.context = mem_tracker_context;
 
-    sl_array_push(&internal_tracker->allocator, internal_tracker->traces, (struct sl_memory_tracker_trace){ 0 });
+    sl_segmented_array_trace_push(&internal_tracker->allocator, &internal_tracker->traces, (struct sl_memory_tracker_trace){ 0 });
+    sl_array_push(&internal_tracker->allocator, internal_tracker->stacks, (stack_entry){ 0 });
 
     record(0, 0, internal_tracker, sizeof(internal_memory_tracker), SL_FUNCTION, __FILE__, __LINE__, mem_tracker_context);
+
+    atomic_store_explicit(&internal_tracker->aggregator_running, true, memory_order_relaxed);
+    internal_tracker->aggregator = sl_os_api->thread->create_os_thread(aggregator_entry, NULL, SL_KILOBYTES(64), "Memory Tracker");
+}
+
+//Caller must hold tracker_mutex
+static bool commit_contexts(uint32_t count)
+{
+    const uint64_t bytes = (uint64_t)count * sizeof(sl_memory_tracker_context);
+    if (count > CONTEXT_RESERVE || !internal_tracker->contexts)
+        return false;
+
+    if (bytes > internal_tracker->committed_context_bytes) {
+        const uint64_t page_size = sl_os_api->virtual_memory->page_size();
+        const uint64_t grow = (bytes - internal_tracker->committed_context_bytes + page_size - 1) & ~(page_size - 1);
+        if (!sl_os_api->virtual_memory->commit((uint8_t*)internal_tracker->contexts + internal_tracker->committed_context_bytes, grow))
+            return false;
+        internal_tracker->committed_context_bytes += grow;
+    }
+    return true;
 }
 
 static uint32_t create_context(const char *name, uint32_t parent)
 {
+    //Callers can pass a temporary name, and equal names share one pointer
+    name = sl_string_intern_api->intern_string(name);
+
     struct sl_memory_tracker_context *context;
     SL_MUTEX_LOCK(internal_tracker->tracker_mutex) {
         context = sl_array_size(internal_tracker->context_list) ? internal_tracker->contexts + sl_array_pop(internal_tracker->context_list) :
-                              internal_tracker->num_contexts < MAX_CONTEXTS ? internal_tracker->contexts + internal_tracker->num_contexts++ : 0;
+                              commit_contexts(internal_tracker->num_contexts + 1) ? internal_tracker->contexts + internal_tracker->num_contexts++ : 0;
         if (context > internal_tracker->contexts && parent != SL_MEMORY_CONTEXT_NONE)
             internal_tracker->contexts[parent].num_children += 1;
     }
@@ -159,8 +420,9 @@ static void destroy_context(uint32_t context)
         }
         if (c->num_children) {
             //TODO: ASSERT AND CALL ERROR THAT THE SCOPE HAS UNCLOSED SUB SCOPES
-            for (const sl_memory_tracker_context *p_context = internal_tracker->contexts; p_context != sl_array_end(internal_tracker->contexts); ++p_context) {
-                if (p_context && p_context->parent_context == context) {
+            for (uint32_t i = 0; i < internal_tracker->num_contexts; ++i) {
+                const sl_memory_tracker_context *p_context = internal_tracker->contexts + i;
+                if (i != context && p_context->name && p_context->parent_context == context) {
                     //TODO: ERROR FOUND UNCLOSED SUBSCOPE!
                 }
             }
@@ -178,68 +440,680 @@ static void destroy_context(uint32_t context)
 
 }
 
-static void mem_trace(void *ptr, size_t size, const char* func, const char *file, uint32_t line, uint32_t context)
+static void mem_trace(void *ptr, size_t size, const char* func, const char *file, uint32_t line, uint32_t context, uint32_t stack_id)
+{
+    const trace_key k = {.file = file, .line = line, .context = context, .stack_id = stack_id, .pad = 0};
+    const uint64_t key = sl_hash_bytes((void*)&k, sizeof(k), 0);
+
+    const uint32_t *found = sl_flat_map_index_get(&internal_tracker->trace_map, key);
+    uint32_t cur_trace = found ? *found : 0;
+    if (!cur_trace) {
+        cur_trace = (uint32_t)internal_tracker->traces.size;
+        struct sl_memory_tracker_trace trace = {
+                .func = func,
+                .file = file,
+                .line = line,
+                .context = context,
+                .ptr = ptr,
+                .stack_id = stack_id,
+        };
+        sl_segmented_array_trace_push(&internal_tracker->allocator, &internal_tracker->traces, trace);
+        sl_flat_map_index_insert(&internal_tracker->allocator, &internal_tracker->trace_map, key, cur_trace);
+    }
+    struct sl_memory_tracker_trace *trace = sl_segmented_array_trace_at(&internal_tracker->traces, cur_trace);
+    trace->amount_allocated += size;
+
+    //The pointer is still live as far as the tables know, its free is in another thread's buffer
+    uint32_t *live = sl_swiss_map_ptr_get(&internal_tracker->ptr_map, ptr);
+    if (live) {
+        sl_swiss_map_ptr_insert(&internal_tracker->allocator, &internal_tracker->displaced_map, ptr, *live);
+        *live = cur_trace;
+    } else {
+        sl_swiss_map_ptr_insert(&internal_tracker->allocator, &internal_tracker->ptr_map, ptr, cur_trace);
+    }
+}
+
+static bool mem_untrace(void *ptr, size_t size, uint32_t context)
+{
+    //A displaced trace is older than the live one, so it is the one being freed
+    uint32_t cur_trace;
+    if (!sl_swiss_map_ptr_remove(&internal_tracker->displaced_map, ptr, &cur_trace) &&
+        !sl_swiss_map_ptr_remove(&internal_tracker->ptr_map, ptr, &cur_trace))
+        return false;
+
+    struct sl_memory_tracker_trace *trace = sl_segmented_array_trace_at(&internal_tracker->traces, cur_trace);
+    trace->amount_allocated -= size;
+    atomic_fetch_sub(&internal_tracker->contexts[trace->context].num_traces, 1);
+    return true;
+}
+
+static void apply_event(const record_event* e)
+{
+    if (e->old_size > 0 && !mem_untrace(e->old_ptr, e->old_size, e->context)) {
+        const deferred_free d = {.ptr = e->old_ptr, .size = e->old_size, .context = e->context, .drain = internal_tracker->drain_count};
+        sl_array_push(&internal_tracker->allocator, internal_tracker->deferred_frees, d);
+    }
+
+    if (e->new_size > 0)
+        mem_trace(e->new_ptr, e->new_size, e->func, e->file, e->line, e->context, e->stack_id);
+}
+
+//Caller must hold tracker_mutex
+static void drain_buffers(void)
+{
+    event_buffer* first = (event_buffer*)(uintptr_t)atomic_load_explicit(&internal_tracker->buffers, memory_order_acquire);
+    internal_tracker->drain_count += 1;
+
+    //Heads are read one buffer after another, so a free can be in this drain while its allocation,
+    //pushed by another thread after that thread's head was read, only shows up in the next one
+    for (event_buffer* b = first; b; b = b->next)
+        b->drain_head = atomic_load_explicit(&b->head, memory_order_acquire);
+
+    for (event_buffer* b = first; b; b = b->next) {
+        const uint64_t tail = atomic_load_explicit(&b->tail, memory_order_relaxed);
+        for (uint64_t i = tail; i != b->drain_head; ++i)
+            apply_event(b->events + (i & (EVENT_BUFFER_SIZE - 1)));
+        atomic_store_explicit(&b->tail, b->drain_head, memory_order_release);
+    }
+
+    //An allocation is published before its pointer can reach another thread, so every head read by the
+    //drain after the one that saw a free covers its allocation. A free that still doesn't match by then
+    //was never traced (e.g. allocated while tracking was off) and is dropped
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < (uint32_t)sl_array_size(internal_tracker->deferred_frees); ++i) {
+        const deferred_free d = internal_tracker->deferred_frees[i];
+        if (!mem_untrace(d.ptr, d.size, d.context) && d.drain == internal_tracker->drain_count)
+            internal_tracker->deferred_frees[kept++] = d;
+    }
+    sl_array_resize(&internal_tracker->allocator, internal_tracker->deferred_frees, kept);
+}
+
+static void flush(void)
+{
+    SL_MUTEX_LOCK(internal_tracker->tracker_mutex) {
+        drain_buffers();
+    }
+}
+
+static void aggregator_entry(void* data)
 {
-    const char* before = file + ((uint64_t)line) + context;
-    const uint64_t key = sl_hash_bytes(&before, strlen(before), 0);
+    while (atomic_load_explicit(&internal_tracker->aggregator_running, memory_order_relaxed)) {
+        flush();
+        drain_stream();
+        sl_os_api->thread->sleep(AGGREGATOR_SLEEP);
+    }
+}
 
+//Runs on a thread that exits. Events still in the buffer are drained as usual, the next owner appends after them.
+//Under tracker_mutex so sl_shutdown_memory_tracker can't free the buffer between the shut_down check and the store
+static void release_thread_buffer(void* data)
+{
+    event_buffer* b = data;
+    thread_buffer = NULL;
     SL_MUTEX_LOCK(internal_tracker->tracker_mutex) {
-        uint32_t cur_trace = sl_hashmap_get(&internal_tracker->allocator, internal_tracker->trace_map, key);
-        if (!cur_trace) {
-            cur_trace = (uint32_t) sl_array_size(internal_tracker->traces);
-            struct sl_memory_tracker_trace trace = {
-                    .func = func,
-                    .file = file,
-                    .line = line,
-                    .context = context,
-					.ptr = ptr,
+        if (!atomic_load(&internal_tracker->shut_down))
+            atomic_store_explicit(&b->owned, false, memory_order_release);
+    }
+}
+
+static event_buffer* register_thread_buffer(void)
+{
+    //Buffers of exited threads are reused, so threads that come and go don't add buffers forever
+    event_buffer* b = (event_buffer*)(uintptr_t)atomic_load_explicit(&internal_tracker->buffers, memory_order_acquire);
+    for (; b; b = b->next) {
+        bool owned = atomic_load_explicit(&b->owned, memory_order_relaxed);
+        if (!owned && atomic_compare_exchange_strong_explicit(&b->owned, &owned, true, memory_order_acquire, memory_order_relaxed))
+            break;
+    }
+
+    if (!b) {
+        b = sl_alloc(&internal_tracker->allocator, sizeof(event_buffer));
+        sl_memset(b, 0, sizeof(event_buffer));
+        atomic_store_explicit(&b->owned, true, memory_order_relaxed);
+
+        uint64_t first = atomic_load_explicit(&internal_tracker->buffers, memory_order_relaxed);
+        do {
+            b->next = (event_buffer*)(uintptr_t)first;
+        } while (!atomic_compare_exchange_weak_explicit(&internal_tracker->buffers, &first, (uint64_t)(uintptr_t)b,
+                                                        memory_order_release, memory_order_relaxed));
+    }
+
+    //Thread local, so it stays valid after sl_shutdown_memory_tracker frees the buffers
+    thread_exit = (sl_os_thread_exit){
+            .callback = release_thread_buffer,
+            .data = b,
+    };
+    sl_os_api->thread->at_thread_exit(&thread_exit);
+
+    thread_buffer = b;
+    return b;
+}
+
+static uint32_t intern_stack(void)
+{
+    uint64_t frames[MAX_STACK_DEPTH];
+    //Leaves out intern_stack, record/record_sampled and the allocator's realloc
+    const uint32_t depth = sl_os_api->debug->capture_stack(frames, MAX_STACK_DEPTH, 3);
+    if (!depth)
+        return 0;
+
+    const uint64_t hash = sl_hash_bytes(frames, depth * sizeof(uint64_t), 0);
+    stack_cache_entry *cached = stack_cache + (hash & (STACK_CACHE_SIZE - 1));
+    if (cached->id && cached->hash == hash)
+        return cached->id;
+
+    uint32_t id;
+    SL_MUTEX_LOCK(internal_tracker->stack_mutex) {
+        const uint32_t *found = sl_flat_map_index_get(&internal_tracker->stack_map, hash);
+        id = found ? *found : 0;
+        if (!id) {
+            id = (uint32_t)sl_array_size(internal_tracker->stacks);
+            const stack_entry entry = {.offset = (uint32_t)sl_array_size(internal_tracker->stack_frames), .depth = depth};
+            sl_array_push(&internal_tracker->allocator, internal_tracker->stacks, entry);
+            for (uint32_t i = 0; i < depth; ++i)
+                sl_array_push(&internal_tracker->allocator, internal_tracker->stack_frames, frames[i]);
+            sl_flat_map_index_insert(&internal_tracker->allocator, &internal_tracker->stack_map, hash, id);
+        }
+    }
+
+    cached->hash = hash;
+    cached->id = id;
+    return id;
+}
+
+static void set_stack_capture(bool enabled)
+{
+    atomic_store_explicit(&internal_tracker->capture_stacks, enabled, memory_order_relaxed);
+}
+
+static void push_event(const record_event* e)
+{
+    if (atomic_load_explicit(&internal_tracker->shut_down, memory_order_relaxed))
+        return;
+
+    event_buffer* b = thread_buffer ? thread_buffer : register_thread_buffer();
+    const uint64_t head = atomic_load_explicit(&b->head, memory_order_relaxed);
+
+    //Buffer is full, drain it ourselves instead of waiting for the aggregator
+    while (head - atomic_load_explicit(&b->tail, memory_order_acquire) >= EVENT_BUFFER_SIZE)
+        flush();
+
+    b->events[head & (EVENT_BUFFER_SIZE - 1)] = *e;
+    atomic_store_explicit(&b->head, head + 1, memory_order_release);
+}
+
+static void capture_event(void *old_ptr, size_t old_size, void *new_ptr, size_t new_size, uint32_t context)
+{
+    const sl_memory_tracker_event e = {
+            .time = sl_os_api->info->nanoseconds(),
+            .old_ptr = (uint64_t)(uintptr_t)old_ptr,
+            .old_size = old_size,
+            .new_ptr = (uint64_t)(uintptr_t)new_ptr,
+            .new_size = new_size,
+            .context = context,
+            .thread = sl_os_api->thread->get_thread_id(),
+    };
+
+    SL_MUTEX_LOCK(internal_tracker->capture_mutex) {
+        sl_array_push(&internal_tracker->allocator, internal_tracker->capture, e);
+    }
+}
+
+//Adds to a context and to the subtree totals of it and every ancestor, so those are always up to date
+static void add_to_context(uint32_t context, uint64_t bytes, uint32_t count)
+{
+    sl_memory_tracker_context *c = internal_tracker->contexts + context;
+    atomic_fetch_add(&c->amount_allocated, bytes);
+    atomic_fetch_add(&c->allocation_count, count);
+
+    for (uint32_t i = context;;) {
+        sl_memory_tracker_context *p = internal_tracker->contexts + i;
+        atomic_fetch_add(&p->subtree_allocated, bytes);
+        atomic_fetch_add(&p->subtree_count, count);
+
+        //The root context is its own parent
+        const uint32_t parent = p->parent_context;
+        if (parent == SL_MEMORY_CONTEXT_NONE || parent == i)
+            break;
+        i = parent;
+    }
+}
+
+#pragma region Streaming
+
+static void stream_record(void *old_ptr, size_t old_size, void *new_ptr, size_t new_size,
+                          const char* func, const char *file, uint32_t line, uint32_t context)
+{
+    atomic_fetch_add(&internal_tracker->stream_users, 1);
+    if (atomic_load(&internal_tracker->streaming)) {
+        const stream_event e = {
+                .time = sl_os_api->info->nanoseconds(),
+                .old_ptr = old_ptr,
+                .new_ptr = new_ptr,
+                .old_size = old_size,
+                .new_size = new_size,
+                .func = func,
+                .file = file,
+                .line = line,
+                .context = context,
+                .thread = sl_os_api->thread->get_thread_id(),
+        };
+        //Waits for the aggregator if the ring is full, a timeline with holes in it would be misleading
+        mpmc_queue_stream_push(&internal_tracker->stream->queue, &e);
+    }
+    atomic_fetch_sub(&internal_tracker->stream_users, 1);
+}
+
+static void stream_flush(stream_state* s)
+{
+    const uint8_t* p = s->buffer;
+    uint64_t size = sl_array_size(s->buffer);
+
+    if (s->file.socket) {
+        s->failed = s->failed || !sl_os_api->file_system->file_write(s->file, p, size);
+        size = 0;
+    }
+
+    while (size && !s->failed) {
+        if (!s->window || s->window_used == STREAM_WINDOW_SIZE) {
+            if (s->window) {
+                sl_os_api->file_system->unmap_file(s->window, STREAM_WINDOW_SIZE);
+                s->window_offset += STREAM_WINDOW_SIZE;
+            }
+            s->window = sl_os_api->file_system->map_file(s->file, s->window_offset, STREAM_WINDOW_SIZE, true);
+            s->window_used = 0;
+            s->failed = !s->window;
+            continue;
+        }
+
+        const uint64_t n = size < STREAM_WINDOW_SIZE - s->window_used ? size : STREAM_WINDOW_SIZE - s->window_used;
+        sl_memcpy(s->window + s->window_used, p, n);
+        s->window_used += n;
+        p += n;
+        size -= n;
+    }
+
+    sl_array_resize(&internal_tracker->allocator, s->buffer, 0);
+}
+
+//Appends a record followed by up to two strings, padded to 8 bytes
+static void stream_append(stream_state* s, sl_alloc_stream_record* record, uint32_t record_size, const char* a, uint32_t a_length,
+                          const char* b, uint32_t b_length)
+{
+    const uint32_t size = record_size + a_length + b_length;
+    record->size = (size + 7) & ~7u;
+
+    uint8_t* dst = sl_array_addnptr(&internal_tracker->allocator, s->buffer, record->size);
+    sl_memcpy(dst, record, record_size);
+    sl_memcpy(dst + record_size, a, a_length);
+    sl_memcpy(dst + record_size + a_length, b, b_length);
+    sl_memset(dst + size, 0, record->size - size);
+}
+
+static uint32_t stream_site(stream_state* s, const stream_event* e)
+{
+    const uint64_t key[3] = {(uint64_t)(uintptr_t)e->func, (uint64_t)(uintptr_t)e->file, e->line};
+    const uint64_t hash = sl_hash_bytes((void*)key, sizeof(key), 0);
+
+    const uint32_t *found = sl_flat_map_index_get(&s->site_map, hash);
+    uint32_t site = found ? *found : 0;
+    if (!site) {
+        site = ++s->num_sites;
+        sl_flat_map_index_insert(&internal_tracker->allocator, &s->site_map, hash, site);
+
+        sl_alloc_stream_site_record r = {
+                .record.type = sl_alloc_stream_site,
+                .id = site,
+                .line = e->line,
+                .func_length = e->func ? (uint32_t)strlen(e->func) : 0,
+                .file_length = e->file ? (uint32_t)strlen(e->file) : 0,
+        };
+        stream_append(s, &r.record, sizeof(r), e->func, r.func_length, e->file, r.file_length);
+    }
+    return site;
+}
+
+static void stream_context(stream_state* s, uint32_t context)
+{
+    while ((uint32_t)sl_array_size(s->context_names) <= context)
+        sl_array_push(&internal_tracker->allocator, s->context_names, NULL);
+
+    const sl_memory_tracker_context* c = internal_tracker->contexts + context;
+    if (s->context_names[context] == c->name && c->name)
+        return;
+
+    s->context_names[context] = c->name;
+    sl_alloc_stream_context_record r = {
+            .record.type = sl_alloc_stream_context,
+            .id = context,
+            .parent = c->parent_context,
+            .name_length = c->name ? (uint32_t)strlen(c->name) : 0,
+    };
+    stream_append(s, &r.record, sizeof(r), c->name, r.name_length, NULL, 0);
+}
+
+//Caller must hold stream_mutex
+static void stream_encode(stream_state* s)
+{
+    stream_event e;
+    while (mpmc_queue_stream_pop(&s->queue, &e)) {
+        stream_context(s, e.context);
+        sl_alloc_stream_event_record r = {
+                .record.type = sl_alloc_stream_event,
+                .time = e.time - s->start_time,
+                .old_ptr = (uint64_t)(uintptr_t)e.old_ptr,
+                .new_ptr = (uint64_t)(uintptr_t)e.new_ptr,
+                .old_size = e.old_size,
+                .new_size = e.new_size,
+                .site = stream_site(s, &e),
+                .context = e.context,
+                .thread = e.thread,
+        };
+        stream_append(s, &r.record, sizeof(r), NULL, 0, NULL, 0);
+
+        if (sl_array_size(s->buffer) >= STREAM_FLUSH_SIZE)
+            stream_flush(s);
+    }
+    stream_flush(s);
+}
+
+static void drain_stream(void)
+{
+    if (!atomic_load_explicit(&internal_tracker->streaming, memory_order_relaxed))
+        return;
+
+    SL_MUTEX_LOCK(internal_tracker->stream_mutex) {
+        if (atomic_load(&internal_tracker->streaming))
+            stream_encode(internal_tracker->stream);
+    }
+}
+
+static bool begin_stream(const char *path, bool socket)
+{
+    bool ok = false;
+    SL_MUTEX_LOCK(internal_tracker->stream_mutex) {
+        const sl_os_file file = atomic_load(&internal_tracker->streaming) ? (sl_os_file){ 0 } :
+                                socket ? sl_os_api->file_system->open_local_socket(path, false) : sl_os_api->file_system->open_file_write(path);
+        if (file.valid) {
+            //The ring is kept after end_stream, threads that saw streaming just before it ended may still touch it
+            stream_state* s = internal_tracker->stream;
+            if (!s) {
+                s = sl_alloc(&internal_tracker->allocator, sizeof(stream_state));
+                sl_memset(s, 0, sizeof(stream_state));
+                internal_tracker->stream = s;
+            }
+            mpmc_queue_stream_init(&s->queue, s->cells, STREAM_RING_SIZE);
+            s->file = file;
+            s->start_time = sl_os_api->info->nanoseconds();
+            s->failed = false;
+            s->window = NULL;
+            s->window_offset = 0;
+            s->window_used = 0;
+            s->num_sites = 0;
+
+            const sl_alloc_stream_header header = {
+                    .magic = SL_ALLOC_STREAM_MAGIC,
+                    .version = SL_ALLOC_STREAM_VERSION,
+                    .start_time = s->start_time,
             };
-            sl_array_push(&internal_tracker->allocator, internal_tracker->traces, trace);
-            sl_hashmap_push(&internal_tracker->allocator, internal_tracker->trace_map, key, cur_trace);
+            sl_memcpy(sl_array_addnptr(&internal_tracker->allocator, s->buffer, sizeof(header)), &header, sizeof(header));
+            stream_flush(s);
+
+            ok = !s->failed;
+            if (ok)
+                atomic_store(&internal_tracker->streaming, true);
+            else
+                sl_os_api->file_system->file_close(file);
         }
-        struct sl_memory_tracker_trace *trace = internal_tracker->traces + cur_trace;
-        trace->amount_allocated += size;
-        sl_hashmap_push(&internal_tracker->allocator, internal_tracker->ptr_map, ptr, cur_trace);
-        internal_tracker->contexts[context].num_traces += 1;
     }
+    return ok;
+}
 
+static void end_stream(void)
+{
+    SL_MUTEX_LOCK(internal_tracker->stream_mutex) {
+        stream_state* s = internal_tracker->stream;
+        if (atomic_load(&internal_tracker->streaming)) {
+            atomic_store(&internal_tracker->streaming, false);
+
+            //Keep draining, a thread still in stream_record could be waiting on a full ring
+            do {
+                stream_encode(s);
+            } while (atomic_load(&internal_tracker->stream_users));
+            stream_encode(s);
+
+            if (s->window)
+                sl_os_api->file_system->unmap_file(s->window, STREAM_WINDOW_SIZE);
+            if (!s->file.socket)
+                sl_os_api->file_system->file_resize(s->file, s->window_offset + s->window_used);
+            sl_os_api->file_system->file_close(s->file);
+
+            sl_array_free(&internal_tracker->allocator, s->buffer);
+            sl_array_free(&internal_tracker->allocator, s->context_names);
+            sl_flat_map_index_free(&internal_tracker->allocator, &s->site_map);
+        }
+    }
 }
 
-static void mem_untrace(void *ptr, size_t size, uint32_t context)
+#pragma endregion
+
+#pragma region Sampling
+
+static uint32_t sampled_slot(uint64_t key)
 {
-    SL_MUTEX_LOCK(internal_tracker->tracker_mutex) {
-        const uint32_t cur_trace = sl_hashmap_get(&internal_tracker->allocator, internal_tracker->ptr_map, ptr);
-        if (cur_trace) {
-            struct sl_memory_tracker_trace *trace = internal_tracker->traces + cur_trace;
-            trace->amount_allocated -= size;
-            sl_hashmap_del(&internal_tracker->allocator, internal_tracker->ptr_map, ptr);
-            internal_tracker->contexts[context].num_traces -= 1;
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    return (uint32_t)key & (SAMPLED_SET_SIZE - 1);
+}
+
+//Returns false if the set is full, the sample is left out then
+static bool sampled_insert(sampled_set* set, void* ptr, uint64_t weight)
+{
+    const uint64_t key = (uint64_t)(uintptr_t)ptr;
+    bool inserted = false;
+    sl_spinlock_lock(&set->lock);
+    if (atomic_load_explicit(&set->count, memory_order_relaxed) < SAMPLED_SET_SIZE - 1) {
+        uint32_t i = sampled_slot(key);
+        while (atomic_load_explicit(&set->keys[i], memory_order_relaxed))
+            i = (i + 1) & (SAMPLED_SET_SIZE - 1);
+        set->weights[i] = weight;
+        atomic_store_explicit(&set->keys[i], key, memory_order_release);
+        atomic_fetch_add(&set->count, 1);
+        inserted = true;
+    }
+    sl_spinlock_unlock(&set->lock);
+    return inserted;
+}
+
+static bool sampled_contains(sampled_set* set, uint64_t key)
+{
+    for (;;) {
+        const uint64_t seq = atomic_load_explicit(&set->sequence, memory_order_acquire);
+        if (seq & 1)
+            continue;
+
+        bool found = false;
+        for (uint32_t i = sampled_slot(key);; i = (i + 1) & (SAMPLED_SET_SIZE - 1)) {
+            const uint64_t k = atomic_load_explicit(&set->keys[i], memory_order_acquire);
+            if (k == key) {
+                found = true;
+                break;
+            }
+            if (!k)
+                break;
+        }
+
+        if (atomic_load_explicit(&set->sequence, memory_order_acquire) == seq)
+            return found;
+    }
+}
+
+//Returns the weight the pointer was sampled with, 0 if it wasn't sampled
+static uint64_t sampled_remove(sampled_set* set, void* ptr)
+{
+    const uint64_t key = (uint64_t)(uintptr_t)ptr;
+    if (!atomic_load_explicit(&set->count, memory_order_relaxed) || !sampled_contains(set, key))
+        return 0;
+
+    uint64_t weight = 0;
+    sl_spinlock_lock(&set->lock);
+    atomic_fetch_add_explicit(&set->sequence, 1, memory_order_acq_rel);
+
+    uint32_t i = sampled_slot(key);
+    while (atomic_load_explicit(&set->keys[i], memory_order_relaxed) != key)
+        i = (i + 1) & (SAMPLED_SET_SIZE - 1);
+    weight = set->weights[i];
+
+    //Backward shift: pull later entries of the cluster into the hole if their home slot allows it
+    for (uint32_t j = (i + 1) & (SAMPLED_SET_SIZE - 1);; j = (j + 1) & (SAMPLED_SET_SIZE - 1)) {
+        const uint64_t k = atomic_load_explicit(&set->keys[j], memory_order_relaxed);
+        if (!k)
+            break;
+        const uint32_t home = sampled_slot(k);
+        if (((j - home) & (SAMPLED_SET_SIZE - 1)) >= ((j - i) & (SAMPLED_SET_SIZE - 1))) {
+            atomic_store_explicit(&set->keys[i], k, memory_order_relaxed);
+            set->weights[i] = set->weights[j];
+            i = j;
+        }
+    }
+    atomic_store_explicit(&set->keys[i], 0, memory_order_relaxed);
+    atomic_fetch_sub(&set->count, 1);
+
+    atomic_fetch_add_explicit(&set->sequence, 1, memory_order_release);
+    sl_spinlock_unlock(&set->lock);
+    return weight;
+}
+
+//Exponentially distributed, so samples form a Poisson process over allocated bytes
+static int64_t next_sample_distance(uint64_t mean)
+{
+    if (!sample_rng)
+        sample_rng = ((uint64_t)(uintptr_t)&sample_rng) ^ 0x9e3779b97f4a7c15ull;
+    sample_rng ^= sample_rng << 13;
+    sample_rng ^= sample_rng >> 7;
+    sample_rng ^= sample_rng << 17;
+
+    const double u = (double)((sample_rng >> 11) + 1) * (1.0 / 9007199254740992.0);
+    return (int64_t)(-log(u) * (double)mean) + 1;
+}
+
+static void record_sampled(sl_memory_tracker_context *c, uint64_t mean, void *old_ptr, size_t old_size, void *new_ptr,
+                           size_t new_size, const char* func, const char *file, uint32_t line, uint32_t context)
+{
+    record_event e = {
+            .func = func,
+            .file = file,
+            .line = line,
+            .context = context,
+    };
+
+    if (old_size > 0) {
+        const uint64_t weight = sampled_remove(internal_tracker->sampled, old_ptr);
+        if (weight) {
+            add_to_context(context, 0 - weight, 0 - (uint32_t)((weight + old_size / 2) / old_size));
+            e.old_ptr = old_ptr;
+            e.old_size = weight;
+        }
+    }
+
+    if (new_size > 0) {
+        //The only cost of an allocation that isn't sampled
+        bytes_until_sample -= (int64_t)new_size;
+        if (bytes_until_sample <= 0) {
+            static SL_THREAD_LOCAL bool started;
+            if (!started) {
+                started = true;
+                bytes_until_sample = next_sample_distance(mean) - (int64_t)new_size;
+            }
+        }
+
+        if (bytes_until_sample <= 0) {
+            bytes_until_sample = next_sample_distance(mean);
+
+            //Expected bytes represented by this sample: size / P(size gets sampled)
+            const double p = 1.0 - exp(-(double)new_size / (double)mean);
+            const uint64_t weight = (uint64_t)((double)new_size / p + 0.5);
+
+            //The free can only take the weight back off if the set holds it
+            if (sampled_insert(internal_tracker->sampled, new_ptr, weight)) {
+                add_to_context(context, weight, (uint32_t)((weight + new_size / 2) / new_size));
+
+                if (c->tracking_enabled) {
+                    atomic_fetch_add(&c->num_traces, 1);
+                    e.new_ptr = new_ptr;
+                    e.new_size = weight;
+                    if (atomic_load_explicit(&internal_tracker->capture_stacks, memory_order_relaxed))
+                        e.stack_id = intern_stack();
+                }
+            }
         }
     }
+
+    if (e.old_size || e.new_size)
+        push_event(&e);
+}
+
+static void set_sampling(uint64_t mean_bytes)
+{
+    if (mean_bytes && !internal_tracker->sampled) {
+        sampled_set* set = sl_alloc(&internal_tracker->allocator, sizeof(sampled_set));
+        sl_memset(set, 0, sizeof(sampled_set));
+        internal_tracker->sampled = set;
+    }
+    atomic_store_explicit(&internal_tracker->sample_interval, mean_bytes, memory_order_release);
 }
 
+#pragma endregion
+
 static void record(void *old_ptr, size_t old_size, void *new_ptr, size_t new_size,
                            const char* func, const char *file, uint32_t line, uint32_t context)
 {
     if (context == SL_MEMORY_CONTEXT_NONE)
         return;
 
+    //The tracker's own allocations are left out, growing the capture buffer would capture itself
+    if (atomic_load_explicit(&internal_tracker->capturing, memory_order_relaxed) && context != internal_tracker->allocator.context)
+        capture_event(old_ptr, old_size, new_ptr, new_size, context);
+
     sl_memory_tracker_context *c = internal_tracker->contexts + context;
-    atomic_fetch_add(&c->amount_allocated, (new_size - old_size));
+
+    if (atomic_load_explicit(&internal_tracker->streaming, memory_order_relaxed) && c->tracking_enabled)
+        stream_record(old_ptr, old_size, new_ptr, new_size, func, file, line, context);
+
+    const uint64_t sample_interval = atomic_load_explicit(&internal_tracker->sample_interval, memory_order_relaxed);
+    if (sample_interval && context != internal_tracker->allocator.context) {
+        record_sampled(c, sample_interval, old_ptr, old_size, new_ptr, new_size, func, file, line, context);
+        return;
+    }
 
     const size_t old_count = (old_size > 0) ? 1 : 0;
     const size_t new_count = (new_size > 0) ? 1 : 0;
-    atomic_fetch_add(&c->allocation_count, (new_count - old_count));
+    add_to_context(context, new_size - old_size, (uint32_t)(new_count - old_count));
 
     SL_ASSERT(c->amount_allocated < 0xf000000000000000ULL, "Negative Byte Count!");
 
-    if (old_size > 0 && (c->tracking_enabled || c->num_traces)) {
-		mem_untrace(old_ptr, old_size, context);
-	}
+    //num_traces is raised here and lowered by the aggregator, so it never under-counts live traces
+    const bool untrace = old_size > 0 && (c->tracking_enabled || atomic_load_explicit(&c->num_traces, memory_order_relaxed));
+    const bool trace = new_size > 0 && c->tracking_enabled;
+    if (!untrace && !trace)
+        return;
 
-    if (new_size > 0 && c->tracking_enabled) {
-		mem_trace(new_ptr, new_size, func, file, line, context);
-	}
+    if (trace)
+        atomic_fetch_add(&c->num_traces, 1);
+
+    const record_event e = {
+            .old_ptr = untrace ? old_ptr : 0,
+            .old_size = untrace ? old_size : 0,
+            .new_ptr = trace ? new_ptr : 0,
+            .new_size = trace ? new_size : 0,
+            .func = func,
+            .file = file,
+            .line = line,
+            .context = context,
+            .stack_id = trace && atomic_load_explicit(&internal_tracker->capture_stacks, memory_order_relaxed) ? intern_stack() : 0,
+    };
+    push_event(&e);
 }
 
 
@@ -265,11 +1139,14 @@ static struct sl_memory_tracker_trace *trace_data()
 
 	struct sl_memory_tracker_trace *res = 0;
 
-	sl_array_resize(&internal_tracker->allocator, res, sl_array_size(internal_tracker->traces));
+	flush();
+
+	sl_array_resize(&internal_tracker->allocator, res, internal_tracker->traces.size);
 
 	SL_MUTEX_LOCK(internal_tracker->tracker_mutex)
 	{
-		sl_memcpy(res, internal_tracker->traces, sl_array_bytes(res));
+		sl_array_resize(&internal_tracker->allocator, res, internal_tracker->traces.size);
+		sl_segmented_array_trace_copy(&internal_tracker->traces, res, 0, sl_array_size(res));
 	}
 
 	return res;
@@ -297,6 +1174,172 @@ const char* context_name(uint32_t context)
 	return internal_tracker->contexts[context].name;
 }
 
+static const struct sl_memory_tracker_context *context_data(uint32_t context)
+{
+	return internal_tracker->contexts + context;
+}
+
+
+static void begin_capture(void)
+{
+    SL_MUTEX_LOCK(internal_tracker->capture_mutex) {
+        sl_array_resize(&internal_tracker->allocator, internal_tracker->capture, 0);
+    }
+    atomic_store_explicit(&internal_tracker->capturing, true, memory_order_relaxed);
+}
+
+static sl_memory_tracker_event *end_capture(sl_allocator *a)
+{
+    atomic_store_explicit(&internal_tracker->capturing, false, memory_order_relaxed);
+
+    sl_memory_tracker_event *res = 0;
+    SL_MUTEX_LOCK(internal_tracker->capture_mutex) {
+        sl_array_resize(a, res, sl_array_size(internal_tracker->capture));
+        sl_memcpy(res, internal_tracker->capture, sl_array_bytes(res));
+        sl_array_free(&internal_tracker->allocator, internal_tracker->capture);
+    }
+
+    return res;
+}
+
+#pragma region Snapshots
+
+typedef struct snapshot_writer
+{
+    SL_ARRAY(char, strings);
+    sl_flat_map_index string_map;
+}snapshot_writer;
+
+static uint32_t snapshot_string(snapshot_writer *w, const char *str)
+{
+    if (!str)
+        return 0;
+
+    //Strings are almost always literals, so the pointer is a good enough dedup key
+    const uint64_t key = (uint64_t)(uintptr_t)str;
+    const uint32_t *found = sl_flat_map_index_get(&w->string_map, key);
+    uint32_t offset = found ? *found : 0;
+    if (!offset) {
+        const size_t len = strlen(str) + 1;
+        offset = (uint32_t)sl_array_size(w->strings);
+        sl_memcpy(sl_array_addnptr(&internal_tracker->allocator, w->strings, len), str, len);
+        sl_flat_map_index_insert(&internal_tracker->allocator, &w->string_map, key, offset);
+    }
+    return offset;
+}
+
+static bool write_snapshot(const char *path)
+{
+    sl_allocator *a = &internal_tracker->allocator;
+    snapshot_writer w = {0};
+    sl_array_push(a, w.strings, '\0');
+
+    SL_ARRAY(sl_heap_snapshot_context, contexts) = NULL;
+    SL_ARRAY(sl_heap_snapshot_trace, traces) = NULL;
+    SL_ARRAY(sl_heap_snapshot_stack, stacks) = NULL;
+    SL_ARRAY(sl_heap_snapshot_frame, frames) = NULL;
+    SL_ARRAY(sl_heap_snapshot_live, live) = NULL;
+
+    flush();
+
+    SL_MUTEX_LOCK(internal_tracker->tracker_mutex) {
+        for (uint32_t i = 0; i < internal_tracker->num_contexts; ++i) {
+            const sl_memory_tracker_context *c = internal_tracker->contexts + i;
+            const sl_heap_snapshot_context sc = {
+                    .name = snapshot_string(&w, c->name),
+                    .parent = c->parent_context,
+                    .amount_allocated = c->amount_allocated,
+                    .allocation_count = c->allocation_count,
+                    .num_children = c->num_children,
+            };
+            sl_array_push(a, contexts, sc);
+        }
+
+        for (uint32_t i = 0; i < (uint32_t)internal_tracker->traces.size; ++i) {
+            const struct sl_memory_tracker_trace *t = sl_segmented_array_trace_at(&internal_tracker->traces, i);
+            const sl_heap_snapshot_trace st = {
+                    .func = snapshot_string(&w, t->func),
+                    .file = snapshot_string(&w, t->file),
+                    .line = t->line,
+                    .context = t->context,
+                    .stack_id = t->stack_id,
+                    .amount_allocated = t->amount_allocated,
+            };
+            sl_array_push(a, traces, st);
+        }
+
+        const sl_swiss_map_ptr *ptrs = &internal_tracker->ptr_map;
+        for (uint64_t i = sl_swiss_map_ptr_next(ptrs, 0); i < ptrs->capacity; i = sl_swiss_map_ptr_next(ptrs, i + 1)) {
+            const sl_heap_snapshot_live sl = {
+                    .ptr = (uint64_t)(uintptr_t)ptrs->slots[i].key,
+                    .trace = ptrs->slots[i].value,
+            };
+            sl_array_push(a, live, sl);
+        }
+    }
+
+    SL_MUTEX_LOCK(internal_tracker->stack_mutex) {
+        for (uint32_t i = 0; i < (uint32_t)sl_array_size(internal_tracker->stacks); ++i) {
+            const stack_entry *e = internal_tracker->stacks + i;
+            sl_array_push(a, stacks, ((sl_heap_snapshot_stack){ .offset = e->offset, .depth = e->depth }));
+        }
+        for (uint32_t i = 0; i < (uint32_t)sl_array_size(internal_tracker->stack_frames); ++i)
+            sl_array_push(a, frames, ((sl_heap_snapshot_frame){ .address = internal_tracker->stack_frames[i] }));
+    }
+
+    //Symbolised outside the locks, once per distinct address
+    sl_flat_map_index symbol_map = { 0 };
+    for (uint32_t i = 0; i < (uint32_t)sl_array_size(frames); ++i) {
+        const uint32_t *found = sl_flat_map_index_get(&symbol_map, frames[i].address);
+        uint32_t offset = found ? *found : 0;
+        if (!offset) {
+            char symbol[256];
+            sl_os_api->debug->symbolize(frames[i].address, symbol, sizeof(symbol));
+            const size_t len = strlen(symbol) + 1;
+            offset = (uint32_t)sl_array_size(w.strings);
+            sl_memcpy(sl_array_addnptr(a, w.strings, len), symbol, len);
+            sl_flat_map_index_insert(a, &symbol_map, frames[i].address, offset);
+        }
+        frames[i].symbol = offset;
+    }
+
+    const sl_heap_snapshot_header header = {
+            .magic = SL_HEAP_SNAPSHOT_MAGIC,
+            .version = SL_HEAP_SNAPSHOT_VERSION,
+            .timestamp = sl_os_api->info->nanoseconds(),
+            .num_contexts = (uint32_t)sl_array_size(contexts),
+            .num_traces = (uint32_t)sl_array_size(traces),
+            .num_stacks = (uint32_t)sl_array_size(stacks),
+            .num_frames = (uint32_t)sl_array_size(frames),
+            .num_live = (uint32_t)sl_array_size(live),
+            .strings_size = (uint32_t)sl_array_size(w.strings),
+    };
+
+    bool ok = false;
+    sl_os_file file = sl_os_api->file_system->open_file_write(path);
+    if (file.valid) {
+        ok = sl_os_api->file_system->file_write(file, &header, sizeof(header))
+             && sl_os_api->file_system->file_write(file, contexts, sl_array_bytes(contexts))
+             && sl_os_api->file_system->file_write(file, traces, sl_array_bytes(traces))
+             && sl_os_api->file_system->file_write(file, stacks, sl_array_bytes(stacks))
+             && sl_os_api->file_system->file_write(file, frames, sl_array_bytes(frames))
+             && sl_os_api->file_system->file_write(file, live, sl_array_bytes(live))
+             && sl_os_api->file_system->file_write(file, w.strings, sl_array_bytes(w.strings));
+        sl_os_api->file_system->file_close(file);
+    }
+
+    sl_flat_map_index_free(a, &symbol_map);
+    sl_flat_map_index_free(a, &w.string_map);
+    sl_array_free(a, w.strings);
+    sl_array_free(a, contexts);
+    sl_array_free(a, traces);
+    sl_array_free(a, stacks);
+    sl_array_free(a, frames);
+    sl_array_free(a, live);
+    return ok;
+}
+
+#pragma endregion
 
 static void check_for_leaks(void)
 {
@@ -313,6 +1356,27 @@ static void check_for_leaks(void)
     }
 }
 
+void sl_shutdown_memory_tracker(void)
+{
+    end_stream();
+
+    atomic_store_explicit(&internal_tracker->aggregator_running, false, memory_order_relaxed);
+    sl_os_api->thread->join_os_thread(internal_tracker->aggregator);
+
+    SL_MUTEX_LOCK(internal_tracker->tracker_mutex) {
+        drain_buffers();
+        atomic_store(&internal_tracker->shut_down, true);
+
+        event_buffer* b = (event_buffer*)(uintptr_t)atomic_exchange(&internal_tracker->buffers, 0);
+        while (b) {
+            event_buffer* next = b->next;
+            sl_free(&internal_tracker->allocator, b);
+            b = next;
+        }
+    }
+    thread_buffer = NULL;
+}
+
 static struct sl_memory_tracker_api mem_api = {
 	.create_context = create_context,
 	.destroy_context = destroy_context,
@@ -323,6 +1387,15 @@ static struct sl_memory_tracker_api mem_api = {
 	.trace_data = trace_data,
 	.context_name = context_name,
 	.scope_data = scope_data,
+	.context_data = context_data,
+	.begin_capture = begin_capture,
+	.end_capture = end_capture,
+	.set_sampling = set_sampling,
+	.toggle_stack_capture = set_stack_capture,
+	.stack_frames = stack_frames,
+	.write_snapshot = write_snapshot,
+	.begin_stream = begin_stream,
+	.end_stream = end_stream,
 };
 
 struct sl_memory_tracker_api* sl_memory_tracker_api = &mem_api;
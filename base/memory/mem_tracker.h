@@ -46,7 +46,12 @@ typedef struct sl_memory_tracker_context {
 
 	bool tracking_enabled;
 
-	uint32_t num_traces;
+	SL_ATOMIC uint32_t num_traces;
+
+	//Totals of this context and every context below it, kept up to date by record
+	SL_ATOMIC uint64_t subtree_allocated;
+
+	SL_ATOMIC uint32_t subtree_count;
 
 } sl_memory_tracker_context;
 
@@ -62,8 +67,32 @@ struct sl_memory_tracker_trace {
 	uint64_t amount_allocated;
 
 	void *ptr;
+
+	//Interned call stack of the allocation, 0 if stacks weren't captured
+	uint32_t stack_id;
 };
 
+/**
+ * @brief A Single Call to record, Captured Between begin_capture and end_capture
+ */
+typedef struct sl_memory_tracker_event {
+	uint64_t time;
+
+	uint64_t old_ptr;
+
+	uint64_t old_size;
+
+	uint64_t new_ptr;
+
+	uint64_t new_size;
+
+	uint32_t context;
+
+	uint32_t thread;
+} sl_memory_tracker_event;
+
+struct sl_allocator;
+
 struct sl_memory_tracker_api {
 	void (*check_for_leaks)(void);
 
@@ -82,6 +111,77 @@ struct sl_memory_tracker_api {
 	struct sl_memory_tracker_context *(*scope_data)(void);
 
 	const char *(*context_name)(uint32_t context);
+
+	/**
+	 * @brief Returns a Live View of a Single Context Without Copying the Table Like scope_data
+	 * The context table never moves, so the pointer stays valid. Use subtree_allocated and
+	 * subtree_count for totals that include every child context.
+	 * @param context The Context to Look At
+	 */
+	const struct sl_memory_tracker_context *(*context_data)(uint32_t context);
+
+	/**
+	 * @brief Starts Capturing Every Recorded Allocation Event (Used to Replay Allocation Traces)
+	 */
+	void (*begin_capture)(void);
+
+	/**
+	 * @brief Stops Capturing and Returns the Captured Events in Order
+	 * @param a Allocator the Returned sl_array is Allocated With
+	 * @returns sl_array of Events, Free with sl_array_free(a, events)
+	 */
+	struct sl_memory_tracker_event *(*end_capture)(struct sl_allocator *a);
+
+	/**
+	 * @brief Switches to Poisson Byte Sampling, Meant for Production Heap Profiles
+	 * Roughly one allocation per mean_bytes allocated is sampled and traced with a weight,
+	 * so context and trace totals become unbiased estimates instead of exact values.
+	 * An allocation that isn't sampled only costs a thread local decrement.
+	 * Set it before tracked allocations are made. 0 goes back to tracing everything.
+	 * @param mean_bytes Average Number of Bytes Between Two Samples
+	 */
+	void (*set_sampling)(uint64_t mean_bytes);
+
+	/**
+	 * @brief Enables Capturing the Call Stack of Every Traced Allocation
+	 * Identical stacks are interned once and traced separately, so allocations made through
+	 * array.inl/hash.inl get attributed to their real callers. Symbols are only resolved when reporting.
+	 * @param enabled Whether Stacks Should be Captured
+	 */
+	void (*toggle_stack_capture)(bool enabled);
+
+	/**
+	 * @brief Copies the Return Addresses of an Interned Stack, Innermost First
+	 * @param stack_id The stack_id of a Trace
+	 * @param frames Buffer Filled with the Addresses
+	 * @param max_frames Size of the Buffer
+	 * @returns Number of Frames Written
+	 */
+	uint32_t (*stack_frames)(uint32_t stack_id, uint64_t *frames, uint32_t max_frames);
+
+	/**
+	 * @brief Writes Contexts, Traces, Stacks and Live Pointers to a Binary Snapshot (see heap_snapshot.h)
+	 * Runs while the process keeps allocating. Two snapshots can be diffed with sl_heap_diff.
+	 * @param path File to Write
+	 * @returns True if the Snapshot was Written
+	 */
+	bool (*write_snapshot)(const char *path);
+
+	/**
+	 * @brief Streams Every Alloc, Free and Realloc to a File or Unix Domain Socket (see alloc_stream.h)
+	 * Events carry a timestamp, sizes, context, call site and thread. They go through a lock free ring
+	 * and are written by the tracker's background thread. Contexts turned off with toggle_tracking are left out.
+	 * Read the stream with sl_alloc_timeline.
+	 * @param path File to Write, or Socket to Connect to
+	 * @param socket True if path is a Unix Domain Socket Someone Listens on (e.g. sl_alloc_timeline --listen)
+	 * @returns True if the Stream was Opened
+	 */
+	bool (*begin_stream)(const char *path, bool socket);
+
+	/**
+	 * @brief Writes the Remaining Events and Closes the Stream
+	 */
+	void (*end_stream)(void);
 };
 
 #define SL_MEM_TRACKER_API "sl_memory_tracker_api"
@@ -92,6 +192,13 @@ extern struct sl_memory_tracker_api *sl_memory_tracker_api;
 
 extern void sl_init_memory_tracker(void);
 
+/**
+ * @brief Stops the Tracker's Background Thread and Frees the Per Thread Event Buffers
+ * Contexts keep counting bytes afterwards, but nothing is traced anymore. Call it once no other
+ * thread allocates, right before the process exits.
+ */
+extern void sl_shutdown_memory_tracker(void);
+
 #endif
 
 #ifdef __cplusplus
@@ -0,0 +1,214 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "scratch_allocator.h"
+#include "mem_tracker.h"
+#include "os/os.h"
+#include "thread/spinlock.inl"
+#include "util/assertions.inl"
+
+extern struct sl_os_api* sl_os_api; //os_macos.c
+
+//Address space reserved for every stack. Only touched pages get committed.
+#define SCRATCH_STACK_RESERVE SL_MEGABYTES(64)
+
+//Committed memory kept around when a stack is returned to the pool
+#define SCRATCH_STACK_KEEP SL_KILOBYTES(256)
+
+#define SCRATCH_MIN_ALIGNMENT 16
+
+typedef struct scratch_stack {
+    //Thread or fiber currently pushing onto this stack, 0 while in the pool
+    sl_atomic_uint64_t owner;
+    uint32_t depth;
+    uint64_t top;
+    uint64_t committed;
+    struct scratch_stack* next;
+} scratch_stack;
+
+typedef struct scratch_header {
+    uint64_t size;
+    uint64_t prev_top;
+} scratch_header;
+
+static sl_spinlock pool_lock;
+static scratch_stack* pool;
+
+//Stack the calling thread pushed on last. Another fiber may own it if the one that
+//pushed got suspended, which is why push compares owners before reusing it.
+static SL_THREAD_LOCAL scratch_stack* current_stack;
+
+//Only its address is used, as the owner key of threads that are not running a fiber
+static SL_THREAD_LOCAL uint8_t thread_anchor;
+
+static uint64_t current_owner(void)
+{
+    void* fiber = sl_os_api->thread->get_fiber_data();
+    return fiber ? (uint64_t)(uintptr_t)fiber : (uint64_t)(uintptr_t)&thread_anchor;
+}
+
+static bool stack_ensure_committed(scratch_stack* s, uint64_t top)
+{
+    if (top <= s->committed)
+        return true;
+
+    if (top > SCRATCH_STACK_RESERVE)
+        return false;
+
+    const uint64_t page = sl_os_api->virtual_memory->page_size();
+    uint64_t needed = (top + page - 1) & ~(page - 1);
+    if (!sl_os_api->virtual_memory->commit((uint8_t*)s + s->committed, needed - s->committed))
+        return false;
+    s->committed = needed;
+    return true;
+}
+
+static scratch_stack* acquire_stack(void)
+{
+    sl_spinlock_lock(&pool_lock);
+    scratch_stack* s = pool;
+    if (s)
+        pool = s->next;
+    sl_spinlock_unlock(&pool_lock);
+
+    if (s)
+        return s;
+
+    s = sl_os_api->virtual_memory->reserve(SCRATCH_STACK_RESERVE);
+    if (s == NULL)
+        return NULL;
+
+    const uint64_t page = sl_os_api->virtual_memory->page_size();
+    sl_os_api->virtual_memory->commit(s, page);
+    s->committed = page;
+    s->top = sl_align_16(sizeof(scratch_stack));
+    return s;
+}
+
+static void release_stack(scratch_stack* s)
+{
+    if (s->committed > SCRATCH_STACK_KEEP) {
+        sl_os_api->virtual_memory->decommit((uint8_t*)s + SCRATCH_STACK_KEEP, s->committed - SCRATCH_STACK_KEEP);
+        s->committed = SCRATCH_STACK_KEEP;
+    }
+
+    atomic_store_explicit(&s->owner, 0, memory_order_relaxed);
+    if (current_stack == s)
+        current_stack = NULL;
+
+    sl_spinlock_lock(&pool_lock);
+    s->next = pool;
+    pool = s;
+    sl_spinlock_unlock(&pool_lock);
+}
+
+static void* scratch_realloc(struct sl_allocator *a, void *ptr, size_t new_size, uint32_t align, const char* func,
+                             const char *file, uint32_t line)
+{
+    scratch_stack* s = a->inst;
+    scratch_header* h = ptr ? (scratch_header*)ptr - 1 : NULL;
+    const bool on_top = h && (uint8_t*)ptr + h->size == (uint8_t*)s + s->top;
+
+    if (new_size == 0) {
+        //Only the newest allocation can be given back early, everything else goes with the pop
+        if (on_top)
+            s->top = h->prev_top;
+        return NULL;
+    }
+
+    if (on_top) {
+        const uint64_t new_top = (uint64_t)((uint8_t*)ptr - (uint8_t*)s) + new_size;
+        if (!stack_ensure_committed(s, new_top))
+            return NULL;
+        s->top = new_top;
+        h->size = new_size;
+        return ptr;
+    }
+
+    if (h && new_size <= h->size)
+        return ptr;
+
+    if (align < SCRATCH_MIN_ALIGNMENT)
+        align = SCRATCH_MIN_ALIGNMENT;
+
+    const uint64_t start = s->top + sizeof(scratch_header);
+    const uint64_t offset = (start + align - 1) & ~((uint64_t)align - 1);
+    if (!stack_ensure_committed(s, offset + new_size)) {
+        SL_ASSERT(false, "Scratch stack exhausted!");
+        return NULL;
+    }
+
+    uint8_t* p = (uint8_t*)s + offset;
+    scratch_header* nh = (scratch_header*)p - 1;
+    nh->size = new_size;
+    nh->prev_top = s->top;
+    s->top = offset + new_size;
+
+    if (h)
+        sl_memcpy(p, ptr, h->size);
+
+    return p;
+}
+
+static sl_scratch_mark push(void)
+{
+    const uint64_t owner = current_owner();
+    scratch_stack* s = current_stack;
+
+    if (s == NULL || atomic_load_explicit(&s->owner, memory_order_relaxed) != owner) {
+        s = acquire_stack();
+        SL_ASSERT(s != NULL, "Failed to reserve a scratch stack!");
+        atomic_store_explicit(&s->owner, owner, memory_order_relaxed);
+        current_stack = s;
+    }
+
+    s->depth += 1;
+
+    sl_scratch_mark mark = {
+        .allocator = {
+            .inst = s,
+            .context = SL_MEMORY_CONTEXT_NONE,
+            .realloc = scratch_realloc
+        },
+        .offset = s->top
+    };
+    return mark;
+}
+
+static void pop(const sl_scratch_mark *mark)
+{
+    scratch_stack* s = mark->allocator.inst;
+    SL_ASSERT(s->depth > 0 && mark->offset <= s->top, "Scratch marks popped out of order!");
+
+    s->top = mark->offset;
+    s->depth -= 1;
+    if (s->depth == 0)
+        release_stack(s);
+}
+
+static struct sl_scratch_allocator_api scratch_api = {
+    .push = push,
+    .pop = pop,
+};
+
+struct sl_scratch_allocator_api* sl_scratch_allocator_api = &scratch_api;
@@ -0,0 +1,85 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_SCRATCH_ALLOCATOR_H
+#define STARLIGHT_SCRATCH_ALLOCATOR_H
+
+#include "defines.h"
+#include "allocator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief A Position in a Scratch Stack Returned by push
+ * Everything allocated through allocator after the push is released by the matching pop.
+ */
+typedef struct sl_scratch_mark {
+/**
+ * @brief Allocator that Allocates From the Scratch Stack this Mark Belongs to
+ */
+    sl_allocator allocator;
+
+/**
+ * @brief Top of the Stack at the Time of the Push
+ */
+    uint64_t offset;
+
+} sl_scratch_mark;
+
+/**
+ * @brief Per Thread Scratch Stack Allocation
+ * Replacement for alloca and large stack buffers. Each thread (or fiber) pushes a mark,
+ * allocates from mark.allocator and pops back to the mark when done. Stacks live in
+ * reserved virtual memory and only commit the pages that actually get touched.
+ * A mark stays bound to its stack, so a fiber may be resumed on another thread between
+ * push and pop. Scratch allocations are not recorded by the memory tracker.
+ */
+struct sl_scratch_allocator_api {
+/**
+ * @brief Pushes a New Mark on the Calling Thread/Fiber's Scratch Stack
+ * @returns The Mark, Containing the Allocator to Use Until it is Popped
+ */
+    sl_scratch_mark (*push)(void);
+
+/**
+ * @brief Frees Everything Allocated Since the Mark was Pushed
+ * Marks must be popped in the reverse order they were pushed.
+ * @param mark The Mark Returned by push
+ */
+    void (*pop)(const sl_scratch_mark *mark);
+
+};
+
+#define SL_SCRATCH_ALLOCATOR_API "sl_scratch_allocator_api"
+
+#ifdef LINKS_SL_BASE
+extern struct sl_scratch_allocator_api* sl_scratch_allocator_api;
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //STARLIGHT_SCRATCH_ALLOCATOR_H
@@ -56,6 +56,18 @@ typedef struct sl_os_thread {
  */
 typedef void thread_entry(void *data);
 
+/**
+ * @brief Callback Run on a Thread Right Before it Exits, see at_thread_exit
+ * Owned by the caller, so registering one never allocates.
+ */
+typedef struct sl_os_thread_exit {
+    void (*callback)(void *data);
+
+    void *data;
+
+    struct sl_os_thread_exit *next;
+} sl_os_thread_exit;
+
 /**
  * @brief Represents an Entry Function for a Fiber
  */
@@ -113,6 +125,21 @@ typedef struct sl_os_thread_api {
     sl_os_thread (*create_os_thread)(thread_entry *entry, void *user_data, uint32_t stack_size,
                                const char *debug_name);
 
+/**
+ * @brief Waits for a Thread From create_os_thread to Return and Releases it
+ * Every thread has to be joined once, or its resources are kept until the process exits.
+ * @param thread The Thread to Wait For
+ */
+    void (*join_os_thread)(sl_os_thread thread);
+
+/**
+ * @brief Runs a Callback When the Calling Thread Exits, Also for Threads Not Made by create_os_thread
+ * Callbacks run newest first. The node must stay valid until its callback was called, and may be
+ * reused as soon as the callback starts.
+ * @param exit Callback and its Data
+ */
+    void (*at_thread_exit)(sl_os_thread_exit *exit);
+
     /**
  * @brief Sets The Current Threads Custom Name
  * @param thread The Thread to Modify
@@ -127,6 +154,12 @@ typedef struct sl_os_thread_api {
 */
     void (*get_thread_name)(char *buffer, int size);
 
+    /**
+* @brief Gets A Counter That Changes Whenever Any Thread Is Renamed
+* @return The Counter, A Cached Thread Name Is Stale Once It Differs From The Value Read With It
+*/
+    uint32_t (*get_thread_name_version)(void);
+
 /**
  * @brief Sets a Threads Affinity. Usually used to lock a thread to a specific core
  * @param thread The thread to be modified
@@ -201,6 +234,7 @@ typedef struct sl_os_thread_api {
 typedef struct sl_os_file {
     uint64_t handle;
     bool valid;
+    bool socket;
 
 } sl_os_file;
 
@@ -214,6 +248,65 @@ typedef struct sl_os_filesystem_api {
 
     bool (*file_write)(sl_os_file file, const void *p_buffer, uint64_t size);
 
+/**
+ * @brief Reads up to size Bytes From the Current Position of a File
+ * @returns Number of Bytes Read, 0 at the End of the File or on Error
+ */
+    uint64_t (*file_read)(sl_os_file file, void *p_buffer, uint64_t size);
+
+/**
+ * @brief Returns the Size of an Open File in Bytes
+ */
+    uint64_t (*file_size)(sl_os_file file);
+
+/**
+ * @brief Grows or Truncates an Open File
+ * @returns True if the File Now Has the Given Size
+ */
+    bool (*file_resize)(sl_os_file file, uint64_t size);
+
+/**
+ * @brief Pushes Everything Written to a File Through to the Storage Device
+ * file_write Already Hands Data to the OS, so This is Only Needed to Survive a Power Loss or OS Crash
+ * @returns True if the Data Reached the Device
+ */
+    bool (*file_flush)(sl_os_file file);
+
+/**
+ * @brief Renames a File, Replacing the Destination if it Exists
+ * @returns True if the File was Renamed
+ */
+    bool (*file_rename)(const char *from, const char *to);
+
+/**
+ * @brief Deletes a File
+ * @returns True if the File was Deleted
+ */
+    bool (*file_delete)(const char *path);
+
+/**
+ * @brief Maps a Range of a File Into Memory
+ * Writable mappings grow the file to cover the range and need a file from open_file_write.
+ * @param offset Start of the Range, Must be a Multiple of the Page Size
+ * @param size Size of the Range in Bytes
+ * @param writable Whether Writes to the Mapping Should go to the File
+ * @returns Base Address of the Mapping, or NULL on Failure
+ */
+    void *(*map_file)(sl_os_file file, uint64_t offset, uint64_t size, bool writable);
+
+/**
+ * @brief Unmaps a Range Returned by map_file
+ */
+    void (*unmap_file)(void *ptr, uint64_t size);
+
+/**
+ * @brief Opens a Stream Connection Over a Unix Domain Socket
+ * The returned file works with file_write, file_read and file_close.
+ * @param path Path of the Socket
+ * @param listen If True Creates the Socket and Blocks Until a Peer Connects, Otherwise Connects to it
+ */
+    sl_os_file (*open_local_socket)(const char *path, bool listen);
+
     void (*file_close)(sl_os_file file);
 
 } sl_os_filesystem_api;
@@ -221,8 +314,125 @@ typedef struct sl_os_filesystem_api {
 typedef struct sl_os_info_api
 {
     uint32_t (*num_logical_cores)(void);
+
+/**
+ * @brief Returns a Monotonic Timestamp in Nanoseconds
+ */
+    uint64_t (*nanoseconds)(void);
+
+/**
+ * @brief Returns the Amount of Physical Memory Currently Used by the Process in Bytes
+ */
+    uint64_t (*resident_memory)(void);
+
+/**
+ * @brief Returns the Most Physical Memory the Process has Used so Far in Bytes
+ */
+    uint64_t (*peak_resident_memory)(void);
 } sl_os_info_api;
 
+/**
+ * @brief Access Rights for a Range of Committed Pages
+ */
+typedef enum sl_os_page_access {
+    sl_page_no_access = 0,
+    sl_page_read = 1,
+    sl_page_write = 2,
+    sl_page_read_write = 3
+} sl_os_page_access;
+
+/**
+ * @brief Abstraction of OS Virtual Memory Operations
+ * Address space is reserved once and physical pages are committed/decommitted on demand.
+ * All sizes and pointers passed to commit/decommit/protect must be page aligned.
+ */
+typedef struct sl_os_virtual_memory_api {
+/**
+ * @brief Reserves a Range of Address Space Without Backing it With Physical Memory
+ * @param size Size of the Range in Bytes (Rounded Up to the Page Size)
+ * @returns Page Aligned Base Address of the Range, or NULL on Failure
+ */
+    void *(*reserve)(uint64_t size);
+
+/**
+ * @brief Backs a Reserved Range With Zeroed Read/Write Pages
+ * @param ptr Start of the Range
+ * @param size Size of the Range in Bytes
+ * @returns True if the Pages were Committed
+ */
+    bool (*commit)(void *ptr, uint64_t size);
+
+/**
+ * @brief Returns the Physical Pages of a Range to the OS but Keeps the Address Space Reserved
+ * @param ptr Start of the Range
+ * @param size Size of the Range in Bytes
+ */
+    void (*decommit)(void *ptr, uint64_t size);
+
+/**
+ * @brief Releases a Range Returned by reserve
+ * @param ptr Base Address Returned by reserve
+ * @param size Size that was Passed to reserve
+ */
+    void (*release)(void *ptr, uint64_t size);
+
+/**
+ * @brief Changes the Access Rights of a Committed Range
+ * @param ptr Start of the Range
+ * @param size Size of the Range in Bytes
+ * @param access New Access Rights
+ * @returns True if the Protection was Changed
+ */
+    bool (*protect)(void *ptr, uint64_t size, sl_os_page_access access);
+
+/**
+ * @brief Returns the Size of a Virtual Memory Page in Bytes
+ */
+    uint64_t (*page_size)(void);
+
+/**
+ * @brief Maps Committed Read/Write Memory Backed by Huge Pages
+ * Explicit huge pages are tried first. Where the OS has transparent huge pages the range is
+ * aligned to the huge page size and the OS is advised to back it with them instead.
+ * Platforms with neither (Apple Silicon macOS) return NULL, callers should use normal pages then.
+ * @param size Size of the Range in Bytes (Rounded Up to the Huge Page Size)
+ * @param explicit_huge Set to True if the Range got Explicit Huge Pages. Can be NULL
+ * @returns Huge Page Aligned Base Address of the Range, or NULL if Huge Pages Aren't Available. Freed with release
+ */
+    void *(*map_huge_pages)(uint64_t size, bool *explicit_huge);
+
+/**
+ * @brief Returns the Size of a Huge Page in Bytes
+ */
+    uint64_t (*huge_page_size)(void);
+
+} sl_os_virtual_memory_api;
+
+/**
+ * @brief Abstraction of OS Debugging Helpers
+ */
+typedef struct sl_os_debug_api {
+/**
+ * @brief Captures the Return Addresses of the Calling Thread's Stack by Walking Frame Pointers
+ * Code built without frame pointers ends the walk early.
+ * @param frames Buffer Filled with Return Addresses, Innermost First
+ * @param max_frames Size of the Buffer
+ * @param skip Number of Innermost Frames to Leave Out
+ * @returns Number of Frames Written
+ */
+    uint32_t (*capture_stack)(uint64_t *frames, uint32_t max_frames, uint32_t skip);
+
+/**
+ * @brief Resolves a Code Address to a Readable "symbol+offset (module)" String
+ * @param address The Address to Resolve
+ * @param buffer C String Buffer to be Filled
+ * @param size Size of the Buffer
+ * @returns True if a Symbol was Found
+ */
+    bool (*symbolize)(uint64_t address, char *buffer, uint32_t size);
+
+} sl_os_debug_api;
+
 /**
  * @brief Abstraction of Common OS Operations
  */
@@ -230,6 +440,8 @@ struct sl_os_api {
     sl_os_thread_api *thread;
     sl_os_filesystem_api *file_system;
     sl_os_info_api* info;
+    sl_os_virtual_memory_api* virtual_memory;
+    sl_os_debug_api* debug;
     void (*failed_assert)(const char* file, int line, const char* msg);
 };
 
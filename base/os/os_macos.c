@@ -92,9 +92,10 @@ static void* internal_thread_func(void *data)
     struct internal_thread_data *itd = (struct internal_thread_data *)data;
     struct internal_thread_data td = *itd;
     sl_free(sl_allocator_api->system, itd);
-    td.entry(td.user_data);
+    //Named before the entry runs so anything it logs carries the name
     if (td.debug_name)
         pthread_setname_np(td.debug_name);
+    td.entry(td.user_data);
     return NULL;
 }
 
@@ -115,9 +116,50 @@ static sl_os_thread macos_create_thread(thread_entry *entry, void *user_data, ui
     return thread;
 }
 
+static void macos_join_thread(sl_os_thread thread)
+{
+    pthread_t pthread;
+    memcpy(&pthread, &thread, sizeof(pthread));
+    pthread_join(pthread, NULL);
+}
+
+static pthread_key_t thread_exit_key;
+static pthread_once_t thread_exit_once = PTHREAD_ONCE_INIT;
+
+static void run_thread_exit(void* data)
+{
+    for (sl_os_thread_exit* e = data; e;) {
+        //The callback may hand the node to someone else
+        sl_os_thread_exit* next = e->next;
+        e->callback(e->data);
+        e = next;
+    }
+}
+
+static void create_thread_exit_key(void)
+{
+    pthread_key_create(&thread_exit_key, run_thread_exit);
+}
+
+static void macos_at_thread_exit(sl_os_thread_exit* exit)
+{
+    pthread_once(&thread_exit_once, create_thread_exit_key);
+    //Callbacks registered while the list runs are picked up by another round of key destructors
+    exit->next = pthread_getspecific(thread_exit_key);
+    pthread_setspecific(thread_exit_key, exit);
+}
+
+static sl_atomic_uint32_t thread_name_version;
+
 static void macos_set_thread_name(const char* name)
 {
     pthread_setname_np(name);
+    atomic_fetch_add_explicit(&thread_name_version, 1, memory_order_release);
+}
+
+static uint32_t macos_get_thread_name_version(void)
+{
+    return atomic_load_explicit(&thread_name_version, memory_order_acquire);
 }
 
 static void macos_get_thread_name(char* buffer, int size)
@@ -373,10 +415,194 @@ static uint32_t macos_logical_cores()
     return cores;
 }
 
+#include <time.h>
+#include <sys/resource.h>
+
+static uint64_t macos_nanoseconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t macos_resident_memory(void)
+{
+    struct mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+        return 0;
+    return info.resident_size;
+}
+
+static uint64_t macos_peak_resident_memory(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    //ru_maxrss is in bytes on macOS
+    return (uint64_t)usage.ru_maxrss;
+}
+
 static sl_os_info_api macos_info = {
-        .num_logical_cores = macos_logical_cores
+        .num_logical_cores = macos_logical_cores,
+        .nanoseconds = macos_nanoseconds,
+        .resident_memory = macos_resident_memory,
+        .peak_resident_memory = macos_peak_resident_memory,
+};
+
+#pragma region Debug
+
+#include <dlfcn.h>
+#include <stdio.h>
+
+//Frames further apart than this are treated as a corrupt chain
+#define MAX_FRAME_DISTANCE SL_MEGABYTES(8)
+
+static uint32_t macos_capture_stack(uint64_t* frames, uint32_t max_frames, uint32_t skip)
+{
+    //fp[1] of our own frame is already the return address into the caller
+    uintptr_t* fp = __builtin_frame_address(0);
+    uint32_t n = 0;
+    while (fp && n < max_frames) {
+        const uintptr_t ret = fp[1];
+        if (!ret)
+            break;
+
+        if (skip)
+            skip -= 1;
+        else
+            frames[n++] = ret;
+
+        uintptr_t* next = (uintptr_t*)fp[0];
+        if (next <= fp || ((uintptr_t)next & (sizeof(uintptr_t) - 1)) || (uintptr_t)next - (uintptr_t)fp > MAX_FRAME_DISTANCE)
+            break;
+        fp = next;
+    }
+    return n;
+}
+
+static bool macos_symbolize(uint64_t address, char* buffer, uint32_t size)
+{
+    Dl_info info;
+    if (!dladdr((void*)(uintptr_t)address, &info) || !info.dli_sname) {
+        snprintf(buffer, size, "0x%llx", (unsigned long long)address);
+        return false;
+    }
+
+    const char* module = info.dli_fname ? strrchr(info.dli_fname, '/') : NULL;
+    module = module ? module + 1 : info.dli_fname;
+    snprintf(buffer, size, "%s+0x%llx (%s)", info.dli_sname, (unsigned long long)(address - (uint64_t)(uintptr_t)info.dli_saddr),
+             module ? module : "?");
+    return true;
+}
+
+static sl_os_debug_api macos_debug = {
+        .capture_stack = macos_capture_stack,
+        .symbolize = macos_symbolize,
+};
+
+#pragma endregion
+
+#pragma region Virtual Memory
+
+#include <sys/mman.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+static uint64_t page_size_cache;
+
+static uint64_t macos_page_size(void)
+{
+    if (!page_size_cache)
+        page_size_cache = (uint64_t)sysconf(_SC_PAGESIZE);
+    return page_size_cache;
+}
+
+static void* macos_reserve(uint64_t size)
+{
+    const uint64_t page = macos_page_size();
+    size = (size + page - 1) & ~(page - 1);
+    //PROT_NONE so nothing is backed until it gets committed
+    void* p = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+
+static bool macos_commit(void* ptr, uint64_t size)
+{
+    return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+static void macos_decommit(void* ptr, uint64_t size)
+{
+    //Replace the range with a fresh inaccessible mapping. MADV_DONTNEED on macOS only lowers the priority
+    //of anonymous pages, they'd neither be freed nor come back zeroed after a re-commit
+    mmap(ptr, size, PROT_NONE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+}
+
+static void macos_release(void* ptr, uint64_t size)
+{
+    const uint64_t page = macos_page_size();
+    munmap(ptr, (size + page - 1) & ~(page - 1));
+}
+
+static bool macos_protect(void* ptr, uint64_t size, sl_os_page_access access)
+{
+    int prot = PROT_NONE;
+    if (access & sl_page_read)
+        prot |= PROT_READ;
+    if (access & sl_page_write)
+        prot |= PROT_WRITE;
+    return mprotect(ptr, size, prot) == 0;
+}
+
+#define HUGE_PAGE_SIZE SL_MEGABYTES(2)
+
+static uint64_t macos_huge_page_size(void)
+{
+    return HUGE_PAGE_SIZE;
+}
+
+#include <mach/vm_statistics.h>
+
+//macOS has no transparent huge pages, only superpages requested through mmap's fd argument.
+//Apple Silicon kernels don't support them at all, so NULL is the common answer there
+static void* macos_map_huge_pages(uint64_t size, bool* explicit_huge)
+{
+    size = (size + HUGE_PAGE_SIZE - 1) & ~((uint64_t)HUGE_PAGE_SIZE - 1);
+    if (explicit_huge)
+        *explicit_huge = false;
+
+#ifdef VM_FLAGS_SUPERPAGE_SIZE_2MB
+    void* huge = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, VM_FLAGS_SUPERPAGE_SIZE_2MB, 0);
+    if (huge != MAP_FAILED) {
+        if (explicit_huge)
+            *explicit_huge = true;
+        return huge;
+    }
+#endif
+
+    return NULL;
+}
+
+static sl_os_virtual_memory_api macos_virtual_memory = {
+        .reserve = macos_reserve,
+        .commit = macos_commit,
+        .decommit = macos_decommit,
+        .release = macos_release,
+        .protect = macos_protect,
+        .page_size = macos_page_size,
+        .map_huge_pages = macos_map_huge_pages,
+        .huge_page_size = macos_huge_page_size,
 };
 
+#pragma endregion
+
 
 static sl_os_thread_api macos_thread_api = {
         .create_fiber = macos_create_fiber,
@@ -393,24 +619,195 @@ static sl_os_thread_api macos_thread_api = {
         .wait_semaphore = macos_wait_semaphore,
         .get_thread_id = macos_get_thread_id,
         .create_os_thread = macos_create_thread,
+        .join_os_thread = macos_join_thread,
+        .at_thread_exit = macos_at_thread_exit,
         .get_thread_id_from_thread = macos_thread_id_from_thread,
         .set_thread_affinity = macos_set_thread_affinity,
         .get_thread_name = macos_get_thread_name,
         .set_thread_name = macos_set_thread_name,
+        .get_thread_name_version = macos_get_thread_name_version,
 };
 
+#pragma region File System
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+
+static sl_os_file macos_open_file(const char* path, int flags)
+{
+    const int fd = open(path, flags | O_CLOEXEC, 0644);
+    sl_os_file file = { .handle = (uint64_t)(fd < 0 ? 0 : fd), .valid = fd >= 0 };
+    return file;
+}
+
+static sl_os_file macos_open_file_write(const char* path)
+{
+    //Read access too, so the file can be mapped writable
+    return macos_open_file(path, O_RDWR | O_CREAT | O_TRUNC);
+}
+
+static sl_os_file macos_open_file_read(const char* path)
+{
+    return macos_open_file(path, O_RDONLY);
+}
+
+static sl_os_file macos_open_file_append(const char* path)
+{
+    return macos_open_file(path, O_WRONLY | O_CREAT | O_APPEND);
+}
+
+static bool macos_file_write(sl_os_file file, const void* p_buffer, uint64_t size)
+{
+    const uint8_t* p = p_buffer;
+    while (size) {
+#ifdef MSG_NOSIGNAL
+        //A peer that went away shouldn't kill the process with SIGPIPE
+        const ssize_t res = file.socket ? send((int)file.handle, p, size, MSG_NOSIGNAL) : write((int)file.handle, p, size);
+#else
+        const ssize_t res = write((int)file.handle, p, size);
+#endif
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += res;
+        size -= (uint64_t)res;
+    }
+    return true;
+}
+
+static uint64_t macos_file_read(sl_os_file file, void* p_buffer, uint64_t size)
+{
+    uint8_t* p = p_buffer;
+    uint64_t total = 0;
+    while (total < size) {
+        const ssize_t res = read((int)file.handle, p + total, size - total);
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res <= 0)
+            break;
+        total += (uint64_t)res;
+    }
+    return total;
+}
+
+static uint64_t macos_file_size(sl_os_file file)
+{
+    struct stat st;
+    if (fstat((int)file.handle, &st) != 0)
+        return 0;
+    return (uint64_t)st.st_size;
+}
+
+static bool macos_file_resize(sl_os_file file, uint64_t size)
+{
+    return ftruncate((int)file.handle, (off_t)size) == 0;
+}
+
+static bool macos_file_flush(sl_os_file file)
+{
+#ifdef F_FULLFSYNC
+    //fsync on macOS leaves the data in the drive's cache
+    if (fcntl((int)file.handle, F_FULLFSYNC) == 0)
+        return true;
+#endif
+    return fsync((int)file.handle) == 0;
+}
+
+static bool macos_file_rename(const char* from, const char* to)
+{
+    return rename(from, to) == 0;
+}
+
+static bool macos_file_delete(const char* path)
+{
+    return unlink(path) == 0;
+}
+
+static void* macos_map_file(sl_os_file file, uint64_t offset, uint64_t size, bool writable)
+{
+    if (writable && macos_file_size(file) < offset + size && !macos_file_resize(file, offset + size))
+        return NULL;
+
+    void* ptr = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, (int)file.handle, (off_t)offset);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+static void macos_unmap_file(void* ptr, uint64_t size)
+{
+    munmap(ptr, size);
+}
+
+static sl_os_file macos_open_local_socket(const char* path, bool listen_for_peer)
+{
+    sl_os_file file = { 0 };
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return file;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return file;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    if (listen_for_peer) {
+        unlink(path);
+        const int server = fd;
+        fd = bind(server, (struct sockaddr*)&addr, sizeof(addr)) == 0 && listen(server, 1) == 0 ? accept(server, NULL, NULL) : -1;
+        close(server);
+        unlink(path);
+    } else if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+
+#ifdef SO_NOSIGPIPE
+    if (fd >= 0)
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &(int){ 1 }, sizeof(int));
+#endif
+
+    file.handle = (uint64_t)(fd < 0 ? 0 : fd);
+    file.valid = fd >= 0;
+    file.socket = true;
+    return file;
+}
+
+static void macos_file_close(sl_os_file file)
+{
+    if (file.valid)
+        close((int)file.handle);
+}
+
 static sl_os_filesystem_api macos_file_system = {
-        .open_file_append = NULL,
-        .open_file_read = NULL,
-        .open_file_write = NULL,
-        .file_close = NULL,
-        .file_write = NULL,
+        .open_file_append = macos_open_file_append,
+        .open_file_read = macos_open_file_read,
+        .open_file_write = macos_open_file_write,
+        .file_close = macos_file_close,
+        .file_write = macos_file_write,
+        .file_read = macos_file_read,
+        .file_size = macos_file_size,
+        .file_resize = macos_file_resize,
+        .file_flush = macos_file_flush,
+        .file_rename = macos_file_rename,
+        .file_delete = macos_file_delete,
+        .map_file = macos_map_file,
+        .unmap_file = macos_unmap_file,
+        .open_local_socket = macos_open_local_socket,
 };
 
+#pragma endregion
+
 struct sl_os_api *sl_os_api = &(struct sl_os_api){
         .thread = &macos_thread_api,
         .file_system = &macos_file_system,
         .info = &macos_info,
+        .virtual_memory = &macos_virtual_memory,
+        .debug = &macos_debug,
 };
 
 #endif
@@ -25,44 +25,84 @@
 #include "api_registry.h"
 
 #include "base/data_structures/hash.inl"
+#include "base/data_structures/concurrent_map.inl"
+#include "base/memory/mem_tracker.h"
+#include "base/util/assertions.inl"
+
+#define MAX_APIS 128
 
 struct internal_api {
 	void* functions[128];
 };
 
-static size_t g_hashed_names[128];
-static const char* g_api_names[128]; //Unused for now... maybe not useful
-static void*g_api_pointers[128]; //Unused for now... maybe not useful
-static struct internal_api g_apis[128];
+//Name of every api, NULL while it was only looked up by hash
+static const char* g_api_names[MAX_APIS];
+static void*g_api_pointers[MAX_APIS]; //Unused for now... maybe not useful
+static struct internal_api g_apis[MAX_APIS];
 static uint32_t g_num_apis = 1;
 
-SL_INLINE uint32_t search_for_api_name_and_hash(const char* name, size_t hash)
+//Hashed name -> index into g_apis. Every plugin calls get, so lookups never lock
+static sl_concurrent_map g_api_map;
+static sl_spinlock g_api_lock;
+static sl_allocator g_api_allocator;
+
+extern struct sl_allocator_api* sl_allocator_api; //allocator.c
+
+//Only the hash is in the map, the name catches two apis sharing one. Caller must hold g_api_lock
+static void check_api_name(uint32_t index, const char* name)
+{
+	if (!g_api_names[index])
+		g_api_names[index] = name;
+	else
+		SL_ASSERT(strcmp(g_api_names[index], name) == 0, "Two api names share a hash");
+}
+
+SL_INLINE uint32_t search_for_api_name_and_hash(const char* name, uint64_t hash)
 {
-	//Check To See if Hashed Name Exists in the Array of Hashed Names
-	for(uint32_t i = 0; i < g_num_apis; i++)
-	{
-		if(g_hashed_names[i]==hash)
-		{
-			//If it exists... return the index of the array.
-			return i;
+	//Key 0 marks empty slots in the map
+	const uint64_t key = hash ? hash : 1;
+
+	//Check To See if the Api was Set or Asked For Before
+	uint64_t index;
+	if (sl_concurrent_map_get(&g_api_map, key, &index)) {
+		if (name) {
+			sl_spinlock_lock(&g_api_lock);
+			check_api_name((uint32_t)index, name);
+			sl_spinlock_unlock(&g_api_lock);
+		}
+		return (uint32_t)index;
+	}
+
+	//If it doesnt exist... add it, checking again in case another thread just did
+	sl_spinlock_lock(&g_api_lock);
+	if (!sl_concurrent_map_get(&g_api_map, key, &index)) {
+		if (!g_api_map.allocator) {
+			g_api_allocator = *sl_allocator_api->system;
+			g_api_allocator.context = SL_MEMORY_CONTEXT_NONE;
+			sl_concurrent_map_init(&g_api_map, &g_api_allocator, MAX_APIS);
 		}
+
+		SL_ASSERT(g_num_apis < MAX_APIS, "Too many apis");
+		index = g_num_apis;
+		//Add the name to the name array
+		g_api_names[index] = name;
+		//Increment number of apis in the system
+		g_num_apis += 1;
+		sl_concurrent_map_set(&g_api_map, key, index);
+	} else if (name) {
+		check_api_name((uint32_t)index, name);
 	}
-	//If it doesnt exist...
-
-	//Add the name to the name array
-	g_api_names[g_num_apis] = name;
-	//Add the hashed name to the hashed name array
-	g_hashed_names[g_num_apis] = hash;
-	//Increment number of apis in the system
-	g_num_apis += 1;
-	//Return the previous number of apis (the index we just added too)
-	return g_num_apis - 1;
+	sl_spinlock_unlock(&g_api_lock);
+
+	return (uint32_t)index;
 }
 
 void set_api(const char* name, void* pInterf, uint32_t size)
 {
-	//Get the hash of the string
-	const size_t hash = sl_hash_string(name, 0);
+	SL_ASSERT(strlen(name) < SL_NAME_HASH_LENGTH, "Api names must be shorter than SL_NAME_HASH_LENGTH");
+
+	//Get the hash of the string, the same one SL_NAME_HASH gives at compile time
+	const uint64_t hash = sl_name_hash(name);
 
 	//Search for the api... will add a new api to the array if not found
 	const uint32_t index = search_for_api_name_and_hash(name, hash);
@@ -80,8 +120,10 @@ void remove_api(const char* name)
 
 void* get_api(const char* name)
 {
-	//Get the hash of the string
-	const size_t hash = sl_hash_string(name, 0);
+	SL_ASSERT(strlen(name) < SL_NAME_HASH_LENGTH, "Api names must be shorter than SL_NAME_HASH_LENGTH");
+
+	//Get the hash of the string, the same one SL_NAME_HASH gives at compile time
+	const uint64_t hash = sl_name_hash(name);
 
 	//Search for the api... will add a new api to the array if not found
 	const uint32_t index = search_for_api_name_and_hash(name, hash);
@@ -90,10 +132,16 @@ void* get_api(const char* name)
 	return &g_apis[index];
 }
 
+void* get_api_hashed(uint64_t name_hash)
+{
+	return &g_apis[search_for_api_name_and_hash(NULL, name_hash)];
+}
+
 static struct sl_api_registry registry = {
 	set_api,
 	remove_api,
-	get_api
+	get_api,
+	get_api_hashed
 };
 
 struct sl_api_registry* sl_global_api_registry = &registry;
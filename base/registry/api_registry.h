@@ -26,6 +26,7 @@
 #define API_REGISTRY_H
 
 #include "defines.h"
+#include "util/name_hash.inl"
 
 #ifdef __cplusplus
 extern "C" {
@@ -55,12 +56,20 @@ struct sl_api_registry
 * @param name Name of the Interface
 */
 	void* (*get)(const char* name);
+	/**
+* @brief Get Api by its Precomputed Name Hash, Skips Hashing the Name on Every Call
+* @param name_hash SL_NAME_HASH of the Interface Name (See SL_REGISTRY_GET_API)
+*/
+	void* (*get_hashed)(uint64_t name_hash);
 };
 
 #define SL_API_REGISTRY_API "sl_global_api_registry"
 
 #define SL_REGISTRY_SET_API(name, api) sl_global_api_registry->set(name, api, sizeof(*api))
 
+//name must be a string literal or an *_API define, so its hash is computed at compile time
+#define SL_REGISTRY_GET_API(reg, name) (reg)->get_hashed(SL_NAME_HASH(name))
+
 #ifdef LINKS_SL_BASE
 
 extern struct sl_api_registry* sl_global_api_registry;
@@ -44,7 +44,7 @@ static FILE* CodeReloadLog;
 static sl_allocator plugin_system_allocator;
 
 #define CR_LOG(...) fprintf(CodeReloadLog, __VA_ARGS__); fflush(CodeReloadLog)
-#define CR_ERROR(...) SL_LOG_ERROR(__VA_ARGS__)
+#define CR_ERROR(...) SL_LOG_ERROR_CHANNEL(plugin, __VA_ARGS__)
 
 #ifdef CR_DEBUG
 #   define CR_TRACE CR_LOG("CR_TRACE: %s\n", __FUNCTION__);
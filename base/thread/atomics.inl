@@ -35,12 +35,15 @@ typedef std::atomic<bool> sl_atomic_bool;
 using std::memory_order_relaxed;
 using std::memory_order_release;
 using std::memory_order_acquire;
+using std::memory_order_acq_rel;
 using std::atomic_store_explicit;
 using std::atomic_load_explicit;
 using std::atomic_compare_exchange_weak_explicit;
 using std::atomic_exchange_explicit;
 using std::atomic_fetch_sub;
 using std::atomic_fetch_add;
+using std::atomic_fetch_or_explicit;
+using std::atomic_fetch_and_explicit;
 using std::atomic_store;
 #else
 #pragma message(sl_reminder "Come Back On Windows!")
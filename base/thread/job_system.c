@@ -36,20 +36,13 @@ Referenced https://github.com/RichieSams/FiberTaskingLib
 #include "base/os/os.h"
 #include "base/data_structures/mpmc_queue.h"
 #include "memory/allocator.h"
-#include "data_structures/hash.inl"
+#include "data_structures/flat_map.inl"
 #include <stdio.h>
 
 
 extern struct sl_os_api* sl_os_api; //Found in os_activeplatform.c
 extern struct sl_sprintf_api* sl_sprintf_api; //Found in sprintf.c
 
-//Hashmap
-typedef struct semaphore_map
-{
-    uint64_t key;
-    uint32_t value;
-}semaphore_map;
-
 struct sl_job_counter
 {
     uint32_t counter_index;
@@ -115,7 +108,8 @@ typedef struct internal_job_system
 
     //Semaphores To Wake Threads
     sl_os_semaphore semaphores[MAX_WORKER_THREADS];
-    semaphore_map* thread_semaphores;
+    //Thread id -> index into semaphores, only written before the workers start
+    sl_flat_map_u32 thread_semaphores;
     sl_atomic_uint32_t next_wakeup;
 
     struct sl_allocator* p_allocator;
@@ -133,6 +127,13 @@ typedef struct internal_job_system
 //This is our job system! //TODO: Switch to allocating memory client side and passing it in so we dont store this huge struct on the stack
 static internal_job_system job_system;
 
+//Semaphore index of a worker thread, 0 for threads that aren't workers
+SL_FORCE_INLINE uint32_t thread_semaphore(uint32_t thread_id)
+{
+    const uint32_t *index = sl_flat_map_u32_get(&job_system.thread_semaphores, thread_id);
+    return index ? *index : 0;
+}
+
 static void job_proc(void *params)
 {
     //If the job system is not active yield the thread.
@@ -182,15 +183,15 @@ static void job_proc(void *params)
                     //If the waiting fiber was pinned to a thread, and we aren't that thread we must put it back in the queue.
                     mpmc_queue_wait_push(&job_system.wait_queue, &wait_fiber);
                     //We wake up whichever thread the job was pinned too...
-                    const uint64_t key = wait_fiber.fiber->pinned_index;
-                    job_system.thread_api->add_semaphore_count(job_system.semaphores[sl_hashmap_get(job_system.p_allocator, job_system.thread_semaphores, key)], 1);
+                    const uint32_t key = wait_fiber.fiber->pinned_index;
+                    job_system.thread_api->add_semaphore_count(job_system.semaphores[thread_semaphore(key)], 1);
 
                 }
             } else { //Condition Was not met
                 //Wake up the pinned thread while waiting for the condition to be met
                 if (wait_fiber.fiber->pinned_index != 0) {
-                    const uint64_t key = wait_fiber.fiber->pinned_index;
-                    job_system.thread_api->add_semaphore_count(job_system.semaphores[sl_hashmap_get(job_system.p_allocator, job_system.thread_semaphores, key)], 1);
+                    const uint32_t key = wait_fiber.fiber->pinned_index;
+                    job_system.thread_api->add_semaphore_count(job_system.semaphores[thread_semaphore(key)], 1);
                 }
                 //Put the fiber back in the queue so that the pinned thread can find it.
                 mpmc_queue_wait_push(&job_system.wait_queue, &wait_fiber);
@@ -224,8 +225,8 @@ static void job_proc(void *params)
                 //Job was pinned to a thread, but we aren't it... so put it back on the queue
                 mpmc_queue_job_push(&job_system.priority_queue, &job);
                 //Wake up the pinned thread
-                const uint64_t key = job.job_decl.pinned_index;
-                job_system.thread_api->add_semaphore_count(job_system.semaphores[sl_hashmap_get(job_system.p_allocator, job_system.thread_semaphores, key)], 1);
+                const uint32_t key = job.job_decl.pinned_index;
+                job_system.thread_api->add_semaphore_count(job_system.semaphores[thread_semaphore(key)], 1);
             }
         } else if (mpmc_queue_job_pop(&job_system.normal_queue, &job)) {  //Now Check For the Normal Priority Queue
             bool accept_job = job.job_decl.pinned_index == 0
@@ -244,13 +245,13 @@ static void job_proc(void *params)
                     mpmc_queue_uint32_push(&job_system.free_counters, &job.counter->counter_index);
             } else {
                 mpmc_queue_job_push(&job_system.normal_queue, &job);
-                const uint64_t key = job.job_decl.pinned_index;
-                job_system.thread_api->add_semaphore_count(job_system.semaphores[sl_hashmap_get(job_system.p_allocator, job_system.thread_semaphores, key)], 1);
+                const uint32_t key = job.job_decl.pinned_index;
+                job_system.thread_api->add_semaphore_count(job_system.semaphores[thread_semaphore(key)], 1);
             }
         } else if (!waiting_fibers) { //If no jobs are in the priority or normal queue, and we don't have any waiting fibers...
             //Wait on the running thread until we do have jobs to run.
-            const uint64_t key = job_system.thread_api->get_thread_id();
-            job_system.thread_api->wait_semaphore(job_system.semaphores[sl_hashmap_get(job_system.p_allocator,job_system.thread_semaphores, key)]);
+            const uint32_t key = job_system.thread_api->get_thread_id();
+            job_system.thread_api->wait_semaphore(job_system.semaphores[thread_semaphore(key)]);
 
         }
     }//Job system no longer running
@@ -323,12 +324,12 @@ static void run_jobs_and_free(sl_job_decl *jobs, uint32_t num_jobs, sl_job_stack
             mpmc_queue_job_push(&job_system.priority_queue, &j);
         }
         if (jobs[i].pinned_index) {
-            const uint64_t key = jobs[i].pinned_index;
-            job_system.thread_api->add_semaphore_count(job_system.semaphores[sl_hashmap_get(job_system.p_allocator, job_system.thread_semaphores, key)], 1);
+            const uint32_t key = jobs[i].pinned_index;
+            job_system.thread_api->add_semaphore_count(job_system.semaphores[thread_semaphore(key)], 1);
         } else {
             uint32_t index = atomic_fetch_add(&job_system.next_wakeup, 1);
-            const uint64_t key = job_system.thread_api->get_thread_id();
-            if ((index % job_system.num_worker_threads) == sl_hashmap_get(job_system.p_allocator, job_system.thread_semaphores, key))
+            const uint32_t key = job_system.thread_api->get_thread_id();
+            if ((index % job_system.num_worker_threads) == thread_semaphore(key))
                 index = atomic_fetch_add(&job_system.next_wakeup, 1);
             job_system.thread_api->add_semaphore_count(job_system.semaphores[index % job_system.num_worker_threads], 1);
         }
@@ -361,12 +362,12 @@ static sl_job_counter *run_jobs(sl_job_decl *jobs, uint32_t num_jobs, sl_job_sta
             mpmc_queue_job_push(&job_system.priority_queue, &j);
         }
         if (jobs[i].pinned_index) {
-            const uint64_t key = jobs[i].pinned_index;
-            job_system.thread_api->add_semaphore_count(job_system.semaphores[sl_hashmap_get(job_system.p_allocator, job_system.thread_semaphores, key)], 1);
+            const uint32_t key = jobs[i].pinned_index;
+            job_system.thread_api->add_semaphore_count(job_system.semaphores[thread_semaphore(key)], 1);
         } else {
             uint32_t index = atomic_fetch_add(&job_system.next_wakeup, 1);
-            const uint64_t key = job_system.thread_api->get_thread_id();
-            if ((index % job_system.num_worker_threads) == sl_hashmap_get(job_system.p_allocator, job_system.thread_semaphores, key))
+            const uint32_t key = job_system.thread_api->get_thread_id();
+            if ((index % job_system.num_worker_threads) == thread_semaphore(key))
                 index = atomic_fetch_add(&job_system.next_wakeup, 1);
             job_system.thread_api->add_semaphore_count(job_system.semaphores[index % job_system.num_worker_threads], 1);
         }
@@ -471,7 +472,7 @@ struct sl_job_system_api *sl_create_job_system(sl_job_system_desc* p_desc)
 
     wait_queue_cells = (mpmc_queue_wait_cell*)sl_alloc(p_desc->p_allocator, sizeof(mpmc_queue_wait_cell) * MAX_FIBERS);
 
-    job_system.thread_semaphores = NULL;
+    job_system.thread_semaphores = (sl_flat_map_u32){ 0 };
     job_system.thread_api = sl_os_api->thread;
     job_system.num_fibers = p_desc->num_fibers;
     mpmc_queue_wait_init(&job_system.wait_queue, wait_queue_cells, p_desc->num_fibers);
@@ -489,8 +490,8 @@ struct sl_job_system_api *sl_create_job_system(sl_job_system_desc* p_desc)
         job_system.worker_threads[i] = sl_os_api->thread->create_os_thread(start_worker_thread, &wtd[i], 0, debug_name);
         sl_os_api->thread->set_thread_affinity(job_system.worker_threads[i], i);
         job_system.semaphores[i] = sl_os_api->thread->init_semaphore(0);
-        const uint64_t key = sl_os_api->thread->get_thread_id_from_thread(job_system.worker_threads[i]);
-        sl_hashmap_push(job_system.p_allocator, job_system.thread_semaphores, key, i);
+        const uint32_t key = sl_os_api->thread->get_thread_id_from_thread(job_system.worker_threads[i]);
+        sl_flat_map_u32_insert(job_system.p_allocator, &job_system.thread_semaphores, key, i);
 
     }
 
@@ -563,7 +564,7 @@ void sl_destroy_job_system()
 	sl_free(job_system.p_allocator, priority_queue_cells);
 	sl_free(job_system.p_allocator, wait_queue_cells);
 
-    sl_hashmap_free(job_system.p_allocator, job_system.thread_semaphores);
+    sl_flat_map_u32_free(job_system.p_allocator, &job_system.thread_semaphores);
 
     job_system.thread_api = NULL;
 
@@ -0,0 +1,83 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_NAME_HASH_INL
+#define STARLIGHT_NAME_HASH_INL
+
+#include "defines.h"
+
+/*
+ * Hashes of api and other well known names, identical whether computed at compile time or at runtime.
+ *
+ *   SL_NAME_HASH("literal")   for string literals and the *_API name defines. A constant expression
+ *                             in C++, and folded to a constant by the optimiser in C
+ *   sl_name_hash(str)         for names only known at runtime
+ *
+ * FNV-1a over the first SL_NAME_HASH_LENGTH bytes, padded with zeros so the macro never needs
+ * the length of the string. Longer names only hash their first SL_NAME_HASH_LENGTH bytes, so
+ * names have to be shorter than that (the api registry asserts it). SL_NAME_HASH reads the
+ * length from sizeof, so it only takes arrays, passing a pointer is a compile error.
+ */
+
+#define SL_NAME_HASH_LENGTH 64
+#define SL_NAME_HASH_BASIS 0xcbf29ce484222325ull
+#define SL_NAME_HASH_PRIME 0x100000001b3ull
+
+#define SL__NAME_CHAR(s, i) ((i) < sizeof(s) ? (uint64_t)(uint8_t)(s)[(i) < sizeof(s) ? (i) : 0] : 0)
+#define SL__NAME_STEP(h, s, i) (((h) ^ SL__NAME_CHAR(s, i)) * SL_NAME_HASH_PRIME)
+#define SL__NAME_HASH_8(h, s, i) \
+    SL__NAME_STEP(SL__NAME_STEP(SL__NAME_STEP(SL__NAME_STEP(SL__NAME_STEP(SL__NAME_STEP(SL__NAME_STEP(SL__NAME_STEP(h, \
+    s, (i)), s, (i) + 1), s, (i) + 2), s, (i) + 3), s, (i) + 4), s, (i) + 5), s, (i) + 6), s, (i) + 7)
+
+//Evaluates to 0, fails to compile when s is a pointer instead of an array
+#ifdef __cplusplus
+template <typename T> constexpr uint64_t sl__name_hash_require_array(const T &)
+{
+    static_assert(sizeof(T) == 0, "SL_NAME_HASH needs a string literal or char array, use sl_name_hash for pointers");
+    return 0;
+}
+template <size_t N> constexpr uint64_t sl__name_hash_require_array(const char (&)[N]) { return 0; }
+#define SL__NAME_HASH_REQUIRE_ARRAY(s) sl__name_hash_require_array(s)
+#elif defined(__GNUC__) || defined(__clang__)
+#define SL__NAME_HASH_REQUIRE_ARRAY(s) \
+    ((uint64_t)(0 * sizeof(struct { int sl_name_hash_needs_an_array : __builtin_types_compatible_p(__typeof__(s), __typeof__(&(s)[0])) ? -1 : 1; })))
+#else
+#define SL__NAME_HASH_REQUIRE_ARRAY(s) ((uint64_t)0)
+#endif
+
+#define SL_NAME_HASH(s) \
+    (SL__NAME_HASH_REQUIRE_ARRAY(s) + \
+    SL__NAME_HASH_8(SL__NAME_HASH_8(SL__NAME_HASH_8(SL__NAME_HASH_8(SL__NAME_HASH_8(SL__NAME_HASH_8(SL__NAME_HASH_8(SL__NAME_HASH_8(SL_NAME_HASH_BASIS, s, 0), s, 8), s, 16), s, 24), s, 32), s, 40), s, 48), s, 56))
+
+SL_FORCE_INLINE uint64_t sl_name_hash(const char *name)
+{
+    uint64_t hash = SL_NAME_HASH_BASIS;
+    uint8_t c = 1;
+    for (uint32_t i = 0; i < SL_NAME_HASH_LENGTH; ++i) {
+        c = c ? (uint8_t)name[i] : 0;
+        hash = (hash ^ c) * SL_NAME_HASH_PRIME;
+    }
+    return hash;
+}
+
+#endif //STARLIGHT_NAME_HASH_INL
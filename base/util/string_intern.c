@@ -0,0 +1,152 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include "string_intern.h"
+#include "data_structures/hash.inl"
+#include "data_structures/concurrent_map.inl"
+#include "memory/allocator.h"
+#include "memory/mem_tracker.h"
+#include "thread/atomics.inl"
+#include "thread/spinlock.inl"
+#include "util/assertions.inl"
+
+//Id -> string is a two level table so chunks never move under readers
+#define INTERN_CHUNK_SIZE 4096u
+#define INTERN_MAX_CHUNKS 4096u
+
+extern struct sl_allocator_api* sl_allocator_api; //allocator.c
+
+typedef struct string_intern
+{
+    sl_allocator allocator;
+
+    //wyhash of the string -> id. A string whose hash is taken by another string
+    //is rehashed with the next seed, so the map never holds two strings under one key
+    sl_concurrent_map map;
+
+    //Only touched while holding lock
+    sl_string_arena arena;
+    sl_spinlock lock;
+
+    const char** chunks[INTERN_MAX_CHUNKS];
+    sl_atomic_uint32_t count;
+}string_intern;
+
+static string_intern intern_table;
+
+SL_FORCE_INLINE const char* string_at(uint32_t id)
+{
+    return intern_table.chunks[id / INTERN_CHUNK_SIZE][id % INTERN_CHUNK_SIZE];
+}
+
+//Returns the id of str, or 0 with key set to where it would be added
+static uint32_t find_string(const char* str, size_t len, uint64_t* key)
+{
+    for (uint64_t seed = 0;; ++seed) {
+        const uint64_t hash = sl_wyhash(str, len, seed);
+        //Key 0 marks empty slots in the map
+        *key = hash ? hash : 1;
+
+        uint64_t id;
+        if (!sl_concurrent_map_get(&intern_table.map, *key, &id))
+            return 0;
+
+        const char* interned = string_at((uint32_t)id);
+        //strcmp stops at the end of the shorter string, memcmp would read past it
+        if (strcmp(interned, str) == 0)
+            return (uint32_t)id;
+    }
+}
+
+static uint32_t intern(const char* str)
+{
+    if (!str)
+        return 0;
+
+    const size_t len = strlen(str);
+    uint64_t key;
+    uint32_t id = find_string(str, len, &key);
+    if (id)
+        return id;
+
+    sl_spinlock_lock(&intern_table.lock);
+    //Another thread may have added it since the lookup
+    id = find_string(str, len, &key);
+    if (!id) {
+        if (!intern_table.map.allocator) {
+            intern_table.allocator = *sl_allocator_api->system;
+            intern_table.allocator.context = SL_MEMORY_CONTEXT_NONE;
+            sl_concurrent_map_init(&intern_table.map, &intern_table.allocator, 256);
+        }
+
+        //Id 0 is NULL, so the first string gets 1
+        id = atomic_load_explicit(&intern_table.count, memory_order_relaxed) + 1;
+        SL_ASSERT(id < INTERN_CHUNK_SIZE * INTERN_MAX_CHUNKS, "Too many interned strings");
+
+        const char*** chunk = &intern_table.chunks[id / INTERN_CHUNK_SIZE];
+        if (!*chunk)
+            *chunk = sl_alloc(&intern_table.allocator, INTERN_CHUNK_SIZE * sizeof(const char*));
+        (*chunk)[id % INTERN_CHUNK_SIZE] = sl_stralloc(&intern_table.allocator, &intern_table.arena, (char*)str, SL_FUNCTION, __FILE__, __LINE__);
+
+        //Publishing the key releases the string to readers
+        sl_concurrent_map_set(&intern_table.map, key, id);
+        atomic_store_explicit(&intern_table.count, id, memory_order_release);
+    }
+    sl_spinlock_unlock(&intern_table.lock);
+
+    return id;
+}
+
+static uint32_t find(const char* str)
+{
+    if (!str)
+        return 0;
+
+    uint64_t key;
+    return find_string(str, strlen(str), &key);
+}
+
+static const char* string(uint32_t id)
+{
+    return id ? string_at(id) : NULL;
+}
+
+static const char* intern_string(const char* str)
+{
+    return string(intern(str));
+}
+
+static uint32_t count(void)
+{
+    return atomic_load_explicit(&intern_table.count, memory_order_acquire);
+}
+
+static struct sl_string_intern_api string_intern_api = {
+        intern,
+        find,
+        string,
+        intern_string,
+        count
+};
+
+struct sl_string_intern_api* sl_string_intern_api = &string_intern_api;
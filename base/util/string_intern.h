@@ -0,0 +1,84 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef STARLIGHT_STRING_INTERN_H
+#define STARLIGHT_STRING_INTERN_H
+
+#include "defines.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Global table of interned strings. Every distinct string is copied once into a string arena
+ * and given a 32 bit id, so equal strings compare by id (or by pointer) instead of strcmp.
+ * Ids start at 1, 0 stands for NULL. Ids and pointers stay valid for the life of the process.
+ * Looking up a string that is already interned never locks.
+ */
+struct sl_string_intern_api
+{
+    /**
+    * @brief Interns a String, Copying it the First Time it is Seen
+    * @param str Null Terminated String, Doesn't Need to Outlive the Call
+    * @returns Id of the String, 0 if str is NULL
+    */
+    uint32_t (*intern)(const char* str);
+
+    /**
+    * @brief Finds the Id of a String Without Adding it
+    * @returns Id of the String, 0 if it was Never Interned
+    */
+    uint32_t (*find)(const char* str);
+
+    /**
+    * @brief Returns the Interned Copy of an Id, NULL for 0
+    */
+    const char* (*string)(uint32_t id);
+
+    /**
+    * @brief Interns a String and Returns its Interned Copy, Same as string(intern(str))
+    */
+    const char* (*intern_string)(const char* str);
+
+    /**
+    * @brief Number of Strings Interned so Far
+    */
+    uint32_t (*count)(void);
+};
+
+#define SL_STRING_INTERN_API "sl_string_intern_api"
+
+#ifdef LINKS_SL_BASE
+    extern struct sl_string_intern_api* sl_string_intern_api;
+#endif
+
+#ifdef __cplusplus
+    }
+#endif
+
+#define sl_intern(str) sl_string_intern_api->intern(str)
+
+#define sl_intern_string(str) sl_string_intern_api->intern_string(str)
+
+#endif //STARLIGHT_STRING_INTERN_H
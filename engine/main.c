@@ -27,6 +27,7 @@
 #include "memory/mem_tracker.h"
 #include "os/os.h"
 #include "logging/logger.h"
+#include "logging/file_sink.h"
 #include "registry/plugin_system.h"
 #include "util/path_util.inl"
 #include "register_engine_apis.h"
@@ -51,11 +52,18 @@ struct sl_render_backend_metal_api* render_api;
 struct sl_render_backend_vulkan_api* render_api;
 #endif
 
+//Log through a background writer thread instead of on the calling thread
+//#define ASYNC_LOGGING
+
+//Also write the log to this file, rotated at 16MB and gzipped
+//#define LOG_FILE_PATH "starlight.log"
+
 static sl_allocator job_alloc;
 static sl_allocator render_backend_alloc;
 static sl_allocator window_alloc;
 static sl_render_backend backend;
 static sl_swapchain* swapchain;
+static sl_logger* log_file;
 static os_window* main_window;
 
 typedef struct sl_run_state
@@ -99,6 +107,24 @@ sl_run_state* application_init(int argc, char** argv)
 
 	init_logger_system();
 
+#ifdef ASYNC_LOGGING
+	sl_logger_async_desc log_desc = {
+		.capacity = 4096,
+		.backpressure = sl_log_backpressure_block,
+	};
+	sl_logger_api->enable_async(&log_desc);
+#endif
+
+#ifdef LOG_FILE_PATH
+	sl_log_file_sink_desc log_file_desc = {
+		.path = LOG_FILE_PATH,
+		.max_file_size = SL_MEGABYTES(16),
+		.max_files = 4,
+		.compress = true,
+	};
+	log_file = sl_log_file_sink_api->open(&log_file_desc);
+#endif
+
 	sl_run_state* out = sl_alloc(sl_allocator_api->system, sizeof(sl_run_state));
 
 	job_alloc = sl_allocator_api->create_child(sl_allocator_api->system, "job_system");
@@ -133,7 +159,7 @@ sl_run_state* application_init(int argc, char** argv)
 
 	sl_plugin_system_api->check_hot_reload();
 
-	window_api = sl_global_api_registry->get(OS_WINDOW_API);
+	window_api = SL_REGISTRY_GET_API(sl_global_api_registry, OS_WINDOW_API);
 
 	window_alloc = sl_allocator_api->create_child(sl_allocator_api->system, "window_system");
 
@@ -145,9 +171,9 @@ sl_run_state* application_init(int argc, char** argv)
 
 	//Rendering!
 #ifdef METAL_API
-		render_api = sl_global_api_registry->get(RENDER_BACKEND_METAL_API);
+		render_api = SL_REGISTRY_GET_API(sl_global_api_registry, RENDER_BACKEND_METAL_API);
 #elif defined(VULKAN_API)
-	render_api = sl_global_api_registry->get(RENDER_BACKEND_VULKAN_API);
+	render_api = SL_REGISTRY_GET_API(sl_global_api_registry, RENDER_BACKEND_VULKAN_API);
 #endif
 
 	render_backend_alloc = sl_allocator_api->create_child(sl_allocator_api->system, "render_backend");
@@ -197,5 +223,12 @@ int main(int argc, char** argv)
 
 	sl_memory_tracker_api->check_for_leaks();
 
+	sl_logger_api->disable_async();
+
+	if (log_file)
+		sl_log_file_sink_api->close(log_file);
+
+	sl_shutdown_memory_tracker();
+
 	return 0;
 }
@@ -24,23 +24,29 @@
 
 #include "base/registry/api_registry.h"
 #include "base/logging/logger.h"
+#include "base/logging/file_sink.h"
 #include "base/memory/allocator.h"
 #include "base/memory/mem_tracker.h"
+#include "base/memory/scratch_allocator.h"
 #include "base/os/os.h"
 #include "base/registry/plugin_system.h"
 #include "base/thread/job_system.h"
 #include "base/util/sprintf.h"
+#include "base/util/string_intern.h"
 
 //must be called after job system creation
 void register_engine_apis(void)
 {
 	SL_REGISTRY_SET_API(SL_API_REGISTRY_API, sl_global_api_registry);
 	SL_REGISTRY_SET_API(SL_LOGGER_API, sl_logger_api);
+	SL_REGISTRY_SET_API(SL_LOG_FILE_SINK_API, sl_log_file_sink_api);
 	SL_REGISTRY_SET_API(SL_ALLOCATOR_API, sl_allocator_api);
 	SL_REGISTRY_SET_API(SL_MEM_TRACKER_API, sl_memory_tracker_api);
+	SL_REGISTRY_SET_API(SL_SCRATCH_ALLOCATOR_API, sl_scratch_allocator_api);
 	SL_REGISTRY_SET_API(SL_OS_API, sl_os_api);
 	SL_REGISTRY_SET_API(SL_PLUGIN_SYSTEM_API, sl_plugin_system_api);
 	SL_REGISTRY_SET_API(SL_JOB_SYSTEM_API, sl_get_job_system());
 	SL_REGISTRY_SET_API(SL_SPRINTF_API, sl_sprintf_api);
+	SL_REGISTRY_SET_API(SL_STRING_INTERN_API, sl_string_intern_api);
 }
 
@@ -144,7 +144,7 @@ PLUGIN_EXPORT int sl_load_plugin(struct sl_api_registry* reg, struct cr_plugin *
 	switch(operation) {
 	case CR_LOAD:
 		reg->set(OS_WINDOW_API, &macos_api, sizeof(struct os_window_api));
-		sl_logger_api = reg->get(SL_LOGGER_API);
+		sl_logger_api = SL_REGISTRY_GET_API(reg, SL_LOGGER_API);
 		SL_LOG_INFO("Testing Hot Reloading\n");
 		return 0;
 		break;
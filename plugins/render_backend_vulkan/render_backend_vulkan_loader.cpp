@@ -25,11 +25,13 @@
 #include "render_backend/render_backend.h"
 #include "render_backend_vulkan.h"
 #include "base/memory/allocator.h"
+#include "base/memory/scratch_allocator.h"
 #include "base/logging/logger.h"
 #include "base/util/assertions.inl"
 #include "base/data_structures/array.inl"
 
 static sl_logger_api* sl_logger_api;
+static sl_scratch_allocator_api* sl_scratch_allocator_api;
 static sl_allocator* backend_allocator;
 
 #define VOLK_IMPLEMENTATION
@@ -224,15 +226,15 @@ static VkBool32 VKAPI_PTR internal_debug_report_callback(
 	int32_t     messageCode = pCallbackData->messageIdNumber;
 	if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT)
 	{
-		SL_LOG_INFO("[%s] : %s (%i)\n", pLayerPrefix, pMessage, messageCode);
+		SL_LOG_INFO_CHANNEL(render, "[%s] : %s (%i)\n", pLayerPrefix, pMessage, messageCode);
 	}
 	else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT)
 	{
-		SL_LOG_DEBUG("[%s] : %s (%i)\n", pLayerPrefix, pMessage, messageCode);
+		SL_LOG_DEBUG_CHANNEL(render, "[%s] : %s (%i)\n", pLayerPrefix, pMessage, messageCode);
 	}
 	else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)
 	{
-		SL_LOG_ERROR("[%s] : %s (%i)\n", pLayerPrefix, pMessage, messageCode);
+		SL_LOG_ERROR_CHANNEL(render, "[%s] : %s (%i)\n", pLayerPrefix, pMessage, messageCode);
 		SL_ASSERT(false, "See previous message!^");
 	}
 
@@ -249,19 +251,19 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL internal_debug_report_callback(
 {
 	if (flags & VK_DEBUG_REPORT_INFORMATION_BIT_EXT)
 	{
-		SL_LOG_INFO("[%s] : %s (%i)\n", pLayerPrefix, pMessage, messageCode);
+		SL_LOG_INFO_CHANNEL(render, "[%s] : %s (%i)\n", pLayerPrefix, pMessage, messageCode);
 	}
 	else if (flags & VK_DEBUG_REPORT_WARNING_BIT_EXT)
 	{
-		SL_LOG_DEBUG("[%s] : %s (%i)\n", pLayerPrefix, pMessage, messageCode);
+		SL_LOG_DEBUG_CHANNEL(render, "[%s] : %s (%i)\n", pLayerPrefix, pMessage, messageCode);
 	}
 	else if (flags & VK_DEBUG_REPORT_PERFORMANCE_WARNING_BIT_EXT)
 	{
-		SL_LOG_DEBUG("[%s] : %s (%i)\n", pLayerPrefix, pMessage, messageCode);
+		SL_LOG_DEBUG_CHANNEL(render, "[%s] : %s (%i)\n", pLayerPrefix, pMessage, messageCode);
 	}
 	else if (flags & VK_DEBUG_REPORT_ERROR_BIT_EXT)
 	{
-		SL_LOG_ERROR("[%s] : %s (%i)\n", pLayerPrefix, pMessage, messageCode);
+		SL_LOG_ERROR_CHANNEL(render, "[%s] : %s (%i)\n", pLayerPrefix, pMessage, messageCode);
 		if (gAssertOnVkValidationError)
 		{
 			SL_ASSERT(false, "See last message!^");
@@ -406,26 +408,29 @@ static void vulkan_create_instance(vulkan_backend* vk, uint32_t instance_layer_c
 	// These are the extensions that we have loaded
 	const char*instance_extension_cache[MAX_INSTANCE_EXTENSIONS] = {};
 
+	sl_scratch_mark mark = sl_scratch_allocator_api->push();
+	sl_allocator* scratch = &mark.allocator;
+
 	uint32_t layer_count = 0;
 	uint32_t ext_count = 0;
 	vkEnumerateInstanceLayerProperties(&layer_count, NULL);
 	vkEnumerateInstanceExtensionProperties(NULL, &ext_count, NULL);
 
-	VkLayerProperties layers[layer_count];
+	VkLayerProperties* layers = (VkLayerProperties*)sl_alloc(scratch, layer_count * sizeof(*layers));
 	vkEnumerateInstanceLayerProperties(&layer_count, layers);
 
-	VkExtensionProperties exts[ext_count];
+	VkExtensionProperties* exts = (VkExtensionProperties*)sl_alloc(scratch, ext_count * sizeof(*exts));
 	vkEnumerateInstanceExtensionProperties(NULL, &ext_count, exts);
 
 #if VK_DEBUG_LOG_EXTENSIONS
 	for (uint32_t i = 0; i < layer_count; ++i)
 	{
-		SL_LOG_INFO("vkinstance-layer: %s\n", layers[i].layerName);
+		SL_LOG_INFO_CHANNEL(render, "vkinstance-layer: %s\n", layers[i].layerName);
 	}
 
 	for (uint32_t i = 0; i < ext_count; ++i)
 	{
-		SL_LOG_INFO("vkinstance-ext: %s\n", exts[i].extensionName);
+		SL_LOG_INFO_CHANNEL(render, "vkinstance-ext: %s\n", exts[i].extensionName);
 	}
 #endif
 
@@ -438,7 +443,7 @@ static void vulkan_create_instance(vulkan_backend* vk, uint32_t instance_layer_c
 	app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
 	app_info.apiVersion = VK_API_VERSION_1_2;
 
-	const char** layer_temp = NULL;
+	SL_SMALL_ARRAY(const char*, layer_temp, 8);
 	sl_array_set_capacity(vk->allocator, layer_temp, instance_layer_count);
 
 	// check to see if the layers are present
@@ -456,13 +461,13 @@ static void vulkan_create_instance(vulkan_backend* vk, uint32_t instance_layer_c
 		}
 		if (layer_found == false)
 		{
-			SL_LOG_ERROR("vkinstance-layer-missing: %s\n", instance_layers[i]);
+			SL_LOG_ERROR_CHANNEL(render, "vkinstance-layer-missing: %s\n", instance_layers[i]);
 		}
 	}
 
 	uint32_t                   extension_count = 0;
 	const uint32_t             initial_count = sizeof(vk_wanted_instance_extensions) / sizeof(vk_wanted_instance_extensions[0]);
-	const char** wanted_inst_extensions = NULL;
+	SL_SMALL_ARRAY(const char*, wanted_inst_extensions, 32);
 	sl_array_resize(vk->allocator, wanted_inst_extensions, initial_count);
 	for (uint32_t i = 0; i < initial_count; ++i)
 	{
@@ -476,7 +481,7 @@ static void vulkan_create_instance(vulkan_backend* vk, uint32_t instance_layer_c
 		const char* layer_name = layer_temp[i];
 		uint32_t    count = 0;
 		vkEnumerateInstanceExtensionProperties(layer_name, &count, NULL);
-		VkExtensionProperties* properties = count ? (VkExtensionProperties*)sl_alloc(vk->allocator, count * sizeof(*properties)) : NULL;
+		VkExtensionProperties* properties = count ? (VkExtensionProperties*)sl_alloc(scratch, count * sizeof(*properties)) : NULL;
 		SL_ASSERT(properties != NULL || count == 0, "Failed to allocate memory!");
 		vkEnumerateInstanceExtensionProperties(layer_name, &count, properties);
 		for (uint32_t j = 0; j < count; ++j)
@@ -498,7 +503,7 @@ static void vulkan_create_instance(vulkan_backend* vk, uint32_t instance_layer_c
 				}
 			}
 		}
-		SAFE_FREE(vk->allocator, (void*)properties);
+		SAFE_FREE(scratch, (void*)properties);
 	}
 
 	// Standalone extensions
@@ -508,7 +513,7 @@ static void vulkan_create_instance(vulkan_backend* vk, uint32_t instance_layer_c
 		vkEnumerateInstanceExtensionProperties(layer_name, &count, NULL);
 		if (count > 0)
 		{
-			VkExtensionProperties* properties = (VkExtensionProperties*)sl_alloc(vk->allocator, count * sizeof(*properties));
+			VkExtensionProperties* properties = (VkExtensionProperties*)sl_alloc(scratch, count * sizeof(*properties));
 			SL_ASSERT(properties != NULL, "Failed to allocate memory!");
 			vkEnumerateInstanceExtensionProperties(layer_name, &count, properties);
 			for (uint32_t j = 0; j < count; ++j)
@@ -529,7 +534,7 @@ static void vulkan_create_instance(vulkan_backend* vk, uint32_t instance_layer_c
 					}
 				}
 			}
-			SAFE_FREE(vk->allocator, (void*)properties);
+			SAFE_FREE(scratch, (void*)properties);
 		}
 	}
 
@@ -563,14 +568,14 @@ static void vulkan_create_instance(vulkan_backend* vk, uint32_t instance_layer_c
 		create_info.enabledExtensionCount = extension_count;
 		create_info.ppEnabledExtensionNames = instance_extension_cache;
 
-		SL_LOG_INFO("Creating VkInstance with %i enabled instance layers:\n", sl_array_size(layer_temp));
+		SL_LOG_INFO_CHANNEL(render, "Creating VkInstance with %i enabled instance layers:\n", sl_array_size(layer_temp));
 		for (int i = 0; i < sl_array_size(layer_temp); i++) {
-			SL_LOG_INFO("Layer %i: %s\n", i, layer_temp[i]);
+			SL_LOG_INFO_CHANNEL(render, "Layer %i: %s\n", i, layer_temp[i]);
 		}
-		SL_LOG_INFO("And with %i: enabled extensions:\n", extension_count);
+		SL_LOG_INFO_CHANNEL(render, "And with %i: enabled extensions:\n", extension_count);
 		for(int i = 0; i < extension_count; i++)
 		{
-			SL_LOG_INFO("Extension %i: %s\n", i+1, instance_extension_cache[i]);
+			SL_LOG_INFO_CHANNEL(render, "Extension %i: %s\n", i+1, instance_extension_cache[i]);
 		}
 
 
@@ -578,6 +583,7 @@ static void vulkan_create_instance(vulkan_backend* vk, uint32_t instance_layer_c
 		sl_array_free(vk->allocator, layer_temp);
 		sl_array_free(vk->allocator, wanted_inst_extensions);
 	}
+	sl_scratch_allocator_api->pop(&mark);
 #if defined(NX64)
 	loadExtensionsNX(vk->instance);
 #else
@@ -603,7 +609,7 @@ static void vulkan_create_instance(vulkan_backend* vk, uint32_t instance_layer_c
 			vk->instance, &create_info, &vk_allocation_callbacks, &(vk->debug_messenger));
 		if (VK_SUCCESS != res)
 		{
-			SL_LOG_ERROR("vkCreateDebugUtilsMessengerEXT failed - disabling Vulkan debug callbacks\n");
+			SL_LOG_ERROR_CHANNEL(render, "vkCreateDebugUtilsMessengerEXT failed - disabling Vulkan debug callbacks\n");
 		}
 	}
 #else
@@ -624,7 +630,7 @@ static void vulkan_create_instance(vulkan_backend* vk, uint32_t instance_layer_c
 			vk->instance, &create_info, &vk_allocation_callbacks, &(vk->debug_report));
 		if (VK_SUCCESS != res)
 		{
-			SL_LOG_ERROR("vkCreateDebugReportCallbackEXT failed - disabling Vulkan debug callbacks\n");
+			SL_LOG_ERROR_CHANNEL(render, "vkCreateDebugReportCallbackEXT failed - disabling Vulkan debug callbacks\n");
 		}
 	}
 #endif
@@ -640,7 +646,7 @@ static bool vulkan_init_common(vulkan_backend* vk)
 	VkResult vkRes = volkInitializeWithDispatchTables(vk);
 	if (vkRes != VK_SUCCESS)
 	{
-		SL_LOG_ERROR("Failed to initialize Vulkan\n");
+		SL_LOG_ERROR_CHANNEL(render, "Failed to initialize Vulkan\n");
 		nvapiExit();
 		agsExit();
 		return false;
@@ -663,7 +669,7 @@ static bool vulkan_init_common(vulkan_backend* vk)
 	VkResult vkRes = volkInitialize();
 	if (vkRes != VK_SUCCESS)
 	{
-		SL_LOG_ERROR("Failed to initialize Vulkan\n");
+		SL_LOG_ERROR_CHANNEL(render, "Failed to initialize Vulkan\n");
 		return false;
 	}
 #endif
@@ -710,7 +716,7 @@ bool vulkan_add_device(vulkan_backend* vk)
 
 		if (props.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
 		{
-			SL_LOG_INFO("Picking discrete GPU: %s\n", props.deviceName);
+			SL_LOG_INFO_CHANNEL(render, "Picking discrete GPU: %s\n", props.deviceName);
 			vk->active_physical_device = gpus[i];
 			break;
 		}
@@ -720,37 +726,40 @@ bool vulkan_add_device(vulkan_backend* vk)
 			VkPhysicalDeviceProperties props;
 			vkGetPhysicalDeviceProperties(gpus[0], &props);
 
-			SL_LOG_INFO("Picking fallback GPU: %s\n", props.deviceName);
+			SL_LOG_INFO_CHANNEL(render, "Picking fallback GPU: %s\n", props.deviceName);
 			vk->active_physical_device = gpus[0];
 		}
 
 	}
 
 	if(!vk->active_physical_device) {
-		SL_LOG_ERROR("Failed to find a suitable GPU!\n");
+		SL_LOG_ERROR_CHANNEL(render, "Failed to find a suitable GPU!\n");
 		return false;
 	}
 
+	sl_scratch_mark mark = sl_scratch_allocator_api->push();
+	sl_allocator* scratch = &mark.allocator;
+
 	uint32_t layer_count = 0;
 	uint32_t ext_count = 0;
 	vkEnumerateDeviceLayerProperties(vk->active_physical_device, &layer_count, NULL);
 	vkEnumerateDeviceExtensionProperties(vk->active_physical_device, NULL, &ext_count, NULL);
 
-	VkLayerProperties layers[layer_count];
+	VkLayerProperties* layers = (VkLayerProperties*)sl_alloc(scratch, layer_count * sizeof(*layers));
 	vkEnumerateDeviceLayerProperties(vk->active_physical_device, &layer_count, layers);
 
-	VkExtensionProperties exts[ext_count];
+	VkExtensionProperties* exts = (VkExtensionProperties*)sl_alloc(scratch, ext_count * sizeof(*exts));
 	vkEnumerateDeviceExtensionProperties(vk->active_physical_device, NULL, &ext_count, exts);
 
 #if VK_DEBUG_LOG_EXTENSIONS
 	for (uint32_t i = 0; i < layer_count; ++i)
 	{
-		SL_LOG_INFO("vkdevice-layer: %s\n", layers[i].layerName);
+		SL_LOG_INFO_CHANNEL(render, "vkdevice-layer: %s\n", layers[i].layerName);
 	}
 
 	for (uint32_t i = 0; i < ext_count; ++i)
 	{
-		SL_LOG_INFO("vkdevice-ext: %s\n", exts[i].extensionName);
+		SL_LOG_INFO_CHANNEL(render, "vkdevice-ext: %s\n", exts[i].extensionName);
 	}
 #endif
 
@@ -767,7 +776,7 @@ bool vulkan_add_device(vulkan_backend* vk)
 	{
 		const char*		layer_name = NULL;
 		uint32_t initial_count = sizeof(vk_wanted_device_extensions) / sizeof(vk_wanted_device_extensions[0]);
-		const char** wanted_device_extensions = NULL;
+		SL_SMALL_ARRAY(const char*, wanted_device_extensions, 32);
 		sl_array_resize(vk->allocator, wanted_device_extensions, initial_count);
 		for (uint32_t i = 0; i < initial_count; ++i)
 		{
@@ -778,7 +787,7 @@ bool vulkan_add_device(vulkan_backend* vk)
 		vkEnumerateDeviceExtensionProperties(vk->active_physical_device, layer_name, &count, NULL);
 		if (count > 0)
 		{
-			VkExtensionProperties* properties = (VkExtensionProperties*)sl_alloc(vk->allocator, count * sizeof(*properties));
+			VkExtensionProperties* properties = (VkExtensionProperties*)sl_alloc(scratch, count * sizeof(*properties));
 			SL_ASSERT(properties != NULL, "Failed to allocate memory!");
 			vkEnumerateDeviceExtensionProperties(vk->active_physical_device, layer_name, &count, properties);
 			for (uint32_t j = 0; j < count; ++j)
@@ -888,10 +897,11 @@ bool vulkan_add_device(vulkan_backend* vk)
 					}
 				}
 			}
-			SAFE_FREE(vk->allocator, properties);
+			SAFE_FREE(scratch, properties);
 		}
 		sl_array_free(vk->allocator, wanted_device_extensions);
 	}
+	sl_scratch_allocator_api->pop(&mark);
 
 #if !defined(VK_USE_DISPATCH_TABLES)
 	VkPhysicalDeviceFeatures2KHR gpuFeatures2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR };
@@ -1061,12 +1071,12 @@ bool vulkan_add_device(vulkan_backend* vk)
 
 		if (vk->active_gpu_settings.dedicated_allocations)
 		{
-			SL_LOG_INFO("Successfully loaded Dedicated Allocation extension\n");
+			SL_LOG_INFO_CHANNEL(render, "Successfully loaded Dedicated Allocation extension\n");
 		}
 
 		if(vk->active_gpu_settings.dynamic_rendering)
 		{
-			SL_LOG_INFO("Successfully loaded Dynamic Rendering extension\n");
+			SL_LOG_INFO_CHANNEL(render, "Successfully loaded Dynamic Rendering extension\n");
 		}
 
 #if VK_KHR_draw_indirect_count
@@ -1074,29 +1084,29 @@ bool vulkan_add_device(vulkan_backend* vk)
 		{
 			//PFN_VkCmdDrawIndirectCountKHR = vkCmdDrawIndirectCountKHR;
 			//PFN_VkCmdDrawIndexedIndirectCountKHR = vkCmdDrawIndexedIndirectCountKHR;
-			SL_LOG_INFO("Successfully loaded Draw Indirect extension\n");
+			SL_LOG_INFO_CHANNEL(render, "Successfully loaded Draw Indirect extension\n");
 		}
 		else if (vk->active_gpu_settings.amd_draw_indirect_count)
 #endif
 		{
 			//pfnVkCmdDrawIndirectCountKHR = vkCmdDrawIndirectCountAMD;
 			//pfnVkCmdDrawIndexedIndirectCountKHR = vkCmdDrawIndexedIndirectCountAMD;
-			SL_LOG_INFO("Successfully loaded AMD Draw Indirect extension\n");
+			SL_LOG_INFO_CHANNEL(render, "Successfully loaded AMD Draw Indirect extension\n");
 		}
 
 		if (vk->active_gpu_settings.amd_gcn_shader_extension)
 		{
-			SL_LOG_INFO("Successfully loaded AMD GCN Shader extension\n");
+			SL_LOG_INFO_CHANNEL(render, "Successfully loaded AMD GCN Shader extension\n");
 		}
 
 		if (vk->active_gpu_settings.descriptor_indexing)
 		{
-			SL_LOG_INFO("Successfully loaded Descriptor Indexing extension\n");
+			SL_LOG_INFO_CHANNEL(render, "Successfully loaded Descriptor Indexing extension\n");
 		}
 
 		if(vk->active_gpu_settings.buffer_device_address)
 		{
-			SL_LOG_INFO("Successfully loaded Buffer Device Address extension\n");
+			SL_LOG_INFO_CHANNEL(render, "Successfully loaded Buffer Device Address extension\n");
 		}
 
 		//TODO: RAYTRACING
@@ -1130,8 +1140,6 @@ bool vulkan_create_backend(sl_render_backend* backend, sl_allocator* allocator)
 	backend_allocator = allocator;
 	vk->allocator = allocator;
 
-	//TODO: Remove all alloca calls and use temp allocator instead.
-
 	if(!vulkan_init_common(vk))
 	{
 		return false;
@@ -1256,7 +1264,8 @@ PLUGIN_EXPORT int sl_load_plugin(struct sl_api_registry* reg, struct cr_plugin *
 		
 	case CR_LOAD:
 		reg->set(RENDER_BACKEND_VULKAN_API, &vulkan_api, sizeof(struct sl_render_backend_vulkan_api));
-		sl_logger_api = (struct sl_logger_api*)reg->get(SL_LOGGER_API);
+		sl_logger_api = (struct sl_logger_api*)SL_REGISTRY_GET_API(reg, SL_LOGGER_API);
+		sl_scratch_allocator_api = (struct sl_scratch_allocator_api*)SL_REGISTRY_GET_API(reg, SL_SCRATCH_ALLOCATOR_API);
 		return 0;
 		break;
 	case CR_UNLOAD:
@@ -52,7 +52,7 @@
 		VkResult vkres = (exp);                                                  \
 		if (VK_SUCCESS != vkres)                                                 \
 		{                                                                        \
-			SL_LOG_ERROR("%s: FAILED with VkResult: %d\n", #exp, vkres); \
+			SL_LOG_ERROR_CHANNEL(render, "%s: FAILED with VkResult: %d\n", #exp, vkres); \
 			SL_ASSERT(false, "See Last Error");                                                       \
 		}                                                                        \
 	}
@@ -82,6 +82,7 @@ int main()
 	sl_memory_tracker_api->destroy_context(alloc.context);
 	sl_memory_tracker_api->check_for_leaks();
 
+	sl_shutdown_memory_tracker();
 
 	return 0;
 }
@@ -0,0 +1,292 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+/*
+ * sl_alloc_timeline - reads the allocation stream written by sl_memory_tracker_api->begin_stream
+ *
+ *   sl_alloc_timeline [--bucket <ms>] <stream file>
+ *   sl_alloc_timeline [--bucket <ms>] --listen <socket path>    waits for a begin_stream(path, true) to connect
+ *
+ * Replays the events in order and prints, per time bucket, the allocs/frees/reallocs and the live heap,
+ * followed by a summary of the busiest call sites, contexts and threads.
+ */
+
+#include "base/defines.h"
+#include "base/memory/allocator.h"
+#include "base/memory/mem_tracker.h"
+#include "base/memory/alloc_stream.h"
+#include "base/data_structures/array.inl"
+#include "base/data_structures/hash.inl"
+#include "os/os.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SOCKET_READ_SIZE SL_KILOBYTES(64)
+#define MAX_LISTED_SITES 20
+
+typedef struct site_info {
+    const char *func;
+    const char *file;
+    uint32_t func_length;
+    uint32_t file_length;
+    uint32_t line;
+    uint64_t count;
+    uint64_t bytes;
+} site_info;
+
+typedef struct context_info {
+    const char *name;
+    uint32_t name_length;
+    uint64_t allocated;
+    uint64_t freed;
+} context_info;
+
+typedef struct thread_info {
+    uint32_t key;
+    uint64_t value;
+} thread_info;
+
+typedef struct bucket {
+    uint64_t index;
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t reallocs;
+    uint64_t allocated;
+    uint64_t freed;
+} bucket;
+
+static sl_allocator tool_alloc;
+
+static SL_ARRAY(site_info, sites);
+static SL_ARRAY(context_info, contexts);
+static thread_info *threads;
+
+static void print_bucket(const bucket *b, uint64_t bucket_ns, int64_t live)
+{
+    if (b->allocs || b->frees || b->reallocs)
+        printf("%10.3f %10llu %10llu %10llu %14llu %14llu %14lld\n", (double)(b->index * bucket_ns) / 1e6,
+               (unsigned long long)b->allocs, (unsigned long long)b->frees, (unsigned long long)b->reallocs,
+               (unsigned long long)b->allocated, (unsigned long long)b->freed, (long long)live);
+}
+
+static int compare_sites(const void *a, const void *b)
+{
+    const uint64_t x = (*(const site_info *const *)a)->bytes;
+    const uint64_t y = (*(const site_info *const *)b)->bytes;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static uint8_t *read_socket(const char *path, uint64_t *size)
+{
+    printf("Waiting for a stream on %s\n", path);
+    const sl_os_file file = sl_os_api->file_system->open_local_socket(path, true);
+    if (!file.valid)
+        return NULL;
+
+    SL_ARRAY(uint8_t, data) = NULL;
+    for (;;) {
+        const uint64_t at = sl_array_size(data);
+        (void) sl_array_addnptr(&tool_alloc, data, SOCKET_READ_SIZE);
+        const uint64_t n = sl_os_api->file_system->file_read(file, data + at, SOCKET_READ_SIZE);
+        sl_array_resize(&tool_alloc, data, at + n);
+        if (!n)
+            break;
+    }
+    sl_os_api->file_system->file_close(file);
+
+    *size = sl_array_size(data);
+    return data;
+}
+
+static uint8_t *map_stream(const char *path, uint64_t *size)
+{
+    const sl_os_file file = sl_os_api->file_system->open_file_read(path);
+    if (!file.valid)
+        return NULL;
+
+    *size = sl_os_api->file_system->file_size(file);
+    uint8_t *data = *size ? sl_os_api->file_system->map_file(file, 0, *size, false) : NULL;
+    sl_os_api->file_system->file_close(file);
+    return data;
+}
+
+static void replay(const uint8_t *data, uint64_t size, uint64_t bucket_ns)
+{
+    uint64_t total_allocs = 0, total_frees = 0, total_reallocs = 0, total_allocated = 0, total_freed = 0;
+    uint64_t end_time = 0, peak_time = 0;
+    int64_t live = 0, peak = 0;
+    bucket current = {0};
+
+    printf("%10s %10s %10s %10s %14s %14s %14s\n", "ms", "allocs", "frees", "reallocs", "allocated", "freed", "live");
+
+    uint64_t offset = sizeof(sl_alloc_stream_header);
+    while (offset + sizeof(sl_alloc_stream_record) <= size) {
+        const sl_alloc_stream_record *r = (const sl_alloc_stream_record *)(data + offset);
+        if (r->size < sizeof(sl_alloc_stream_record) || r->size > size - offset)
+            break;
+        offset += r->size;
+
+        if (r->type == sl_alloc_stream_site && r->size >= sizeof(sl_alloc_stream_site_record)) {
+            const sl_alloc_stream_site_record *s = (const sl_alloc_stream_site_record *)r;
+            while ((uint32_t)sl_array_size(sites) <= s->id)
+                sl_array_push(&tool_alloc, sites, (site_info){0});
+            const char *strings = (const char *)(s + 1);
+            sites[s->id] = (site_info){
+                    .func = strings,
+                    .func_length = s->func_length,
+                    .file = strings + s->func_length,
+                    .file_length = s->file_length,
+                    .line = s->line,
+            };
+        } else if (r->type == sl_alloc_stream_context && r->size >= sizeof(sl_alloc_stream_context_record)) {
+            const sl_alloc_stream_context_record *c = (const sl_alloc_stream_context_record *)r;
+            while ((uint32_t)sl_array_size(contexts) <= c->id)
+                sl_array_push(&tool_alloc, contexts, (context_info){0});
+            contexts[c->id].name = (const char *)(c + 1);
+            contexts[c->id].name_length = c->name_length;
+        } else if (r->type == sl_alloc_stream_event && r->size >= sizeof(sl_alloc_stream_event_record)) {
+            const sl_alloc_stream_event_record *e = (const sl_alloc_stream_event_record *)r;
+
+            const uint64_t index = e->time / bucket_ns;
+            if (index != current.index) {
+                print_bucket(&current, bucket_ns, live);
+                current = (bucket){.index = index};
+            }
+
+            if (e->old_size && e->new_size)
+                current.reallocs += 1, total_reallocs += 1;
+            else if (e->new_size)
+                current.allocs += 1, total_allocs += 1;
+            else
+                current.frees += 1, total_frees += 1;
+
+            current.allocated += e->new_size;
+            current.freed += e->old_size;
+            total_allocated += e->new_size;
+            total_freed += e->old_size;
+
+            live += (int64_t)e->new_size - (int64_t)e->old_size;
+            if (live > peak) {
+                peak = live;
+                peak_time = e->time;
+            }
+            end_time = e->time;
+
+            if (e->site < (uint32_t)sl_array_size(sites) && e->new_size) {
+                sites[e->site].count += 1;
+                sites[e->site].bytes += e->new_size;
+            }
+            if (e->context < (uint32_t)sl_array_size(contexts)) {
+                contexts[e->context].allocated += e->new_size;
+                contexts[e->context].freed += e->old_size;
+            }
+
+            const ptrdiff_t t = sl_hashmap_geti(&tool_alloc, threads, e->thread);
+            if (t >= 0)
+                threads[t].value += 1;
+            else
+                sl_hashmap_push(&tool_alloc, threads, e->thread, 1);
+        }
+    }
+    print_bucket(&current, bucket_ns, live);
+
+    printf("\n%.3f ms, %llu allocs, %llu frees, %llu reallocs\n", (double)end_time / 1e6,
+           (unsigned long long)total_allocs, (unsigned long long)total_frees, (unsigned long long)total_reallocs);
+    printf("%llu bytes allocated, %llu bytes freed, peak live %lld bytes at %.3f ms\n", (unsigned long long)total_allocated,
+           (unsigned long long)total_freed, (long long)peak, (double)peak_time / 1e6);
+    if (offset != size)
+        printf("Stream is truncated after %llu of %llu bytes\n", (unsigned long long)offset, (unsigned long long)size);
+
+    SL_ARRAY(site_info *, sorted) = NULL;
+    for (uint32_t i = 1; i < (uint32_t)sl_array_size(sites); ++i)
+        if (sites[i].count)
+            sl_array_push(&tool_alloc, sorted, sites + i);
+    qsort(sorted, sl_array_size(sorted), sizeof(site_info *), compare_sites);
+
+    printf("\nTop call sites by bytes allocated:\n");
+    for (uint32_t i = 0; i < (uint32_t)sl_array_size(sorted) && i < MAX_LISTED_SITES; ++i) {
+        const site_info *s = sorted[i];
+        printf("%14llu bytes %10llu allocs  %.*s (%.*s:%u)\n", (unsigned long long)s->bytes, (unsigned long long)s->count,
+               (int)s->func_length, s->func, (int)s->file_length, s->file, s->line);
+    }
+
+    printf("\nContexts:\n");
+    for (uint32_t i = 0; i < (uint32_t)sl_array_size(contexts); ++i) {
+        const context_info *c = contexts + i;
+        if (c->allocated || c->freed)
+            printf("%14llu allocated %14llu freed %14lld live  %.*s\n", (unsigned long long)c->allocated, (unsigned long long)c->freed,
+                   (long long)(c->allocated - c->freed), (int)c->name_length, c->name);
+    }
+
+    printf("\nThreads:\n");
+    for (ptrdiff_t i = 0; i < sl_hashmap_size(threads); ++i)
+        printf("%10u %10llu events\n", threads[i].key, (unsigned long long)threads[i].value);
+
+    sl_array_free(&tool_alloc, sorted);
+}
+
+int main(int argc, char **argv)
+{
+    sl_init_memory_tracker();
+
+    tool_alloc = *sl_allocator_api->system;
+    tool_alloc.context = SL_MEMORY_CONTEXT_NONE;
+
+    uint64_t bucket_ns = 1000000;
+    const char *path = NULL;
+    bool listen = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--bucket") == 0 && i + 1 < argc)
+            bucket_ns = (uint64_t)(atof(argv[++i]) * 1e6);
+        else if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc)
+            path = argv[++i], listen = true;
+        else
+            path = argv[i];
+    }
+
+    if (!path || !bucket_ns) {
+        fprintf(stderr, "usage: %s [--bucket <ms>] <stream file> | --listen <socket path>\n", argv[0]);
+        return 1;
+    }
+
+    uint64_t size = 0;
+    uint8_t *data = listen ? read_socket(path, &size) : map_stream(path, &size);
+    const sl_alloc_stream_header *header = (const sl_alloc_stream_header *)data;
+    if (!data || size < sizeof(*header) || header->magic != SL_ALLOC_STREAM_MAGIC || header->version != SL_ALLOC_STREAM_VERSION) {
+        fprintf(stderr, "Failed to read an allocation stream from %s\n", path);
+        return 1;
+    }
+
+    replay(data, size, bucket_ns);
+
+    if (listen)
+        sl_array_free(&tool_alloc, data);
+    else
+        sl_os_api->file_system->unmap_file(data, size);
+    sl_array_free(&tool_alloc, sites);
+    sl_array_free(&tool_alloc, contexts);
+    sl_hashmap_free(&tool_alloc, threads);
+    sl_shutdown_memory_tracker();
+    return 0;
+}
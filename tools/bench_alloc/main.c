@@ -0,0 +1,448 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+/*
+ * sl_bench_alloc - replays allocation traces against the sl_allocator backends
+ *
+ *   sl_bench_alloc                       synthetic trace
+ *   sl_bench_alloc replay <file>         trace recorded with sl_memory_tracker_api->begin_capture/end_capture
+ *   sl_bench_alloc record <file>         runs the synthetic workload through a tracked allocator and saves the capture
+ *
+ * Every trace is replayed on the main thread and then once per job system worker at the same time.
+ * Reports throughput, p50/p99 latency, peak RSS growth and fragmentation (share of that RSS growth
+ * not explained by live requested bytes).
+ */
+
+#include "base/defines.h"
+#include "base/memory/allocator.h"
+#include "base/memory/mem_tracker.h"
+#include "base/thread/job_system.h"
+#include "base/thread/atomics.inl"
+#include "base/data_structures/array.inl"
+#include "base/data_structures/hash.inl"
+#include "logging/logger.h"
+#include "os/os.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TRACE_MAGIC 0x54414c53 //"SLAT"
+#define TRACE_VERSION 1
+
+#define SYNTHETIC_OPS 1000000
+#define SYNTHETIC_MAX_LIVE 4096
+
+//How often the resident set is sampled during a replay
+#define RSS_SAMPLE_INTERVAL 1024
+
+#define MAX_WORKERS 64
+
+typedef struct trace_file_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+} trace_file_header;
+
+typedef enum bench_op_type {
+    bench_op_alloc = 0,
+    bench_op_free = 1,
+    bench_op_realloc = 2
+} bench_op_type;
+
+typedef struct bench_op {
+    uint32_t type;
+    uint32_t slot;
+    uint64_t size;
+} bench_op;
+
+typedef struct bench_trace {
+    SL_ARRAY(bench_op, ops);
+    uint32_t num_slots;
+} bench_trace;
+
+typedef struct bench_result {
+    uint64_t ops;
+    uint64_t nanoseconds;
+    uint64_t peak_live_bytes;
+    uint64_t peak_rss_growth;
+    SL_ARRAY(uint64_t, latencies);
+} bench_result;
+
+typedef struct bench_backend {
+    const char *name;
+    sl_allocator allocator;
+} bench_backend;
+
+typedef struct replay_job {
+    const bench_trace *trace;
+    sl_allocator *allocator;
+    bench_result result;
+} replay_job;
+
+typedef struct slot_map {
+    uint64_t key;
+    uint32_t value;
+} slot_map;
+
+//Bookkeeping memory of the benchmark itself, kept out of the tracker
+static sl_allocator bench_alloc;
+
+static uint64_t xorshift(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+//Mostly small sizes with a long tail, roughly what the engine allocates
+static uint64_t synthetic_size(uint64_t *rng)
+{
+    const uint64_t r = xorshift(rng) % 1000;
+    if (r < 700)
+        return 16 + xorshift(rng) % 240;
+    if (r < 950)
+        return 256 + xorshift(rng) % (SL_KILOBYTES(16) - 256);
+    if (r < 995)
+        return SL_KILOBYTES(16) + xorshift(rng) % SL_KILOBYTES(240);
+    return SL_KILOBYTES(256) + xorshift(rng) % SL_MEGABYTES(4);
+}
+
+static bench_trace make_synthetic_trace(void)
+{
+    bench_trace t = {0};
+    uint64_t rng = 0x9e3779b97f4a7c15ull;
+    SL_ARRAY(uint32_t, live) = NULL;
+    SL_ARRAY(uint64_t, live_size) = NULL;
+
+    for (uint32_t i = 0; i < SYNTHETIC_OPS; ++i) {
+        const uint64_t r = xorshift(&rng) % 100;
+        const size_t num_live = sl_array_size(live);
+
+        if (num_live && (r < 35 || num_live >= SYNTHETIC_MAX_LIVE)) {
+            const size_t index = xorshift(&rng) % num_live;
+            sl_array_push(&bench_alloc, t.ops, ((bench_op){ .type = bench_op_free, .slot = live[index] }));
+            sl_array_delswap(live, index);
+            sl_array_delswap(live_size, index);
+        } else if (num_live && r < 45) {
+            const size_t index = xorshift(&rng) % num_live;
+            live_size[index] += synthetic_size(&rng);
+            sl_array_push(&bench_alloc, t.ops, ((bench_op){ .type = bench_op_realloc, .slot = live[index], .size = live_size[index] }));
+        } else {
+            const uint64_t size = synthetic_size(&rng);
+            sl_array_push(&bench_alloc, t.ops, ((bench_op){ .type = bench_op_alloc, .slot = t.num_slots, .size = size }));
+            sl_array_push(&bench_alloc, live, t.num_slots);
+            sl_array_push(&bench_alloc, live_size, size);
+            t.num_slots += 1;
+        }
+    }
+
+    sl_array_free(&bench_alloc, live);
+    sl_array_free(&bench_alloc, live_size);
+    return t;
+}
+
+//Turns captured pointers into slot indices so the trace can be replayed against any allocator
+static bench_trace make_recorded_trace(const sl_memory_tracker_event *events, uint64_t count)
+{
+    bench_trace t = {0};
+    slot_map *slots = NULL;
+
+    for (uint64_t i = 0; i < count; ++i) {
+        const sl_memory_tracker_event *e = events + i;
+
+        if (e->old_size && e->new_size) {
+            uint32_t slot = sl_hashmap_get(&bench_alloc, slots, e->old_ptr);
+            if (!slot) {
+                slot = ++t.num_slots;
+                sl_array_push(&bench_alloc, t.ops, ((bench_op){ .type = bench_op_alloc, .slot = slot - 1, .size = e->new_size }));
+            } else {
+                (void) sl_hashmap_del(&bench_alloc, slots, e->old_ptr);
+                sl_array_push(&bench_alloc, t.ops, ((bench_op){ .type = bench_op_realloc, .slot = slot - 1, .size = e->new_size }));
+            }
+            sl_hashmap_push(&bench_alloc, slots, e->new_ptr, slot);
+        } else if (e->new_size) {
+            const uint32_t slot = ++t.num_slots;
+            sl_array_push(&bench_alloc, t.ops, ((bench_op){ .type = bench_op_alloc, .slot = slot - 1, .size = e->new_size }));
+            sl_hashmap_push(&bench_alloc, slots, e->new_ptr, slot);
+        } else if (e->old_size) {
+            //Frees of memory allocated before the capture started are dropped
+            const uint32_t slot = sl_hashmap_get(&bench_alloc, slots, e->old_ptr);
+            if (slot) {
+                sl_array_push(&bench_alloc, t.ops, ((bench_op){ .type = bench_op_free, .slot = slot - 1 }));
+                (void) sl_hashmap_del(&bench_alloc, slots, e->old_ptr);
+            }
+        }
+    }
+
+    sl_hashmap_free(&bench_alloc, slots);
+    return t;
+}
+
+static bool write_trace_file(const char *path, const sl_memory_tracker_event *events, uint64_t count)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return false;
+
+    const trace_file_header header = { .magic = TRACE_MAGIC, .version = TRACE_VERSION, .count = count };
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && fwrite(events, sizeof(*events), count, f) == count;
+    fclose(f);
+    return ok;
+}
+
+static bool read_trace_file(const char *path, bench_trace *out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+
+    trace_file_header header;
+    sl_memory_tracker_event *events = NULL;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 && header.magic == TRACE_MAGIC && header.version == TRACE_VERSION;
+    if (ok) {
+        sl_array_resize(&bench_alloc, events, header.count);
+        ok = fread(events, sizeof(*events), header.count, f) == header.count;
+    }
+    fclose(f);
+
+    if (ok)
+        *out = make_recorded_trace(events, header.count);
+    sl_array_free(&bench_alloc, events);
+    return ok;
+}
+
+static void record_synthetic_trace(const char *path)
+{
+    const bench_trace synthetic = make_synthetic_trace();
+    sl_allocator tracked = sl_allocator_api->create_child(sl_allocator_api->system, "bench_record");
+    void **slots = calloc(synthetic.num_slots, sizeof(void *));
+
+    sl_memory_tracker_api->begin_capture();
+    for (size_t i = 0; i < sl_array_size(synthetic.ops); ++i) {
+        const bench_op *op = synthetic.ops + i;
+        if (op->type == bench_op_free)
+            slots[op->slot] = sl_free(&tracked, slots[op->slot]);
+        else
+            slots[op->slot] = sl_realloc(&tracked, slots[op->slot], op->size);
+    }
+    sl_memory_tracker_event *events = sl_memory_tracker_api->end_capture(&bench_alloc);
+
+    for (uint32_t i = 0; i < synthetic.num_slots; ++i)
+        sl_free(&tracked, slots[i]);
+    free(slots);
+    sl_allocator_api->destroy_child(&tracked);
+
+    if (write_trace_file(path, events, sl_array_size(events)))
+        printf("Recorded %llu events to %s\n", (unsigned long long)sl_array_size(events), path);
+    else
+        printf("Failed to write %s\n", path);
+    sl_array_free(&bench_alloc, events);
+}
+
+static void replay(const bench_trace *trace, sl_allocator *a, bool time_ops, bench_result *result)
+{
+    void **slots = calloc(trace->num_slots, sizeof(void *));
+    uint64_t *sizes = calloc(trace->num_slots, sizeof(uint64_t));
+    const uint64_t num_ops = sl_array_size(trace->ops);
+    const uint64_t rss_start = sl_os_api->info->resident_memory();
+    uint64_t live = 0;
+
+    if (time_ops)
+        sl_array_resize(&bench_alloc, result->latencies, num_ops);
+
+    const uint64_t start = sl_os_api->info->nanoseconds();
+    for (uint64_t i = 0; i < num_ops; ++i) {
+        const bench_op *op = trace->ops + i;
+        const uint64_t t0 = time_ops ? sl_os_api->info->nanoseconds() : 0;
+
+        if (op->type == bench_op_free)
+            slots[op->slot] = a->realloc(a, slots[op->slot], 0, 0, SL_FUNCTION, __FILE__, __LINE__);
+        else
+            slots[op->slot] = a->realloc(a, slots[op->slot], op->size, 0, SL_FUNCTION, __FILE__, __LINE__);
+
+        if (time_ops) {
+            result->latencies[i] = sl_os_api->info->nanoseconds() - t0;
+
+            live += (op->type == bench_op_free ? 0 : op->size) - sizes[op->slot];
+            sizes[op->slot] = op->type == bench_op_free ? 0 : op->size;
+            if (live > result->peak_live_bytes)
+                result->peak_live_bytes = live;
+
+            if ((i % RSS_SAMPLE_INTERVAL) == 0) {
+                const uint64_t rss = sl_os_api->info->resident_memory();
+                if (rss > rss_start && rss - rss_start > result->peak_rss_growth)
+                    result->peak_rss_growth = rss - rss_start;
+            }
+        }
+    }
+    const uint64_t end = sl_os_api->info->nanoseconds();
+
+    for (uint32_t i = 0; i < trace->num_slots; ++i) {
+        if (slots[i])
+            a->realloc(a, slots[i], 0, 0, SL_FUNCTION, __FILE__, __LINE__);
+    }
+
+    if (!time_ops) {
+        result->ops = num_ops;
+        result->nanoseconds = end - start;
+    }
+
+    free(slots);
+    free(sizes);
+}
+
+static void replay_task(void *data)
+{
+    replay_job *job = data;
+    replay(job->trace, job->allocator, false, &job->result);
+    replay(job->trace, job->allocator, true, &job->result);
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t *)a;
+    const uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_result(const char *backend, const char *mode, bench_result *results, uint32_t count)
+{
+    bench_result total = {0};
+    uint64_t wall = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        total.ops += results[i].ops;
+        total.peak_live_bytes += results[i].peak_live_bytes;
+        if (results[i].peak_rss_growth > total.peak_rss_growth)
+            total.peak_rss_growth = results[i].peak_rss_growth;
+        if (results[i].nanoseconds > wall)
+            wall = results[i].nanoseconds;
+        for (size_t j = 0; j < sl_array_size(results[i].latencies); ++j)
+            sl_array_push(&bench_alloc, total.latencies, results[i].latencies[j]);
+    }
+
+    const size_t n = sl_array_size(total.latencies);
+    qsort(total.latencies, n, sizeof(uint64_t), compare_u64);
+    const uint64_t p50 = n ? total.latencies[n / 2] : 0;
+    const uint64_t p99 = n ? total.latencies[(n * 99) / 100] : 0;
+    const double throughput = wall ? (double)total.ops / ((double)wall / 1e9) : 0.0;
+    const double fragmentation = total.peak_rss_growth > total.peak_live_bytes
+            ? 1.0 - (double)total.peak_live_bytes / (double)total.peak_rss_growth : 0.0;
+
+    printf("%-12s %-8s %14.0f %10llu %10llu %12.2f %12.2f %8.1f%%\n", backend, mode, throughput,
+           (unsigned long long)p50, (unsigned long long)p99,
+           (double)total.peak_rss_growth / (1024.0 * 1024.0), (double)total.peak_live_bytes / (1024.0 * 1024.0),
+           fragmentation * 100.0);
+
+    sl_array_free(&bench_alloc, total.latencies);
+    for (uint32_t i = 0; i < count; ++i)
+        sl_array_free(&bench_alloc, results[i].latencies);
+}
+
+static void run_backend(struct sl_job_system_api *job_api, uint32_t num_workers, const bench_trace *trace, bench_backend *backend)
+{
+    replay_job single = { .trace = trace, .allocator = &backend->allocator };
+    replay_task(&single);
+    print_result(backend->name, "single", &single.result, 1);
+
+    replay_job jobs[MAX_WORKERS] = {0};
+    sl_job_decl decls[MAX_WORKERS] = {0};
+    for (uint32_t i = 0; i < num_workers; ++i) {
+        jobs[i] = (replay_job){ .trace = trace, .allocator = &backend->allocator };
+        decls[i] = (sl_job_decl){ .task = replay_task, .data = jobs + i, .priority = sl_normal_priority };
+    }
+
+    sl_job_counter *counter = job_api->run_jobs(decls, num_workers, sl_ss_extended);
+    job_api->wait_for_counter_os(counter, 0.001);
+
+    bench_result results[MAX_WORKERS];
+    for (uint32_t i = 0; i < num_workers; ++i)
+        results[i] = jobs[i].result;
+    print_result(backend->name, "workers", results, num_workers);
+}
+
+int main(int argc, char **argv)
+{
+    sl_init_memory_tracker();
+
+    init_logger_system();
+
+    bench_alloc = *sl_allocator_api->system;
+    bench_alloc.context = SL_MEMORY_CONTEXT_NONE;
+
+    if (argc == 3 && strcmp(argv[1], "record") == 0) {
+        record_synthetic_trace(argv[2]);
+        return 0;
+    }
+
+    bench_trace trace;
+    if (argc == 3 && strcmp(argv[1], "replay") == 0) {
+        if (!read_trace_file(argv[2], &trace)) {
+            printf("Failed to read trace %s\n", argv[2]);
+            return 1;
+        }
+    } else {
+        trace = make_synthetic_trace();
+    }
+
+    sl_allocator job_alloc = sl_allocator_api->create_child(sl_allocator_api->system, "job_system");
+    uint32_t num_workers = sl_os_api->info->num_logical_cores() - 1;
+    if (num_workers > MAX_WORKERS)
+        num_workers = MAX_WORKERS;
+
+    sl_job_system_desc desc = {
+        .p_allocator = &job_alloc,
+        .num_fibers = 128,
+        .num_threads = num_workers,
+        .extended_stack_size = SL_KILOBYTES(512),
+        .normal_stack_size = SL_KILOBYTES(64),
+    };
+
+    sl_os_api->thread->set_thread_name("Main Thread");
+
+    struct sl_job_system_api *job_api = sl_create_job_system(&desc);
+
+    bench_backend backends[] = {
+        { "system", bench_alloc },
+        { "tracked", sl_allocator_api->create_child(sl_allocator_api->system, "bench_tracked") },
+        { "huge_page", sl_allocator_api->create_huge_page_child(sl_allocator_api->system, "bench_huge_page", SL_KILOBYTES(256)) },
+    };
+
+    printf("%llu ops, %u slots, %u workers\n", (unsigned long long)sl_array_size(trace.ops), trace.num_slots, num_workers);
+    printf("%-12s %-8s %14s %10s %10s %12s %12s %9s\n", "backend", "mode", "ops/s", "p50 ns", "p99 ns", "rss MB", "live MB", "frag");
+
+    for (uint32_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i)
+        run_backend(job_api, num_workers, &trace, backends + i);
+
+    sl_destroy_job_system();
+
+    sl_allocator_api->destroy_child(&backends[1].allocator);
+    sl_allocator_api->destroy_child(&backends[2].allocator);
+    sl_allocator_api->destroy_child(&job_alloc);
+    sl_array_free(&bench_alloc, trace.ops);
+    sl_shutdown_memory_tracker();
+
+    return 0;
+}
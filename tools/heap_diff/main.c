@@ -0,0 +1,207 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+/*
+ * sl_heap_diff - turns heap snapshots written by sl_memory_tracker_api->write_snapshot into
+ * folded stacks (one "frame;frame;frame bytes" line per call site) for flamegraph.pl/speedscope
+ *
+ *   sl_heap_diff <snapshot>                   live bytes per call site
+ *   sl_heap_diff <before> <after>             growth between the two snapshots
+ *   sl_heap_diff <before> <after> --shrink    memory released between the two snapshots
+ *
+ * Each stack starts at the root memory context, then the captured call stack (outermost first)
+ * and ends with the func (file:line) the allocation was traced at.
+ */
+
+#include "base/defines.h"
+#include "base/memory/allocator.h"
+#include "base/memory/mem_tracker.h"
+#include "base/memory/heap_snapshot.h"
+#include "base/data_structures/array.inl"
+#include "base/data_structures/hash.inl"
+#include "util/path_util.inl"
+#include "os/os.h"
+
+#include <stdio.h>
+
+#define MAX_CONTEXT_DEPTH 64
+#define MAX_KEY_LENGTH 8192
+
+typedef struct snapshot {
+    uint8_t *data;
+    const sl_heap_snapshot_header *header;
+    const sl_heap_snapshot_context *contexts;
+    const sl_heap_snapshot_trace *traces;
+    const sl_heap_snapshot_stack *stacks;
+    const sl_heap_snapshot_frame *frames;
+    const sl_heap_snapshot_live *live;
+    const char *strings;
+} snapshot;
+
+typedef struct folded_map {
+    char *key;
+    int64_t value;
+} folded_map;
+
+static sl_allocator tool_alloc;
+
+static bool load_snapshot(const char *path, snapshot *s)
+{
+    sl_os_file file = sl_os_api->file_system->open_file_read(path);
+    if (!file.valid)
+        return false;
+
+    const uint64_t size = sl_os_api->file_system->file_size(file);
+    s->data = sl_alloc(&tool_alloc, size);
+    const bool read = sl_os_api->file_system->file_read(file, s->data, size) == size;
+    sl_os_api->file_system->file_close(file);
+
+    const sl_heap_snapshot_header *h = (const sl_heap_snapshot_header *)s->data;
+    if (!read || size < sizeof(*h) || h->magic != SL_HEAP_SNAPSHOT_MAGIC || h->version != SL_HEAP_SNAPSHOT_VERSION)
+        return false;
+
+    const uint64_t expected = sizeof(*h) + h->num_contexts * sizeof(sl_heap_snapshot_context)
+                              + h->num_traces * sizeof(sl_heap_snapshot_trace) + h->num_stacks * sizeof(sl_heap_snapshot_stack)
+                              + h->num_frames * sizeof(sl_heap_snapshot_frame) + h->num_live * sizeof(sl_heap_snapshot_live)
+                              + h->strings_size;
+    if (size != expected)
+        return false;
+
+    const uint8_t *p = s->data + sizeof(*h);
+    s->header = h;
+    s->contexts = (const sl_heap_snapshot_context *)p;
+    p += h->num_contexts * sizeof(sl_heap_snapshot_context);
+    s->traces = (const sl_heap_snapshot_trace *)p;
+    p += h->num_traces * sizeof(sl_heap_snapshot_trace);
+    s->stacks = (const sl_heap_snapshot_stack *)p;
+    p += h->num_stacks * sizeof(sl_heap_snapshot_stack);
+    s->frames = (const sl_heap_snapshot_frame *)p;
+    p += h->num_frames * sizeof(sl_heap_snapshot_frame);
+    s->live = (const sl_heap_snapshot_live *)p;
+    p += h->num_live * sizeof(sl_heap_snapshot_live);
+    s->strings = (const char *)p;
+    return true;
+}
+
+//Appends a frame, replacing the characters the folded format uses as separators
+static uint32_t append_frame(char *key, uint32_t length, const char *frame)
+{
+    if (length && length < MAX_KEY_LENGTH - 1)
+        key[length++] = ';';
+    for (const char *c = frame; *c && length < MAX_KEY_LENGTH - 1; ++c)
+        key[length++] = *c == ';' ? ':' : *c == ' ' ? '_' : *c;
+    key[length] = '\0';
+    return length;
+}
+
+static void fold_trace(const snapshot *s, const sl_heap_snapshot_trace *t, char *key)
+{
+    uint32_t length = 0;
+    key[0] = '\0';
+
+    uint32_t chain[MAX_CONTEXT_DEPTH];
+    uint32_t depth = 0;
+    for (uint32_t c = t->context; c < s->header->num_contexts && depth < MAX_CONTEXT_DEPTH;) {
+        chain[depth++] = c;
+        const uint32_t parent = s->contexts[c].parent;
+        if (parent == c || parent == SL_MEMORY_CONTEXT_NONE)
+            break;
+        c = parent;
+    }
+    while (depth)
+        length = append_frame(key, length, s->strings + s->contexts[chain[--depth]].name);
+
+    if (t->stack_id && t->stack_id < s->header->num_stacks) {
+        const sl_heap_snapshot_stack *stack = s->stacks + t->stack_id;
+        for (uint32_t i = stack->depth; i > 0; --i) {
+            const uint32_t frame = stack->offset + i - 1;
+            if (frame < s->header->num_frames)
+                length = append_frame(key, length, s->strings + s->frames[frame].symbol);
+        }
+    }
+
+    char site[512];
+    snprintf(site, sizeof(site), "%s (%s:%u)", s->strings + t->func, sl_get_file_name(s->strings + t->file), t->line);
+    append_frame(key, length, site);
+}
+
+static void accumulate(folded_map **map, const snapshot *s, int64_t sign)
+{
+    char key[MAX_KEY_LENGTH];
+    for (uint32_t i = 1; i < s->header->num_traces; ++i) {
+        const sl_heap_snapshot_trace *t = s->traces + i;
+        if (!t->amount_allocated)
+            continue;
+
+        fold_trace(s, t, key);
+        const ptrdiff_t index = sl_shgeti(&tool_alloc, *map, key);
+        if (index >= 0)
+            (*map)[index].value += sign * (int64_t)t->amount_allocated;
+        else
+            sl_shput(&tool_alloc, *map, key, sign * (int64_t)t->amount_allocated);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    sl_init_memory_tracker();
+
+    tool_alloc = *sl_allocator_api->system;
+    tool_alloc.context = SL_MEMORY_CONTEXT_NONE;
+
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "usage: %s <snapshot> | <before> <after> [--shrink]\n", argv[0]);
+        return 1;
+    }
+
+    const bool shrink = argc == 4 && strcmp(argv[3], "--shrink") == 0;
+    folded_map *map = NULL;
+    sl_sh_new_strdup(&tool_alloc, map);
+
+    snapshot before = {0}, after = {0};
+    if (!load_snapshot(argv[argc >= 3 ? 2 : 1], &after)) {
+        fprintf(stderr, "Failed to read snapshot %s\n", argv[argc >= 3 ? 2 : 1]);
+        return 1;
+    }
+    accumulate(&map, &after, 1);
+
+    if (argc >= 3) {
+        if (!load_snapshot(argv[1], &before)) {
+            fprintf(stderr, "Failed to read snapshot %s\n", argv[1]);
+            return 1;
+        }
+        accumulate(&map, &before, -1);
+    }
+
+    for (ptrdiff_t i = 0; i < sl_shlen(map); ++i) {
+        const int64_t bytes = shrink ? -map[i].value : map[i].value;
+        if (bytes > 0)
+            printf("%s %lld\n", map[i].key, (long long)bytes);
+    }
+
+    sl_shfree(&tool_alloc, map);
+    sl_free(&tool_alloc, before.data);
+    sl_free(&tool_alloc, after.data);
+    sl_shutdown_memory_tracker();
+    return 0;
+}
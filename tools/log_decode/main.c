@@ -0,0 +1,223 @@
+// MIT License
+//
+// Copyright (c) 2022-2023 Jonah Goldsmith
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+/*
+ * sl_log_decode - prints a binary log written with sl_logger_async_desc.binary and a binary_path
+ *
+ *   sl_log_decode [--level <debug|info|error>] <log file>
+ *
+ * Formats every message with the format and arguments stored in the log and prints them ordered by time,
+ * with the same prologue the loggers get. --level leaves out messages below the given level.
+ */
+
+#include "base/defines.h"
+#include "base/memory/allocator.h"
+#include "base/memory/mem_tracker.h"
+#include "base/logging/logger.h"
+#include "base/logging/log_binary.h"
+#include "base/data_structures/array.inl"
+#include "base/data_structures/hash.inl"
+#include "base/util/path_util.inl"
+#include "os/os.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct site_info {
+    const char *format;
+    const char *file;
+    uint32_t format_length;
+    uint32_t file_length;
+    uint32_t line;
+    uint32_t level;
+} site_info;
+
+typedef struct thread_info {
+    uint32_t key;
+    uint64_t value;
+} thread_info;
+
+//A message record and where it was in the file, so equal times keep the file order
+typedef struct message_info {
+    const sl_log_binary_message_record *record;
+    uint64_t offset;
+} message_info;
+
+static sl_allocator tool_alloc;
+
+static SL_ARRAY(site_info, sites);
+//Thread id -> offset of its thread record
+static thread_info *threads;
+
+static uint8_t *map_log(const char *path, uint64_t *size)
+{
+    const sl_os_file file = sl_os_api->file_system->open_file_read(path);
+    if (!file.valid)
+        return NULL;
+
+    *size = sl_os_api->file_system->file_size(file);
+    uint8_t *data = *size ? sl_os_api->file_system->map_file(file, 0, *size, false) : NULL;
+    sl_os_api->file_system->file_close(file);
+    return data;
+}
+
+static int compare_messages(const void *a, const void *b)
+{
+    const message_info *x = (const message_info *)a;
+    const message_info *y = (const message_info *)b;
+    if (x->record->time != y->record->time)
+        return x->record->time < y->record->time ? -1 : 1;
+    return x->offset < y->offset ? -1 : x->offset > y->offset ? 1 : 0;
+}
+
+static void decode(const uint8_t *data, uint64_t size, enum sl_log_level min_level)
+{
+    const sl_log_binary_header *header = (const sl_log_binary_header *)data;
+    SL_ARRAY(message_info, messages) = NULL;
+
+    uint64_t offset = sizeof(sl_log_binary_header);
+    while (offset + sizeof(sl_log_binary_record) <= size) {
+        const sl_log_binary_record *r = (const sl_log_binary_record *)(data + offset);
+        if (r->size < sizeof(sl_log_binary_record) || r->size > size - offset)
+            break;
+
+        if (r->type == sl_log_binary_site && r->size >= sizeof(sl_log_binary_site_record)) {
+            const sl_log_binary_site_record *s = (const sl_log_binary_site_record *)r;
+            while ((uint32_t)sl_array_size(sites) <= s->id)
+                sl_array_push(&tool_alloc, sites, (site_info){0});
+            const char *strings = (const char *)(s + 1);
+            sites[s->id] = (site_info){
+                    .format = strings,
+                    .format_length = s->format_length,
+                    .file = strings + s->format_length,
+                    .file_length = s->file_length,
+                    .line = s->line,
+                    .level = s->level,
+            };
+        } else if (r->type == sl_log_binary_thread && r->size >= sizeof(sl_log_binary_thread_record)) {
+            const sl_log_binary_thread_record *t = (const sl_log_binary_thread_record *)r;
+            sl_hashmap_push(&tool_alloc, threads, t->id, offset);
+        } else if (r->type == sl_log_binary_message && r->size >= sizeof(sl_log_binary_message_record)) {
+            const message_info m = {.record = (const sl_log_binary_message_record *)r, .offset = offset};
+            sl_array_push(&tool_alloc, messages, m);
+        }
+        offset += r->size;
+    }
+
+    qsort(messages, sl_array_size(messages), sizeof(message_info), compare_messages);
+
+    const char *level_strings[3] = {"[DEBUG]: ", "[INFO]: ", "[ERROR]: "};
+    SL_ARRAY(char, format) = NULL;
+    SL_ARRAY(char, text) = NULL;
+    for (uint64_t i = 0; i < sl_array_size(messages); ++i) {
+        const sl_log_binary_message_record *m = messages[i].record;
+        if (m->site >= (uint32_t)sl_array_size(sites) || !sites[m->site].format)
+            continue;
+        const site_info *s = sites + m->site;
+        if (s->level < (uint32_t)min_level || s->level > sl_log_level_error)
+            continue;
+
+        //Formats in the file aren't NUL terminated
+        sl_array_resize(&tool_alloc, format, s->format_length + 1);
+        sl_memcpy(format, s->format, s->format_length);
+        format[s->format_length] = 0;
+
+        const uint32_t args_size = m->args_size <= m->record.size - sizeof(*m) ? m->args_size : 0;
+        const int length = sl_logger_api->format_binary(NULL, 0, format, m + 1, args_size);
+        sl_array_resize(&tool_alloc, text, length + 1);
+        sl_logger_api->format_binary(text, length + 1, format, m + 1, args_size);
+
+        const char *thread_name = "";
+        uint32_t thread_name_length = 0;
+        const ptrdiff_t t = sl_hashmap_geti(&tool_alloc, threads, m->thread);
+        if (t >= 0) {
+            const sl_log_binary_thread_record *tr = (const sl_log_binary_thread_record *)(data + threads[t].value);
+            thread_name = (const char *)(tr + 1);
+            thread_name_length = tr->name_length;
+        }
+
+        const time_t wall_time = (time_t)(header->start_wall_time + (int64_t)((m->time - header->start_time) / 1000000000ull));
+        const struct tm *timeinfo = localtime(&wall_time);
+
+        //sl_get_file_name needs a NUL terminated path, so the file name is cut out of the record by hand
+        const char *file = s->file;
+        uint32_t file_length = s->file_length;
+        for (uint32_t c = 0; c < s->file_length; ++c) {
+            if (s->file[c] == '/' || s->file[c] == '\\') {
+                file = s->file + c + 1;
+                file_length = s->file_length - c - 1;
+            }
+        }
+
+        printf("[%d-%d-%d] %.*s:%u [%.*s] %s%s", timeinfo->tm_mon + 1, timeinfo->tm_mday, timeinfo->tm_year + 1900,
+               (int)file_length, file, s->line, (int)thread_name_length, thread_name, level_strings[s->level], text);
+    }
+
+    if (offset != size)
+        fprintf(stderr, "Log is truncated after %llu of %llu bytes\n", (unsigned long long)offset, (unsigned long long)size);
+
+    sl_array_free(&tool_alloc, format);
+    sl_array_free(&tool_alloc, text);
+    sl_array_free(&tool_alloc, messages);
+}
+
+int main(int argc, char **argv)
+{
+    sl_init_memory_tracker();
+
+    tool_alloc = *sl_allocator_api->system;
+    tool_alloc.context = SL_MEMORY_CONTEXT_NONE;
+
+    enum sl_log_level min_level = sl_log_level_debug;
+    const char *path = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            ++i;
+            min_level = strcmp(argv[i], "error") == 0 ? sl_log_level_error : strcmp(argv[i], "debug") == 0 ? sl_log_level_debug : sl_log_level_info;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (!path) {
+        fprintf(stderr, "usage: %s [--level <debug|info|error>] <log file>\n", argv[0]);
+        return 1;
+    }
+
+    uint64_t size = 0;
+    uint8_t *data = map_log(path, &size);
+    const sl_log_binary_header *header = (const sl_log_binary_header *)data;
+    if (!data || size < sizeof(*header) || header->magic != SL_LOG_BINARY_MAGIC || header->version != SL_LOG_BINARY_VERSION) {
+        fprintf(stderr, "Failed to read a binary log from %s\n", path);
+        return 1;
+    }
+
+    decode(data, size, min_level);
+
+    sl_os_api->file_system->unmap_file(data, size);
+    sl_array_free(&tool_alloc, sites);
+    sl_hashmap_free(&tool_alloc, threads);
+    sl_shutdown_memory_tracker();
+    return 0;
+}